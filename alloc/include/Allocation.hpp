@@ -0,0 +1,55 @@
+#pragma once
+#ifndef VPR_ALLOCATION_HPP
+#define VPR_ALLOCATION_HPP
+#include "vpr_stdafx.h"
+#include "ForwardDecl.hpp"
+#include "MemoryBlock.hpp"
+
+namespace vpr
+{
+
+    /**An Allocation is a handle to a region of device memory, returned from one of the allocation methods of an Allocator. It does not 
+     * free its memory upon destruction: this must be done by returning it to the Allocator that created it, via Allocator::FreeMemory(), 
+     * Allocator::DestroyBuffer() or Allocator::DestroyImage().
+     * \ingroup Allocation
+     */
+    class VPR_API Allocation
+    {
+        Allocation(const Allocation&) = delete;
+        Allocation& operator=(const Allocation&) = delete;
+    public:
+
+        Allocation() noexcept = default;
+        ~Allocation() = default;
+        Allocation(Allocation&& other) noexcept;
+        Allocation& operator=(Allocation&& other) noexcept;
+
+        /**Memory object this allocation resides in: shared with other allocations, so bind resources using Offset() too.*/
+        VkDeviceMemory Memory() const noexcept;
+        VkDeviceSize Offset() const noexcept;
+        VkDeviceSize Size() const noexcept;
+        uint32_t MemoryTypeIdx() const noexcept;
+        suballocation_type Type() const noexcept;
+        MemoryBlock* Block() const noexcept;
+        /**Pointer to the start of this allocation if it was persistently mapped, otherwise nullptr.*/
+        void* MappedData() const noexcept;
+        /**True if this allocation has a VkDeviceMemory object to itself, rather than sharing a block with other allocations.*/
+        bool Dedicated() const noexcept;
+        /**Returns a pointer to the start of this allocation. Mapping is reference-counted per memory block, so this is cheap if the block is already mapped.*/
+        void* Map();
+        void Unmap();
+        bool Valid() const noexcept;
+
+    private:
+        friend class Allocator;
+        friend class AllocationCollection;
+        friend struct AllocatorImpl;
+        MemoryBlock* block{ nullptr };
+        Suballocation suballocation;
+        void* mappedData{ nullptr };
+        bool dedicated{ false };
+    };
+
+}
+
+#endif //!VPR_ALLOCATION_HPP
@@ -0,0 +1,58 @@
+#pragma once
+#ifndef VPR_ALLOCATION_REQUIREMENTS_HPP
+#define VPR_ALLOCATION_REQUIREMENTS_HPP
+#include "vpr_stdafx.h"
+
+namespace vpr
+{
+
+    /**Describes how memory will be accessed, which the Allocator uses to choose a suitable memory type.
+     * \ingroup Allocation
+     */
+    enum class memory_usage : uint32_t
+    {
+        /**Only accessed by the device: prefers DEVICE_LOCAL memory. Used for render targets, and most buffers and images.*/
+        GpuOnly = 0,
+        /**Written by the host, rarely (if ever) read by the device: requires HOST_VISIBLE and HOST_COHERENT memory. Used for staging buffers.*/
+        CpuOnly = 1,
+        /**Written by the host frequently, read by the device: requires HOST_VISIBLE, prefers DEVICE_LOCAL. Used for uniform and dynamic vertex data.*/
+        CpuToGpu = 2,
+        /**Written by the device, read back by the host: requires HOST_VISIBLE, prefers HOST_CACHED.*/
+        GpuToCpu = 3
+    };
+
+    /**Type of resource occupying a region of memory. Linear (buffers, linear images) and optimal (optimally tiled images) resources may not
+     * share a page of bufferImageGranularity bytes, so the allocator uses this to keep them apart.
+     * \ingroup Allocation
+     */
+    enum class suballocation_type : uint32_t
+    {
+        Free = 0,
+        Buffer = 1,
+        ImageLinear = 2,
+        ImageOptimal = 3,
+        /**Treated as conflicting with everything.*/
+        Unknown = 4
+    };
+
+    /**Requirements for an allocation, in addition to the VkMemoryRequirements of the resource itself.
+     * \ingroup Allocation
+     */
+    struct VPR_API AllocationRequirements
+    {
+        memory_usage Usage{ memory_usage::GpuOnly };
+        /**Property flags the chosen memory type must have, in addition to those implied by Usage.*/
+        VkMemoryPropertyFlags RequiredFlags{ 0 };
+        /**Property flags that are used to select between memory types meeting the requirements.*/
+        VkMemoryPropertyFlags PreferredFlags{ 0 };
+        /**Maps the allocation upon creation, keeping it mapped until freed. Requires host-visible memory.*/
+        bool PersistentlyMapped{ false };
+        /**Gives the allocation a VkDeviceMemory object of its own, even if the driver doesn't ask for one. Otherwise, the Allocator decides
+         * based on the driver's preference (when VK_KHR_dedicated_allocation or Vulkan 1.1 is available) and on the size and usage of the resource.
+         */
+        bool DedicatedAllocation{ false };
+    };
+
+}
+
+#endif //!VPR_ALLOCATION_REQUIREMENTS_HPP
@@ -0,0 +1,116 @@
+#pragma once
+#ifndef VPR_ALLOCATOR_HPP
+#define VPR_ALLOCATOR_HPP
+#include "vpr_stdafx.h"
+#include "ForwardDecl.hpp"
+#include "AllocationRequirements.hpp"
+#include "MemoryBudget.hpp"
+#include <memory>
+
+namespace vpr
+{
+
+    /**The Allocation group contains the Allocator, and the classes it uses to divide large VkDeviceMemory objects between many resources.
+     * \defgroup Allocation
+     */
+
+    struct AllocatorImpl;
+
+    /**Totals across all memory types of an Allocator.
+     * \ingroup Allocation
+     */
+    struct VPR_API AllocatorStats
+    {
+        /**Quantity of VkDeviceMemory objects currently allocated, which counts against maxMemoryAllocationCount.*/
+        uint32_t NumBlocks{ 0u };
+        uint64_t NumAllocations{ 0u };
+        /**Total size of all VkDeviceMemory objects.*/
+        VkDeviceSize BlockBytes{ 0u };
+        /**Bytes occupied by allocations within those memory objects, including padding.*/
+        VkDeviceSize UsedBytes{ 0u };
+        /**Quantity of blocks holding a single dedicated allocation: included in NumBlocks too.*/
+        uint32_t NumDedicatedBlocks{ 0u };
+    };
+
+    /**The Allocator sub-allocates resources from large VkDeviceMemory blocks, instead of making one vkAllocateMemory call per resource. This avoids
+     * both the cost of a kernel-mode allocation per resource, and running into maxMemoryAllocationCount (which can be as low as 4096).
+     *
+     * Each memory type gets its own list of blocks, created on demand. Blocks are 1/8th of their heap's size for heaps up to 1GiB, and 256MiB
+     * otherwise, unless a preferred block size is given. Allocations larger than half the block size get a block of their own. Memory types are
+     * chosen from the AllocationRequirements given: if allocation from the best memory type fails, the next best type is tried.
+     *
+     * Some resources run faster with a VkDeviceMemory object of their own, which the driver reports through VK_KHR_dedicated_allocation (or
+     * Vulkan 1.1). Resources the driver requires dedicated memory for always get it. Those it merely prefers dedicated memory for, along with
+     * color and depth-stencil attachments, get it only if they are at least 4MiB: smaller resources stay suballocated, as a dedicated
+     * allocation each would quickly eat into maxMemoryAllocationCount.
+     *
+     * All methods are thread-safe: each memory type has its own lock, so allocations from different memory types don't contend.
+     * \ingroup Allocation
+     */
+    class VPR_API Allocator
+    {
+        Allocator(const Allocator&) = delete;
+        Allocator& operator=(const Allocator&) = delete;
+    public:
+
+        /**\param preferred_block_size Size of the VkDeviceMemory blocks to create. Leave at 0 to choose a size based on the heap size.*/
+        Allocator(const Device* device, const VkDeviceSize preferred_block_size = 0u);
+        /**Frees all memory blocks: any outstanding allocations become invalid.*/
+        ~Allocator();
+
+        /**Allocates memory meeting the given requirements. Returns VK_SUCCESS, VK_ERROR_FEATURE_NOT_PRESENT if no memory type meets the requirements,
+         * VK_ERROR_TOO_MANY_OBJECTS if a new block was needed but maxMemoryAllocationCount has been reached, or the error from vkAllocateMemory.
+         */
+        VkResult AllocateMemory(const VkMemoryRequirements& memory_reqs, const AllocationRequirements& alloc_reqs, const suballocation_type type, Allocation& dest_allocation);
+        /**Allocates memory for the given buffer, without binding it.*/
+        VkResult AllocateForBuffer(const VkBuffer buffer, const AllocationRequirements& alloc_reqs, Allocation& dest_allocation);
+        /**Allocates memory for the given image, without binding it.
+         * \param tiling Tiling the image was created with, so linear and optimal images can be kept apart as bufferImageGranularity requires.
+         * \param usage Usage the image was created with. Large render targets are given dedicated allocations, so leave this at 0 to only
+         * give the image a dedicated allocation when the driver asks for one.
+         */
+        VkResult AllocateForImage(const VkImage image, const VkImageTiling tiling, const AllocationRequirements& alloc_reqs, Allocation& dest_allocation,
+            const VkImageUsageFlags usage = 0u);
+        /**Creates a buffer, allocates memory for it and binds that memory. On failure, nothing is created.*/
+        VkResult CreateBuffer(const VkBufferCreateInfo& create_info, const AllocationRequirements& alloc_reqs, VkBuffer* buffer, Allocation& dest_allocation);
+        /**Creates an image, allocates memory for it and binds that memory. On failure, nothing is created.*/
+        VkResult CreateImage(const VkImageCreateInfo& create_info, const AllocationRequirements& alloc_reqs, VkImage* image, Allocation& dest_allocation);
+        void DestroyBuffer(const VkBuffer buffer, Allocation& allocation);
+        void DestroyImage(const VkImage image, Allocation& allocation);
+        void FreeMemory(Allocation& allocation);
+
+        /**Flushes host writes to the given range of the allocation, if its memory isn't HOST_COHERENT. The range is expanded to nonCoherentAtomSize as required.*/
+        void FlushMemory(const Allocation& allocation, const VkDeviceSize offset = 0u, const VkDeviceSize size = VK_WHOLE_SIZE) const;
+        /**Makes device writes to the given range of the allocation visible to the host, if its memory isn't HOST_COHERENT.*/
+        void InvalidateMemory(const Allocation& allocation, const VkDeviceSize offset = 0u, const VkDeviceSize size = VK_WHOLE_SIZE) const;
+
+        /**Returns the best memory type in memory_type_bits for the given requirements, or std::numeric_limits<uint32_t>::max() if there is none.*/
+        uint32_t FindMemoryTypeIdx(const uint32_t memory_type_bits, const AllocationRequirements& alloc_reqs) const;
+        AllocatorStats Stats() const;
+        /**Makes the allocator keep heaps within the given budget where possible, and report its allocations to it. Must be called before any
+         * memory is allocated, and the budget must outlive the allocator.
+         */
+        void SetMemoryBudget(MemoryBudget* budget);
+        const Device* ParentDevice() const noexcept;
+
+    private:
+        friend struct DefragmenterImpl;
+        /**Places a copy of src in a fuller block of the same memory type, without creating new blocks: returns false if there is nowhere better for it.*/
+        bool allocateForMove(const Allocation& src, const VkMemoryRequirements& memory_reqs, Allocation& dest_allocation);
+        /**Returns false if allocateForMove() certainly can't find a better place for src (e.g. its block is the fullest, or the only one), without creating anything.
+         * \param src_block_used If non-null and src is a valid, non-dedicated allocation, written with the bytes used in its block: read under the allocator's lock.
+         */
+        bool canMoveFrom(const Allocation& src, VkDeviceSize* src_block_used = nullptr);
+        /**Identical to FreeMemory(), but returns the bytes of device memory released as a result.*/
+        VkDeviceSize freeMemory(Allocation& allocation);
+        /**Releases every empty block, including those kept around for re-use. Returns the bytes of device memory released.*/
+        VkDeviceSize releaseEmptyBlocks();
+
+        std::unique_ptr<AllocatorImpl> impl;
+    };
+
+    VPR_API void SetLoggingRepository_VprAlloc(void* repo);
+
+}
+
+#endif //!VPR_ALLOCATOR_HPP
@@ -0,0 +1,89 @@
+#pragma once
+#ifndef VPR_DEFRAGMENTER_HPP
+#define VPR_DEFRAGMENTER_HPP
+#include "vpr_stdafx.h"
+#include "ForwardDecl.hpp"
+#include <memory>
+#include <functional>
+
+namespace vpr
+{
+
+    struct DefragmenterImpl;
+
+    /**Running totals of the work done by a Defragmenter.
+     * \ingroup Allocation
+     */
+    struct VPR_API DefragmentationStats
+    {
+        /**Bytes copied by completed moves.*/
+        VkDeviceSize BytesMoved{ 0u };
+        uint64_t NumMoves{ 0u };
+        /**Bytes of VkDeviceMemory released, as blocks emptied by moves were freed.*/
+        VkDeviceSize BytesReclaimed{ 0u };
+        uint64_t BlocksReleased{ 0u };
+        /**Moves submitted to the queue, but not yet complete.*/
+        uint32_t MovesInFlight{ 0u };
+        /**Moves abandoned after creating their destination resource, because no fuller block had room for it once its exact requirements were
+         * known. Allocations with nowhere better to go aren't counted: they're skipped before anything is created.
+         */
+        uint64_t SkippedMoves{ 0u };
+    };
+
+    /**The Defragmenter incrementally compacts the blocks of an Allocator. Each call to Update() picks allocations from the least occupied
+     * blocks, creates a copy of their resource in a fuller block, and copies the contents over on the given queue: up to a fixed number of
+     * bytes (and of attempted moves) per frame, so compaction never stalls a frame. Once a copy completes, the registered VkBuffer/VkImage handle and Allocation are
+     * replaced with the new ones and the move callback runs, so descriptors and views can be rewritten. The old resource is kept alive for
+     * retire_delay_frames further Update() calls, so frames still in flight can keep using it, after which it's destroyed and any blocks it
+     * leaves empty are freed.
+     *
+     * Only registered resources are moved, and dedicated allocations are never moved. A resource must not be written to while it's being moved,
+     * as the write may not make it into the copy: reading from it is fine. The queue must be able to access the resources: use a dedicated transfer
+     * queue only for resources created with VK_SHARING_MODE_CONCURRENT, otherwise use a queue from the family that owns them. Images are transitioned
+     * out of and back into their registered layout on this queue, so keep that layout up to date with SetImageLayout().
+     * \ingroup Allocation
+     */
+    class VPR_API Defragmenter
+    {
+        Defragmenter(const Defragmenter&) = delete;
+        Defragmenter& operator=(const Defragmenter&) = delete;
+    public:
+
+        using buffer_moved_callback_t = std::function<void(const VkBuffer new_buffer, const Allocation& new_allocation)>;
+        using image_moved_callback_t = std::function<void(const VkImage new_image, const Allocation& new_allocation)>;
+
+        /**\param max_bytes_per_frame Upper bound on the bytes copied by a single call to Update(): one allocation larger than this is still moved on its own.
+         * \param retire_delay_frames Number of Update() calls to wait before destroying a moved resource: at least the number of frames in flight.
+         */
+        Defragmenter(Allocator* allocator, VkQueue queue, const uint32_t queue_family_idx, const VkDeviceSize max_bytes_per_frame,
+            const uint32_t retire_delay_frames = 3u);
+        /**Waits for moves in flight, and destroys every retired resource: the device must be done with them.*/
+        ~Defragmenter();
+
+        /**Registers a buffer as movable. The Defragmenter keeps the given pointers, and writes the new handle and allocation through them after a move.
+         * \param create_info Used to re-create the buffer: usage must include VK_BUFFER_USAGE_TRANSFER_SRC_BIT and VK_BUFFER_USAGE_TRANSFER_DST_BIT.
+         */
+        void RegisterBuffer(Allocation* allocation, VkBuffer* buffer, const VkBufferCreateInfo& create_info, buffer_moved_callback_t callback = nullptr);
+        /**Registers an image as movable. The Defragmenter keeps the given pointers, and writes the new handle and allocation through them after a move.
+         * \param create_info Used to re-create the image: usage must include VK_IMAGE_USAGE_TRANSFER_SRC_BIT and VK_IMAGE_USAGE_TRANSFER_DST_BIT.
+         * \param layout Layout the image is in between frames: must not be VK_IMAGE_LAYOUT_UNDEFINED or VK_IMAGE_LAYOUT_PREINITIALIZED.
+         */
+        void RegisterImage(Allocation* allocation, VkImage* image, const VkImageCreateInfo& create_info, const VkImageLayout layout,
+            const VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT, image_moved_callback_t callback = nullptr);
+        void SetImageLayout(const Allocation* allocation, const VkImageLayout layout);
+        /**Stops moving a resource: call before destroying it. Waits for a move of it in flight to complete, and discards the copy.*/
+        void Unregister(const Allocation* allocation);
+
+        /**Call once per frame: completes finished moves, destroys retired resources and the blocks they emptied, then submits the next batch of moves.*/
+        void Update();
+
+        DefragmentationStats Stats() const noexcept;
+        uint32_t NumRegistered() const noexcept;
+
+    private:
+        std::unique_ptr<DefragmenterImpl> impl;
+    };
+
+}
+
+#endif //!VPR_DEFRAGMENTER_HPP
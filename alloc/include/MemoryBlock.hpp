@@ -0,0 +1,70 @@
+#pragma once
+#ifndef VPR_MEMORY_BLOCK_HPP
+#define VPR_MEMORY_BLOCK_HPP
+#include "vpr_stdafx.h"
+#include "ForwardDecl.hpp"
+#include "AllocationRequirements.hpp"
+#include <memory>
+
+namespace vpr
+{
+
+    struct MemoryBlockImpl;
+
+    /**A region of a MemoryBlock's VkDeviceMemory, owned by a single allocation.
+     * \ingroup Allocation
+     */
+    struct VPR_API Suballocation
+    {
+        VkDeviceSize Offset{ 0u };
+        VkDeviceSize Size{ 0u };
+        suballocation_type Type{ suballocation_type::Free };
+    };
+
+    /**A MemoryBlock owns one VkDeviceMemory object, and divides it between many allocations using a two-level segregated fit (TLSF) allocator.
+     * Free regions are binned by size into a two-level table with bitmaps recording which bins are non-empty, so finding a suitable free region
+     * and freeing a region (merging it with free neighbours) both take constant time, regardless of how many allocations the block holds.
+     *
+     * Optimally-tiled images are padded out to bufferImageGranularity, both in offset and size: they never share a granularity page with any
+     * other resource, so linear and optimal resources can be freely mixed within a block. 
+     * 
+     * Not thread-safe: the AllocationCollection that owns a block synchronizes access to it. Mapping is the exception, and can be done from
+     * any thread: the memory is mapped once for the whole block, and stays mapped until all users have called Unmap().
+     * \ingroup Allocation
+     */
+    class VPR_API MemoryBlock
+    {
+        MemoryBlock(const MemoryBlock&) = delete;
+        MemoryBlock& operator=(const MemoryBlock&) = delete;
+    public:
+
+        /**Takes ownership of the given memory, which is freed along with the block.
+         * \param buffer_image_granularity From VkPhysicalDeviceLimits.
+         */
+        MemoryBlock(const VkDevice dvc, const VkDeviceMemory memory, const uint32_t memory_type_idx, const VkDeviceSize size, const VkDeviceSize buffer_image_granularity);
+        ~MemoryBlock();
+
+        /**Attempts to find space for an allocation, returning false if the block can't fit it.*/
+        bool Allocate(const VkDeviceSize size, const VkDeviceSize alignment, const suballocation_type type, Suballocation& result);
+        /**Frees a suballocation previously returned by Allocate.*/
+        void Free(const Suballocation& suballocation);
+
+        /**Maps the entire block (if it isn't already), returning a pointer to the start of the block.*/
+        void* Map();
+        void Unmap();
+
+        VkDeviceMemory Memory() const noexcept;
+        uint32_t MemoryTypeIdx() const noexcept;
+        VkDeviceSize Size() const noexcept;
+        /**Bytes occupied by allocations, including alignment and granularity padding.*/
+        VkDeviceSize UsedBytes() const noexcept;
+        size_t NumAllocations() const noexcept;
+        bool Empty() const noexcept;
+
+    private:
+        std::unique_ptr<MemoryBlockImpl> impl;
+    };
+
+}
+
+#endif //!VPR_MEMORY_BLOCK_HPP
@@ -0,0 +1,80 @@
+#pragma once
+#ifndef VPR_MEMORY_BUDGET_HPP
+#define VPR_MEMORY_BUDGET_HPP
+#include "vpr_stdafx.h"
+#include "ForwardDecl.hpp"
+#include <memory>
+#include <functional>
+
+namespace vpr
+{
+
+    struct MemoryBudgetImpl;
+
+    /**Budget and usage of a single memory heap, as of the last call to MemoryBudget::Update() (plus allocations made by Allocators since).
+     * \ingroup Allocation
+     */
+    struct VPR_API HeapBudget
+    {
+        VkDeviceSize Size{ 0u };
+        VkMemoryHeapFlags Flags{ 0u };
+        /**Memory the process can use from this heap before the driver has to start paging, or 80% of the heap's size without VK_EXT_memory_budget.*/
+        VkDeviceSize Budget{ 0u };
+        /**Memory used by the process (not just vpr) from this heap, or just that of the Allocators reporting to this budget without VK_EXT_memory_budget.*/
+        VkDeviceSize Usage{ 0u };
+        /**Memory allocated from this heap by the Allocators reporting to this budget.*/
+        VkDeviceSize AllocatorBytes{ 0u };
+    };
+
+    /**The MemoryBudget tracks how close each memory heap is to its budget. With VK_EXT_memory_budget enabled on the Device, budgets and usage
+     * come from the driver: they account for other processes and for memory vpr didn't allocate. Without it, budgets are estimated as 80% of
+     * each heap, and only the memory of Allocators reporting to this budget is counted.
+     *
+     * Call Update() once per frame to re-query the driver and run threshold callbacks. An Allocator given a MemoryBudget (via Allocator::SetMemoryBudget())
+     * won't create blocks that would take a heap over budget: it first runs the eviction callback, if one is set, and then falls back to other
+     * suitable memory types (e.g. host-visible memory for device-local resources). Only if no memory type within budget remains is the budget exceeded.
+     * \ingroup Allocation
+     */
+    class VPR_API MemoryBudget
+    {
+        MemoryBudget(const MemoryBudget&) = delete;
+        MemoryBudget& operator=(const MemoryBudget&) = delete;
+    public:
+
+        /**Called when the ratio of a heap's usage to its budget rises above a threshold, or falls back below it.*/
+        using threshold_callback_t = std::function<void(const uint32_t heap_idx, const HeapBudget& budget, const bool exceeded)>;
+        /**Called when an allocation of bytes_needed from a heap would exceed the budget: should free memory from that heap, returning the
+         * quantity of bytes freed. Must not allocate from or free memory with the Allocator making the call, as it may hold locks: free
+         * memory from elsewhere, or return 0 and defer freeing until after the allocation.
+         */
+        using eviction_callback_t = std::function<VkDeviceSize(const uint32_t heap_idx, const VkDeviceSize bytes_needed)>;
+
+        MemoryBudget(const Device* device);
+        ~MemoryBudget();
+
+        /**Re-queries heap budgets and usage, then runs threshold callbacks for heaps that crossed a threshold since the last Update().*/
+        void Update();
+        /**Adds a callback run when a heap's usage crosses the given fraction of its budget: e.g 0.9f to be warned before the budget is reached.*/
+        void AddThresholdCallback(const float threshold, threshold_callback_t callback);
+        void SetEvictionCallback(eviction_callback_t callback);
+
+        /**Returns true if allocating the given quantity of bytes from the heap would keep it within budget.*/
+        bool CanAllocate(const uint32_t heap_idx, const VkDeviceSize size) const noexcept;
+        /**Runs the eviction callback, if there is one: returns the quantity of bytes it freed.*/
+        VkDeviceSize Evict(const uint32_t heap_idx, const VkDeviceSize bytes_needed);
+        /**Used by Allocators to report memory allocated and freed between calls to Update().*/
+        void NotifyAllocated(const uint32_t heap_idx, const VkDeviceSize size) noexcept;
+        void NotifyFreed(const uint32_t heap_idx, const VkDeviceSize size) noexcept;
+
+        HeapBudget GetHeapBudget(const uint32_t heap_idx) const noexcept;
+        uint32_t NumHeaps() const noexcept;
+        /**True if budgets come from VK_EXT_memory_budget, rather than being estimated.*/
+        bool UsingBudgetExtension() const noexcept;
+
+    private:
+        std::unique_ptr<MemoryBudgetImpl> impl;
+    };
+
+}
+
+#endif //!VPR_MEMORY_BUDGET_HPP
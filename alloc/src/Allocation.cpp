@@ -0,0 +1,84 @@
+#include "vpr_stdafx.h"
+#include "Allocation.hpp"
+#include <cassert>
+#include <limits>
+
+namespace vpr
+{
+
+    Allocation::Allocation(Allocation&& other) noexcept : block(std::move(other.block)), suballocation(std::move(other.suballocation)), 
+        mappedData(std::move(other.mappedData)), dedicated(std::move(other.dedicated))
+    {
+        other.block = nullptr;
+        other.mappedData = nullptr;
+    }
+
+    Allocation& Allocation::operator=(Allocation&& other) noexcept
+    {
+        block = std::move(other.block);
+        suballocation = std::move(other.suballocation);
+        mappedData = std::move(other.mappedData);
+        dedicated = std::move(other.dedicated);
+        other.block = nullptr;
+        other.mappedData = nullptr;
+        return *this;
+    }
+
+    VkDeviceMemory Allocation::Memory() const noexcept
+    {
+        return block != nullptr ? block->Memory() : VK_NULL_HANDLE;
+    }
+
+    VkDeviceSize Allocation::Offset() const noexcept
+    {
+        return suballocation.Offset;
+    }
+
+    VkDeviceSize Allocation::Size() const noexcept
+    {
+        return suballocation.Size;
+    }
+
+    uint32_t Allocation::MemoryTypeIdx() const noexcept
+    {
+        return block != nullptr ? block->MemoryTypeIdx() : std::numeric_limits<uint32_t>::max();
+    }
+
+    suballocation_type Allocation::Type() const noexcept
+    {
+        return suballocation.Type;
+    }
+
+    MemoryBlock* Allocation::Block() const noexcept
+    {
+        return block;
+    }
+
+    void* Allocation::MappedData() const noexcept
+    {
+        return mappedData;
+    }
+
+    bool Allocation::Dedicated() const noexcept
+    {
+        return dedicated;
+    }
+
+    void* Allocation::Map()
+    {
+        assert(block != nullptr);
+        return reinterpret_cast<char*>(block->Map()) + suballocation.Offset;
+    }
+
+    void Allocation::Unmap()
+    {
+        assert(block != nullptr);
+        block->Unmap();
+    }
+
+    bool Allocation::Valid() const noexcept
+    {
+        return block != nullptr;
+    }
+
+}
@@ -0,0 +1,886 @@
+#include "vpr_stdafx.h"
+#include "Allocator.hpp"
+#include "Allocation.hpp"
+#include "MemoryBlock.hpp"
+#include "MemoryBudget.hpp"
+#include "LogicalDevice.hpp"
+#include "Instance.hpp"
+#include "vkAssert.hpp"
+#include "CreateInfoBase.hpp"
+#include "easylogging++.h"
+#include <array>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <limits>
+#include <algorithm>
+#include <cassert>
+#if !defined(VPR_BUILD_STATIC)
+INITIALIZE_EASYLOGGINGPP
+#endif
+
+namespace vpr
+{
+
+    void SetLoggingRepository_VprAlloc(void* repo)
+    {
+        el::Helpers::setStorage(*(el::base::type::StoragePointer*)repo);
+        LOG(INFO) << "Updating easyloggingpp storage pointer in vpr_alloc module...";
+    }
+
+    constexpr static VkDeviceSize small_heap_max_size = 1024u * 1024u * 1024u;
+    constexpr static VkDeviceSize large_heap_block_size = 256u * 1024u * 1024u;
+    // Smallest block we'll retry with when allocating a full-size block fails
+    constexpr static VkDeviceSize min_block_size = 8u * 1024u * 1024u;
+    // Resources below this size stay suballocated even if the driver would prefer a dedicated allocation: a 1280x720 RGBA8 target is ~3.5MiB
+    constexpr static VkDeviceSize dedicated_allocation_min_size = 4u * 1024u * 1024u;
+    constexpr static VkImageUsageFlags render_target_usage_flags = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+
+    static VkDeviceSize align_up(const VkDeviceSize value, const VkDeviceSize alignment) noexcept
+    {
+        return (value + alignment - 1u) / alignment * alignment;
+    }
+
+    static VkDeviceSize align_down(const VkDeviceSize value, const VkDeviceSize alignment) noexcept
+    {
+        return value / alignment * alignment;
+    }
+
+    static uint32_t count_bits(uint32_t value) noexcept
+    {
+        uint32_t result = 0u;
+        while (value != 0u)
+        {
+            value &= value - 1u;
+            ++result;
+        }
+        return result;
+    }
+
+    /**Blocks of a single memory type. Allocation is attempted from the newest block first, as it's the most likely to have room. Dedicated
+     * allocations are kept apart from the shared blocks, as their memory may only ever be bound to the resource it was allocated for.
+     */
+    class AllocationCollection
+    {
+    public:
+        AllocationCollection(AllocatorImpl* parent, const uint32_t memory_type_idx, const VkDeviceSize preferred_block_size);
+        ~AllocationCollection();
+
+        /**\param respect_budget If set, new blocks that would take the heap over its MemoryBudget (if there is one) aren't created.*/
+        VkResult Allocate(const VkMemoryRequirements& memory_reqs, const suballocation_type type, const bool respect_budget, Allocation& dest_allocation);
+        /**\param dedicated_info Chained to the VkMemoryAllocateInfo if non-null, naming the resource the memory is for.*/
+        VkResult AllocateDedicated(const VkMemoryRequirements& memory_reqs, const suballocation_type type, const VkMemoryDedicatedAllocateInfoKHR* dedicated_info,
+            const bool respect_budget, Allocation& dest_allocation);
+        /**Places an allocation matching src in a block fuller than src's, without creating new blocks: returns false if no such block has room.*/
+        bool AllocateForMove(const Allocation& src, const VkMemoryRequirements& memory_reqs, Allocation& dest_allocation);
+        /**Cheap check of whether AllocateForMove() could possibly succeed for src: some other block at least as full has enough free bytes for it.
+         * \param src_block_used If non-null, written with the bytes used in src's block, read under the same lock.
+         */
+        bool CanMoveFrom(const Allocation& src, VkDeviceSize* src_block_used);
+        /**Returns the bytes of device memory released by freeing the allocation, if its block was destroyed as a result.*/
+        VkDeviceSize Free(Allocation& allocation);
+        /**Destroys every empty block, including the one usually kept around for re-use. Returns the bytes of device memory released.*/
+        VkDeviceSize ReleaseEmptyBlocks();
+        void AddStats(AllocatorStats& stats);
+
+    private:
+        VkResult createBlock(std::vector<std::unique_ptr<MemoryBlock>>& dest_blocks, const VkDeviceSize size, const void* alloc_info_next, const bool respect_budget,
+            MemoryBlock** dest_block);
+        void destroyBlock(std::vector<std::unique_ptr<MemoryBlock>>& src_blocks, const size_t idx);
+
+        AllocatorImpl* parent{ nullptr };
+        const uint32_t memoryTypeIdx;
+        const VkDeviceSize preferredBlockSize;
+        std::mutex mutex;
+        std::vector<std::unique_ptr<MemoryBlock>> blocks;
+        std::vector<std::unique_ptr<MemoryBlock>> dedicatedBlocks;
+    };
+
+    struct resource_memory_reqs_t
+    {
+        VkMemoryRequirements memoryReqs;
+        bool prefersDedicated{ false };
+        bool requiresDedicated{ false };
+    };
+
+    struct AllocatorImpl
+    {
+        AllocatorImpl(const Device* dvc, const VkDeviceSize preferred_block_size);
+        ~AllocatorImpl();
+        void setupDedicatedAllocations();
+        resource_memory_reqs_t getBufferMemoryReqs(const VkBuffer buffer) const;
+        resource_memory_reqs_t getImageMemoryReqs(const VkImage image) const;
+        bool useDedicatedAllocation(const resource_memory_reqs_t& reqs, const AllocationRequirements& alloc_reqs, const bool render_target) const noexcept;
+        VkResult allocate(const VkMemoryRequirements& memory_reqs, const AllocationRequirements& alloc_reqs, const suballocation_type type, const bool dedicated,
+            const VkMemoryDedicatedAllocateInfoKHR* dedicated_info, Allocation& dest_allocation);
+        VkResult allocateDeviceMemory(const uint32_t memory_type_idx, const VkDeviceSize size, const void* alloc_info_next, const bool respect_budget, VkDeviceMemory* memory);
+        void deviceMemoryFreed(const uint32_t memory_type_idx, const VkDeviceSize size);
+        uint32_t heapIdx(const uint32_t memory_type_idx) const noexcept;
+        uint32_t findMemoryTypeIdx(const uint32_t memory_type_bits, const AllocationRequirements& alloc_reqs) const;
+        bool isCoherent(const uint32_t memory_type_idx) const noexcept;
+        VkMappedMemoryRange mappedRange(const Allocation& allocation, const VkDeviceSize offset, const VkDeviceSize size) const;
+
+        const Device* device{ nullptr };
+        VkPhysicalDeviceMemoryProperties memoryProperties;
+        VkDeviceSize bufferImageGranularity{ 1u };
+        VkDeviceSize nonCoherentAtomSize{ 1u };
+        uint32_t maxMemoryAllocationCount{ std::numeric_limits<uint32_t>::max() };
+        std::atomic<uint32_t> numDeviceAllocations{ 0u };
+        MemoryBudget* budget{ nullptr };
+        // Non-null if dedicated allocation requirements can be queried, through Vulkan 1.1 or VK_KHR_get_memory_requirements2
+        PFN_vkGetBufferMemoryRequirements2KHR getBufferMemoryRequirements2{ nullptr };
+        PFN_vkGetImageMemoryRequirements2KHR getImageMemoryRequirements2{ nullptr };
+        std::array<std::unique_ptr<AllocationCollection>, VK_MAX_MEMORY_TYPES> collections;
+    };
+
+    AllocationCollection::AllocationCollection(AllocatorImpl* _parent, const uint32_t memory_type_idx, const VkDeviceSize preferred_block_size) : parent(_parent),
+        memoryTypeIdx(memory_type_idx), preferredBlockSize(preferred_block_size) {}
+
+    AllocationCollection::~AllocationCollection()
+    {
+        size_t num_allocations = dedicatedBlocks.size();
+        for (const auto& block : blocks)
+        {
+            num_allocations += block->NumAllocations();
+        }
+        LOG_IF(num_allocations != 0u, WARNING) << num_allocations << " allocations from memory type " << memoryTypeIdx << " were not freed before the Allocator was destroyed.";
+        while (!blocks.empty())
+        {
+            destroyBlock(blocks, blocks.size() - 1u);
+        }
+        while (!dedicatedBlocks.empty())
+        {
+            destroyBlock(dedicatedBlocks, dedicatedBlocks.size() - 1u);
+        }
+    }
+
+    VkResult AllocationCollection::Allocate(const VkMemoryRequirements& memory_reqs, const suballocation_type type, const bool respect_budget, Allocation& dest_allocation)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        // Large allocations would quickly fragment a shared block, so they get one of their own
+        if (memory_reqs.size > preferredBlockSize / 2u)
+        {
+            VkDeviceSize block_size = memory_reqs.size;
+            if (type == suballocation_type::ImageOptimal || type == suballocation_type::Unknown)
+            {
+                block_size = align_up(block_size, parent->bufferImageGranularity);
+            }
+            MemoryBlock* block = nullptr;
+            VkResult result = createBlock(blocks, block_size, nullptr, respect_budget, &block);
+            if (result != VK_SUCCESS)
+            {
+                return result;
+            }
+            const bool allocated = block->Allocate(memory_reqs.size, memory_reqs.alignment, type, dest_allocation.suballocation);
+            assert(allocated);
+            (void)allocated;
+            dest_allocation.block = block;
+            return VK_SUCCESS;
+        }
+
+        for (auto iter = blocks.rbegin(); iter != blocks.rend(); ++iter)
+        {
+            if ((*iter)->Allocate(memory_reqs.size, memory_reqs.alignment, type, dest_allocation.suballocation))
+            {
+                dest_allocation.block = iter->get();
+                return VK_SUCCESS;
+            }
+        }
+
+        // Halve the block size until allocation succeeds, or the block would be too small for the request
+        VkDeviceSize block_size = preferredBlockSize;
+        VkResult result = VK_ERROR_OUT_OF_DEVICE_MEMORY;
+        MemoryBlock* block = nullptr;
+        while (true)
+        {
+            result = createBlock(blocks, block_size, nullptr, respect_budget, &block);
+            if (result == VK_SUCCESS || result == VK_ERROR_TOO_MANY_OBJECTS)
+            {
+                break;
+            }
+            const VkDeviceSize next_size = block_size / 2u;
+            if (next_size < min_block_size || next_size < memory_reqs.size * 2u)
+            {
+                break;
+            }
+            block_size = next_size;
+        }
+
+        if (result != VK_SUCCESS)
+        {
+            return result;
+        }
+
+        const bool allocated = block->Allocate(memory_reqs.size, memory_reqs.alignment, type, dest_allocation.suballocation);
+        assert(allocated);
+        (void)allocated;
+        dest_allocation.block = block;
+        return VK_SUCCESS;
+    }
+
+    VkResult AllocationCollection::AllocateDedicated(const VkMemoryRequirements& memory_reqs, const suballocation_type type, const VkMemoryDedicatedAllocateInfoKHR* dedicated_info,
+        const bool respect_budget, Allocation& dest_allocation)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        MemoryBlock* block = nullptr;
+        VkResult result = createBlock(dedicatedBlocks, memory_reqs.size, dedicated_info, respect_budget, &block);
+        if (result != VK_SUCCESS)
+        {
+            return result;
+        }
+        // Granularity padding is irrelevant with nothing else in the block, so don't let it push the allocation past the end
+        const bool allocated = block->Allocate(memory_reqs.size, 1u, suballocation_type::Buffer, dest_allocation.suballocation);
+        assert(allocated);
+        (void)allocated;
+        dest_allocation.suballocation.Type = type;
+        dest_allocation.block = block;
+        dest_allocation.dedicated = true;
+        return VK_SUCCESS;
+    }
+
+    bool AllocationCollection::AllocateForMove(const Allocation& src, const VkMemoryRequirements& memory_reqs, Allocation& dest_allocation)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (memory_reqs.size > preferredBlockSize / 2u)
+        {
+            return false;
+        }
+
+        // Fill the fullest blocks first, so the emptiest ones drain and can be released
+        const VkDeviceSize src_used = src.block->UsedBytes();
+        std::vector<MemoryBlock*> candidates;
+        for (const auto& block : blocks)
+        {
+            if (block.get() != src.block && block->UsedBytes() >= src_used)
+            {
+                candidates.emplace_back(block.get());
+            }
+        }
+        std::sort(candidates.begin(), candidates.end(), [](const MemoryBlock* a, const MemoryBlock* b) { return a->UsedBytes() > b->UsedBytes(); });
+
+        for (auto* block : candidates)
+        {
+            if (block->Allocate(memory_reqs.size, memory_reqs.alignment, src.Type(), dest_allocation.suballocation))
+            {
+                dest_allocation.block = block;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    bool AllocationCollection::CanMoveFrom(const Allocation& src, VkDeviceSize* src_block_used)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        const VkDeviceSize src_used = src.block->UsedBytes();
+        if (src_block_used != nullptr)
+        {
+            *src_block_used = src_used;
+        }
+
+        if (src.Size() > preferredBlockSize / 2u)
+        {
+            return false;
+        }
+
+        // Free bytes needn't be contiguous, but if there aren't enough of them the move can't possibly fit
+        return std::any_of(blocks.cbegin(), blocks.cend(), [&](const std::unique_ptr<MemoryBlock>& block)
+        {
+            return block.get() != src.block && block->UsedBytes() >= src_used && block->Size() - block->UsedBytes() >= src.Size();
+        });
+    }
+
+    VkDeviceSize AllocationCollection::Free(Allocation& allocation)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (allocation.dedicated)
+        {
+            auto iter = std::find_if(dedicatedBlocks.begin(), dedicatedBlocks.end(), [&allocation](const std::unique_ptr<MemoryBlock>& block) { return block.get() == allocation.block; });
+            assert(iter != dedicatedBlocks.end());
+            const VkDeviceSize released = (*iter)->Size();
+            destroyBlock(dedicatedBlocks, static_cast<size_t>(std::distance(dedicatedBlocks.begin(), iter)));
+            return released;
+        }
+
+        auto iter = std::find_if(blocks.begin(), blocks.end(), [&allocation](const std::unique_ptr<MemoryBlock>& block) { return block.get() == allocation.block; });
+        assert(iter != blocks.end());
+        (*iter)->Free(allocation.suballocation);
+
+        if ((*iter)->Empty())
+        {
+            // Keep one empty block of the preferred size around, so allocating and freeing repeatedly doesn't thrash vkAllocateMemory
+            const bool other_empty = std::any_of(blocks.begin(), blocks.end(), [&iter](const std::unique_ptr<MemoryBlock>& block) { return block != *iter && block->Empty(); });
+            if (other_empty || (*iter)->Size() != preferredBlockSize)
+            {
+                const VkDeviceSize released = (*iter)->Size();
+                destroyBlock(blocks, static_cast<size_t>(std::distance(blocks.begin(), iter)));
+                return released;
+            }
+        }
+
+        return 0u;
+    }
+
+    VkDeviceSize AllocationCollection::ReleaseEmptyBlocks()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        VkDeviceSize released = 0u;
+        for (size_t i = blocks.size(); i > 0u; --i)
+        {
+            if (blocks[i - 1u]->Empty())
+            {
+                released += blocks[i - 1u]->Size();
+                destroyBlock(blocks, i - 1u);
+            }
+        }
+        return released;
+    }
+
+    void AllocationCollection::AddStats(AllocatorStats& stats)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto& block : blocks)
+        {
+            ++stats.NumBlocks;
+            stats.NumAllocations += block->NumAllocations();
+            stats.BlockBytes += block->Size();
+            stats.UsedBytes += block->UsedBytes();
+        }
+        for (const auto& block : dedicatedBlocks)
+        {
+            ++stats.NumBlocks;
+            ++stats.NumDedicatedBlocks;
+            ++stats.NumAllocations;
+            stats.BlockBytes += block->Size();
+            stats.UsedBytes += block->Size();
+        }
+    }
+
+    VkResult AllocationCollection::createBlock(std::vector<std::unique_ptr<MemoryBlock>>& dest_blocks, const VkDeviceSize size, const void* alloc_info_next, const bool respect_budget,
+        MemoryBlock** dest_block)
+    {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkResult result = parent->allocateDeviceMemory(memoryTypeIdx, size, alloc_info_next, respect_budget, &memory);
+        if (result != VK_SUCCESS)
+        {
+            return result;
+        }
+        dest_blocks.emplace_back(std::make_unique<MemoryBlock>(parent->device->vkHandle(), memory, memoryTypeIdx, size, parent->bufferImageGranularity));
+        *dest_block = dest_blocks.back().get();
+        LOG_IF(VERBOSE_LOGGING, INFO) << "Created memory block of size " << size << " for memory type " << memoryTypeIdx << ", " << blocks.size() << " shared and " 
+            << dedicatedBlocks.size() << " dedicated blocks now exist for this type.";
+        return VK_SUCCESS;
+    }
+
+    void AllocationCollection::destroyBlock(std::vector<std::unique_ptr<MemoryBlock>>& src_blocks, const size_t idx)
+    {
+        // MemoryBlock frees its memory upon destruction
+        const VkDeviceSize size = src_blocks[idx]->Size();
+        src_blocks.erase(src_blocks.begin() + idx);
+        parent->deviceMemoryFreed(memoryTypeIdx, size);
+    }
+
+    AllocatorImpl::AllocatorImpl(const Device* dvc, const VkDeviceSize preferred_block_size) : device(dvc),
+        memoryProperties(dvc->GetPhysicalDeviceMemoryProperties())
+    {
+        const VkPhysicalDeviceLimits& limits = device->GetPhysicalDeviceProperties().limits;
+        bufferImageGranularity = std::max(limits.bufferImageGranularity, VkDeviceSize(1u));
+        nonCoherentAtomSize = std::max(limits.nonCoherentAtomSize, VkDeviceSize(1u));
+        maxMemoryAllocationCount = limits.maxMemoryAllocationCount;
+
+        for (uint32_t i = 0u; i < memoryProperties.memoryTypeCount; ++i)
+        {
+            VkDeviceSize block_size = preferred_block_size;
+            if (block_size == 0u)
+            {
+                const VkDeviceSize heap_size = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[i].heapIndex].size;
+                block_size = heap_size <= small_heap_max_size ? heap_size / 8u : large_heap_block_size;
+            }
+            collections[i] = std::make_unique<AllocationCollection>(this, i, block_size);
+        }
+
+        setupDedicatedAllocations();
+    }
+
+    AllocatorImpl::~AllocatorImpl()
+    {
+        for (auto& collection : collections)
+        {
+            collection.reset();
+        }
+    }
+
+    void AllocatorImpl::setupDedicatedAllocations()
+    {
+        if (device->ParentInstance()->ApplicationInfo().apiVersion >= VK_API_VERSION_1_1)
+        {
+            getBufferMemoryRequirements2 = vkGetBufferMemoryRequirements2;
+            getImageMemoryRequirements2 = vkGetImageMemoryRequirements2;
+        }
+        else if (device->DedicatedAllocationExtensionsEnabled())
+        {
+            getBufferMemoryRequirements2 = 
+                reinterpret_cast<PFN_vkGetBufferMemoryRequirements2KHR>(vkGetDeviceProcAddr(device->vkHandle(), "vkGetBufferMemoryRequirements2KHR"));
+            getImageMemoryRequirements2 = 
+                reinterpret_cast<PFN_vkGetImageMemoryRequirements2KHR>(vkGetDeviceProcAddr(device->vkHandle(), "vkGetImageMemoryRequirements2KHR"));
+        }
+
+        if (getBufferMemoryRequirements2 == nullptr || getImageMemoryRequirements2 == nullptr)
+        {
+            getBufferMemoryRequirements2 = nullptr;
+            getImageMemoryRequirements2 = nullptr;
+            LOG_IF(VERBOSE_LOGGING, INFO) << "Dedicated allocation requirements can't be queried: only large render targets will receive dedicated allocations.";
+        }
+    }
+
+    resource_memory_reqs_t AllocatorImpl::getBufferMemoryReqs(const VkBuffer buffer) const
+    {
+        resource_memory_reqs_t result;
+        if (getBufferMemoryRequirements2 != nullptr)
+        {
+            VkMemoryDedicatedRequirementsKHR dedicated_reqs = vk_dedicated_memory_requirements_khr_base;
+            VkMemoryRequirements2KHR memory_reqs = vk_memory_requirements_2_khr_base;
+            memory_reqs.pNext = &dedicated_reqs;
+            VkBufferMemoryRequirementsInfo2KHR info = vk_buffer_memory_requirements_info_khr_base;
+            info.buffer = buffer;
+            getBufferMemoryRequirements2(device->vkHandle(), &info, &memory_reqs);
+            result.memoryReqs = memory_reqs.memoryRequirements;
+            result.prefersDedicated = dedicated_reqs.prefersDedicatedAllocation == VK_TRUE;
+            result.requiresDedicated = dedicated_reqs.requiresDedicatedAllocation == VK_TRUE;
+        }
+        else
+        {
+            vkGetBufferMemoryRequirements(device->vkHandle(), buffer, &result.memoryReqs);
+        }
+        return result;
+    }
+
+    resource_memory_reqs_t AllocatorImpl::getImageMemoryReqs(const VkImage image) const
+    {
+        resource_memory_reqs_t result;
+        if (getImageMemoryRequirements2 != nullptr)
+        {
+            VkMemoryDedicatedRequirementsKHR dedicated_reqs = vk_dedicated_memory_requirements_khr_base;
+            VkMemoryRequirements2KHR memory_reqs = vk_memory_requirements_2_khr_base;
+            memory_reqs.pNext = &dedicated_reqs;
+            VkImageMemoryRequirementsInfo2KHR info = vk_image_memory_requirements_info_khr_base;
+            info.image = image;
+            getImageMemoryRequirements2(device->vkHandle(), &info, &memory_reqs);
+            result.memoryReqs = memory_reqs.memoryRequirements;
+            result.prefersDedicated = dedicated_reqs.prefersDedicatedAllocation == VK_TRUE;
+            result.requiresDedicated = dedicated_reqs.requiresDedicatedAllocation == VK_TRUE;
+        }
+        else
+        {
+            vkGetImageMemoryRequirements(device->vkHandle(), image, &result.memoryReqs);
+        }
+        return result;
+    }
+
+    bool AllocatorImpl::useDedicatedAllocation(const resource_memory_reqs_t& reqs, const AllocationRequirements& alloc_reqs, const bool render_target) const noexcept
+    {
+        if (reqs.requiresDedicated || alloc_reqs.DedicatedAllocation)
+        {
+            return true;
+        }
+        // Small resources are better off suballocated, even if the driver would prefer otherwise: dedicating memory to them wastes allocations
+        if (reqs.memoryReqs.size < dedicated_allocation_min_size)
+        {
+            return false;
+        }
+        return reqs.prefersDedicated || render_target;
+    }
+
+    VkResult AllocatorImpl::allocate(const VkMemoryRequirements& memory_reqs, const AllocationRequirements& alloc_reqs, const suballocation_type type, const bool dedicated,
+        const VkMemoryDedicatedAllocateInfoKHR* dedicated_info, Allocation& dest_allocation)
+    {
+        assert(!dest_allocation.Valid());
+        uint32_t memory_type_bits = memory_reqs.memoryTypeBits;
+        uint32_t memory_type_idx = findMemoryTypeIdx(memory_type_bits, alloc_reqs);
+        if (memory_type_idx == std::numeric_limits<uint32_t>::max())
+        {
+            LOG(ERROR) << "No memory type satisfies the requirements of the requested allocation.";
+            return VK_ERROR_FEATURE_NOT_PRESENT;
+        }
+
+        const uint32_t first_memory_type_idx = memory_type_idx;
+        // With a budget, first try to stay within it (evicting or falling back to other memory types as needed), and only exceed it as a last resort
+        bool respect_budget = budget != nullptr;
+        bool evicted = false;
+        VkResult result = VK_ERROR_OUT_OF_DEVICE_MEMORY;
+        while (memory_type_idx != std::numeric_limits<uint32_t>::max())
+        {
+            if (dedicated)
+            {
+                result = collections[memory_type_idx]->AllocateDedicated(memory_reqs, type, dedicated_info, respect_budget, dest_allocation);
+            }
+            else
+            {
+                result = collections[memory_type_idx]->Allocate(memory_reqs, type, respect_budget, dest_allocation);
+            }
+
+            if (result == VK_SUCCESS || result == VK_ERROR_TOO_MANY_OBJECTS)
+            {
+                break;
+            }
+
+            if (respect_budget && !evicted && !budget->CanAllocate(heapIdx(memory_type_idx), memory_reqs.size))
+            {
+                // Give the application a chance to make room in the preferred heap before settling for a worse one
+                evicted = true;
+                if (budget->Evict(heapIdx(memory_type_idx), memory_reqs.size) != 0u)
+                {
+                    continue;
+                }
+            }
+
+            // The chosen heap is full: fall back to the next best memory type, if there is one
+            LOG_IF(VERBOSE_LOGGING, INFO) << "Allocation from memory type " << memory_type_idx << " failed, trying other suitable memory types.";
+            evicted = false;
+            memory_type_bits &= ~(1u << memory_type_idx);
+            memory_type_idx = findMemoryTypeIdx(memory_type_bits, alloc_reqs);
+
+            if (memory_type_idx == std::numeric_limits<uint32_t>::max() && respect_budget)
+            {
+                LOG(WARNING) << "No memory type within budget could fit an allocation of " << memory_reqs.size << " bytes, exceeding budget.";
+                respect_budget = false;
+                memory_type_bits = memory_reqs.memoryTypeBits;
+                memory_type_idx = first_memory_type_idx;
+            }
+        }
+
+        if (result != VK_SUCCESS)
+        {
+            return result;
+        }
+
+        if (alloc_reqs.PersistentlyMapped)
+        {
+            dest_allocation.mappedData = dest_allocation.Map();
+        }
+
+        return VK_SUCCESS;
+    }
+
+    VkResult AllocatorImpl::allocateDeviceMemory(const uint32_t memory_type_idx, const VkDeviceSize size, const void* alloc_info_next, const bool respect_budget, VkDeviceMemory* memory)
+    {
+        if (respect_budget && budget != nullptr && !budget->CanAllocate(heapIdx(memory_type_idx), size))
+        {
+            return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+        }
+
+        if (numDeviceAllocations.fetch_add(1u) >= maxMemoryAllocationCount)
+        {
+            --numDeviceAllocations;
+            LOG(WARNING) << "Allocator reached maxMemoryAllocationCount of " << maxMemoryAllocationCount << ", cannot create more memory blocks.";
+            return VK_ERROR_TOO_MANY_OBJECTS;
+        }
+
+        VkMemoryAllocateInfo alloc_info = vk_allocation_info_base;
+        alloc_info.pNext = alloc_info_next;
+        alloc_info.allocationSize = size;
+        alloc_info.memoryTypeIndex = memory_type_idx;
+        VkResult result = vkAllocateMemory(device->vkHandle(), &alloc_info, nullptr, memory);
+        if (result != VK_SUCCESS)
+        {
+            --numDeviceAllocations;
+        }
+        else if (budget != nullptr)
+        {
+            budget->NotifyAllocated(heapIdx(memory_type_idx), size);
+        }
+        return result;
+    }
+
+    void AllocatorImpl::deviceMemoryFreed(const uint32_t memory_type_idx, const VkDeviceSize size)
+    {
+        --numDeviceAllocations;
+        if (budget != nullptr)
+        {
+            budget->NotifyFreed(heapIdx(memory_type_idx), size);
+        }
+    }
+
+    uint32_t AllocatorImpl::heapIdx(const uint32_t memory_type_idx) const noexcept
+    {
+        return memoryProperties.memoryTypes[memory_type_idx].heapIndex;
+    }
+
+    uint32_t AllocatorImpl::findMemoryTypeIdx(const uint32_t memory_type_bits, const AllocationRequirements& alloc_reqs) const
+    {
+        VkMemoryPropertyFlags required_flags = alloc_reqs.RequiredFlags;
+        VkMemoryPropertyFlags preferred_flags = alloc_reqs.PreferredFlags;
+
+        switch (alloc_reqs.Usage)
+        {
+        case memory_usage::GpuOnly:
+            preferred_flags |= VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+            break;
+        case memory_usage::CpuOnly:
+            required_flags |= VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+            break;
+        case memory_usage::CpuToGpu:
+            required_flags |= VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+            preferred_flags |= VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+            break;
+        case memory_usage::GpuToCpu:
+            required_flags |= VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+            preferred_flags |= VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+            break;
+        }
+
+        if (alloc_reqs.PersistentlyMapped)
+        {
+            required_flags |= VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+        }
+
+        uint32_t result = std::numeric_limits<uint32_t>::max();
+        uint32_t best_cost = std::numeric_limits<uint32_t>::max();
+        for (uint32_t i = 0u; i < memoryProperties.memoryTypeCount; ++i)
+        {
+            if ((memory_type_bits & (1u << i)) == 0u)
+            {
+                continue;
+            }
+            const VkMemoryPropertyFlags flags = memoryProperties.memoryTypes[i].propertyFlags;
+            if ((flags & required_flags) != required_flags)
+            {
+                continue;
+            }
+            // Cost is the quantity of preferred flags the type lacks: ties go to the lowest index, as the spec orders types by performance
+            const uint32_t cost = count_bits(preferred_flags & ~flags);
+            if (cost < best_cost)
+            {
+                result = i;
+                best_cost = cost;
+                if (cost == 0u)
+                {
+                    break;
+                }
+            }
+        }
+
+        return result;
+    }
+
+    bool AllocatorImpl::isCoherent(const uint32_t memory_type_idx) const noexcept
+    {
+        return (memoryProperties.memoryTypes[memory_type_idx].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0u;
+    }
+
+    VkMappedMemoryRange AllocatorImpl::mappedRange(const Allocation& allocation, const VkDeviceSize offset, const VkDeviceSize size) const
+    {
+        const VkDeviceSize block_size = allocation.Block()->Size();
+        const VkDeviceSize range_size = size == VK_WHOLE_SIZE ? allocation.Size() - offset : size;
+        // Ranges must start and end on multiples of nonCoherentAtomSize (or at the end of the memory object)
+        const VkDeviceSize begin = align_down(allocation.Offset() + offset, nonCoherentAtomSize);
+        const VkDeviceSize end = std::min(align_up(allocation.Offset() + offset + range_size, nonCoherentAtomSize), block_size);
+
+        VkMappedMemoryRange range = vk_mapped_memory_base;
+        range.memory = allocation.Memory();
+        range.offset = begin;
+        range.size = end - begin;
+        return range;
+    }
+
+    Allocator::Allocator(const Device* device, const VkDeviceSize preferred_block_size) : impl(std::make_unique<AllocatorImpl>(device, preferred_block_size)) {}
+
+    Allocator::~Allocator() {}
+
+    VkResult Allocator::AllocateMemory(const VkMemoryRequirements& memory_reqs, const AllocationRequirements& alloc_reqs, const suballocation_type type, Allocation& dest_allocation)
+    {
+        // Without a resource to name, dedicated memory is just a block of its own
+        return impl->allocate(memory_reqs, alloc_reqs, type, alloc_reqs.DedicatedAllocation, nullptr, dest_allocation);
+    }
+
+    VkResult Allocator::AllocateForBuffer(const VkBuffer buffer, const AllocationRequirements& alloc_reqs, Allocation& dest_allocation)
+    {
+        const resource_memory_reqs_t reqs = impl->getBufferMemoryReqs(buffer);
+        const bool dedicated = impl->useDedicatedAllocation(reqs, alloc_reqs, false);
+        VkMemoryDedicatedAllocateInfoKHR dedicated_info = vk_dedicated_allocate_info_khr_base;
+        dedicated_info.buffer = buffer;
+        const bool chain_info = dedicated && impl->getBufferMemoryRequirements2 != nullptr;
+        return impl->allocate(reqs.memoryReqs, alloc_reqs, suballocation_type::Buffer, dedicated, chain_info ? &dedicated_info : nullptr, dest_allocation);
+    }
+
+    VkResult Allocator::AllocateForImage(const VkImage image, const VkImageTiling tiling, const AllocationRequirements& alloc_reqs, Allocation& dest_allocation,
+        const VkImageUsageFlags usage)
+    {
+        const resource_memory_reqs_t reqs = impl->getImageMemoryReqs(image);
+        const bool dedicated = impl->useDedicatedAllocation(reqs, alloc_reqs, (usage & render_target_usage_flags) != 0u);
+        VkMemoryDedicatedAllocateInfoKHR dedicated_info = vk_dedicated_allocate_info_khr_base;
+        dedicated_info.image = image;
+        const bool chain_info = dedicated && impl->getImageMemoryRequirements2 != nullptr;
+        const suballocation_type type = tiling == VK_IMAGE_TILING_LINEAR ? suballocation_type::ImageLinear : suballocation_type::ImageOptimal;
+        return impl->allocate(reqs.memoryReqs, alloc_reqs, type, dedicated, chain_info ? &dedicated_info : nullptr, dest_allocation);
+    }
+
+    VkResult Allocator::CreateBuffer(const VkBufferCreateInfo& create_info, const AllocationRequirements& alloc_reqs, VkBuffer* buffer, Allocation& dest_allocation)
+    {
+        VkResult result = vkCreateBuffer(impl->device->vkHandle(), &create_info, nullptr, buffer);
+        if (result != VK_SUCCESS)
+        {
+            return result;
+        }
+
+        result = AllocateForBuffer(*buffer, alloc_reqs, dest_allocation);
+        if (result != VK_SUCCESS)
+        {
+            vkDestroyBuffer(impl->device->vkHandle(), *buffer, nullptr);
+            *buffer = VK_NULL_HANDLE;
+            return result;
+        }
+
+        result = vkBindBufferMemory(impl->device->vkHandle(), *buffer, dest_allocation.Memory(), dest_allocation.Offset());
+        VkAssert(result);
+        return result;
+    }
+
+    VkResult Allocator::CreateImage(const VkImageCreateInfo& create_info, const AllocationRequirements& alloc_reqs, VkImage* image, Allocation& dest_allocation)
+    {
+        VkResult result = vkCreateImage(impl->device->vkHandle(), &create_info, nullptr, image);
+        if (result != VK_SUCCESS)
+        {
+            return result;
+        }
+
+        result = AllocateForImage(*image, create_info.tiling, alloc_reqs, dest_allocation, create_info.usage);
+        if (result != VK_SUCCESS)
+        {
+            vkDestroyImage(impl->device->vkHandle(), *image, nullptr);
+            *image = VK_NULL_HANDLE;
+            return result;
+        }
+
+        result = vkBindImageMemory(impl->device->vkHandle(), *image, dest_allocation.Memory(), dest_allocation.Offset());
+        VkAssert(result);
+        return result;
+    }
+
+    void Allocator::DestroyBuffer(const VkBuffer buffer, Allocation& allocation)
+    {
+        vkDestroyBuffer(impl->device->vkHandle(), buffer, nullptr);
+        FreeMemory(allocation);
+    }
+
+    void Allocator::DestroyImage(const VkImage image, Allocation& allocation)
+    {
+        vkDestroyImage(impl->device->vkHandle(), image, nullptr);
+        FreeMemory(allocation);
+    }
+
+    void Allocator::FreeMemory(Allocation& allocation)
+    {
+        freeMemory(allocation);
+    }
+
+    void Allocator::FlushMemory(const Allocation& allocation, const VkDeviceSize offset, const VkDeviceSize size) const
+    {
+        assert(allocation.Valid());
+        if (impl->isCoherent(allocation.MemoryTypeIdx()))
+        {
+            return;
+        }
+        const VkMappedMemoryRange range = impl->mappedRange(allocation, offset, size);
+        VkResult result = vkFlushMappedMemoryRanges(impl->device->vkHandle(), 1, &range);
+        VkAssert(result);
+    }
+
+    void Allocator::InvalidateMemory(const Allocation& allocation, const VkDeviceSize offset, const VkDeviceSize size) const
+    {
+        assert(allocation.Valid());
+        if (impl->isCoherent(allocation.MemoryTypeIdx()))
+        {
+            return;
+        }
+        const VkMappedMemoryRange range = impl->mappedRange(allocation, offset, size);
+        VkResult result = vkInvalidateMappedMemoryRanges(impl->device->vkHandle(), 1, &range);
+        VkAssert(result);
+    }
+
+    uint32_t Allocator::FindMemoryTypeIdx(const uint32_t memory_type_bits, const AllocationRequirements& alloc_reqs) const
+    {
+        return impl->findMemoryTypeIdx(memory_type_bits, alloc_reqs);
+    }
+
+    AllocatorStats Allocator::Stats() const
+    {
+        AllocatorStats result;
+        for (uint32_t i = 0u; i < impl->memoryProperties.memoryTypeCount; ++i)
+        {
+            impl->collections[i]->AddStats(result);
+        }
+        return result;
+    }
+
+    bool Allocator::allocateForMove(const Allocation& src, const VkMemoryRequirements& memory_reqs, Allocation& dest_allocation)
+    {
+        assert(src.Valid() && !dest_allocation.Valid());
+        const uint32_t memory_type_idx = src.MemoryTypeIdx();
+        if (src.Dedicated() || (memory_reqs.memoryTypeBits & (1u << memory_type_idx)) == 0u)
+        {
+            return false;
+        }
+
+        if (!impl->collections[memory_type_idx]->AllocateForMove(src, memory_reqs, dest_allocation))
+        {
+            return false;
+        }
+
+        if (src.mappedData != nullptr)
+        {
+            dest_allocation.mappedData = dest_allocation.Map();
+        }
+
+        return true;
+    }
+
+    bool Allocator::canMoveFrom(const Allocation& src, VkDeviceSize* src_block_used)
+    {
+        return src.Valid() && !src.Dedicated() && impl->collections[src.MemoryTypeIdx()]->CanMoveFrom(src, src_block_used);
+    }
+
+    VkDeviceSize Allocator::freeMemory(Allocation& allocation)
+    {
+        if (!allocation.Valid())
+        {
+            return 0u;
+        }
+
+        if (allocation.mappedData != nullptr)
+        {
+            allocation.Unmap();
+        }
+
+        const VkDeviceSize released = impl->collections[allocation.MemoryTypeIdx()]->Free(allocation);
+        allocation.block = nullptr;
+        allocation.mappedData = nullptr;
+        allocation.dedicated = false;
+        allocation.suballocation = Suballocation{};
+        return released;
+    }
+
+    VkDeviceSize Allocator::releaseEmptyBlocks()
+    {
+        VkDeviceSize released = 0u;
+        for (uint32_t i = 0u; i < impl->memoryProperties.memoryTypeCount; ++i)
+        {
+            released += impl->collections[i]->ReleaseEmptyBlocks();
+        }
+        return released;
+    }
+
+    void Allocator::SetMemoryBudget(MemoryBudget* budget)
+    {
+        assert(impl->numDeviceAllocations == 0u);
+        impl->budget = budget;
+    }
+
+    const Device* Allocator::ParentDevice() const noexcept
+    {
+        return impl->device;
+    }
+
+}
@@ -0,0 +1,530 @@
+#include "vpr_stdafx.h"
+#include "Defragmenter.hpp"
+#include "Allocator.hpp"
+#include "Allocation.hpp"
+#include "MemoryBlock.hpp"
+#include "LogicalDevice.hpp"
+#include "vkAssert.hpp"
+#include "CreateInfoBase.hpp"
+#include "easylogging++.h"
+#include <unordered_map>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <utility>
+#include <limits>
+#include <mutex>
+#include <cassert>
+
+namespace vpr
+{
+
+    // Bounds the resources created per Update(), however many moves fail after their destination resource was created
+    constexpr static uint32_t max_move_attempts_per_frame = 32u;
+
+    struct defrag_entry_t
+    {
+        Allocation* allocation{ nullptr };
+        VkBuffer* buffer{ nullptr };
+        VkImage* image{ nullptr };
+        VkBufferCreateInfo bufferInfo{};
+        VkImageCreateInfo imageInfo{};
+        VkImageLayout layout{ VK_IMAGE_LAYOUT_UNDEFINED };
+        VkImageAspectFlags aspect{ 0u };
+        Defragmenter::buffer_moved_callback_t bufferCallback;
+        Defragmenter::image_moved_callback_t imageCallback;
+        // Destination of a move in flight: batch is the index of the batch copying into it
+        VkBuffer newBuffer{ VK_NULL_HANDLE };
+        VkImage newImage{ VK_NULL_HANDLE };
+        Allocation newAllocation;
+        size_t batch{ std::numeric_limits<size_t>::max() };
+        bool moving() const noexcept { return batch != std::numeric_limits<size_t>::max(); }
+    };
+
+    struct defrag_batch_t
+    {
+        VkCommandBuffer cmd{ VK_NULL_HANDLE };
+        VkFence fence{ VK_NULL_HANDLE };
+        std::vector<const Allocation*> moves;
+        bool submitted{ false };
+    };
+
+    struct retired_resource_t
+    {
+        uint64_t destroyFrame{ 0u };
+        VkBuffer buffer{ VK_NULL_HANDLE };
+        VkImage image{ VK_NULL_HANDLE };
+        Allocation allocation;
+    };
+
+    struct DefragmenterImpl
+    {
+        DefragmenterImpl(Allocator* allocator, VkQueue queue, const uint32_t queue_family_idx, const VkDeviceSize max_bytes_per_frame, const uint32_t retire_delay_frames);
+        ~DefragmenterImpl();
+
+        void completeBatches();
+        void completeMove(defrag_entry_t& entry);
+        void destroyRetired(const bool all);
+        void submitMoves();
+        bool beginMove(defrag_entry_t& entry, VkCommandBuffer cmd);
+        void recordImageCopy(const defrag_entry_t& entry, VkCommandBuffer cmd) const;
+        void discardMove(defrag_entry_t& entry);
+        void waitForBatch(defrag_batch_t& batch);
+
+        Allocator* allocator{ nullptr };
+        VkDevice device{ VK_NULL_HANDLE };
+        VkQueue queue{ VK_NULL_HANDLE };
+        VkCommandPool commandPool{ VK_NULL_HANDLE };
+        VkDeviceSize maxBytesPerFrame{ 0u };
+        uint32_t retireDelay{ 0u };
+        uint64_t frameCount{ 0u };
+        std::mutex mutex;
+        std::unordered_map<const Allocation*, defrag_entry_t> entries;
+        // Enough batches for one submission per frame until the first can be recycled
+        std::vector<defrag_batch_t> batches;
+        std::deque<retired_resource_t> retired;
+        DefragmentationStats stats;
+    };
+
+    DefragmenterImpl::DefragmenterImpl(Allocator* _allocator, VkQueue _queue, const uint32_t queue_family_idx, const VkDeviceSize max_bytes_per_frame,
+        const uint32_t retire_delay_frames) : allocator(_allocator), device(_allocator->ParentDevice()->vkHandle()), queue(_queue),
+        maxBytesPerFrame(max_bytes_per_frame), retireDelay(retire_delay_frames), batches(retire_delay_frames + 1u)
+    {
+        VkCommandPoolCreateInfo pool_info = vk_command_pool_info_base;
+        pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        pool_info.queueFamilyIndex = queue_family_idx;
+        VkResult result = vkCreateCommandPool(device, &pool_info, nullptr, &commandPool);
+        VkAssert(result);
+
+        std::vector<VkCommandBuffer> cmds(batches.size());
+        VkCommandBufferAllocateInfo alloc_info = vk_command_buffer_allocate_info_base;
+        alloc_info.commandPool = commandPool;
+        alloc_info.commandBufferCount = static_cast<uint32_t>(cmds.size());
+        result = vkAllocateCommandBuffers(device, &alloc_info, cmds.data());
+        VkAssert(result);
+
+        for (size_t i = 0u; i < batches.size(); ++i)
+        {
+            batches[i].cmd = cmds[i];
+            result = vkCreateFence(device, &vk_fence_create_info_base, nullptr, &batches[i].fence);
+            VkAssert(result);
+        }
+    }
+
+    DefragmenterImpl::~DefragmenterImpl()
+    {
+        for (auto& batch : batches)
+        {
+            waitForBatch(batch);
+            const size_t batch_idx = static_cast<size_t>(&batch - batches.data());
+            for (const Allocation* key : batch.moves)
+            {
+                auto iter = entries.find(key);
+                if (iter != entries.end() && iter->second.batch == batch_idx)
+                {
+                    discardMove(iter->second);
+                }
+            }
+            vkDestroyFence(device, batch.fence, nullptr);
+        }
+        destroyRetired(true);
+        vkDestroyCommandPool(device, commandPool, nullptr);
+    }
+
+    void DefragmenterImpl::waitForBatch(defrag_batch_t& batch)
+    {
+        if (batch.submitted)
+        {
+            VkResult result = vkWaitForFences(device, 1, &batch.fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+            VkAssert(result);
+        }
+    }
+
+    void DefragmenterImpl::completeBatches()
+    {
+        for (auto& batch : batches)
+        {
+            if (!batch.submitted || vkGetFenceStatus(device, batch.fence) != VK_SUCCESS)
+            {
+                continue;
+            }
+
+            const size_t batch_idx = static_cast<size_t>(&batch - batches.data());
+            for (const Allocation* key : batch.moves)
+            {
+                // Entries unregistered while in flight have already discarded their move
+                auto iter = entries.find(key);
+                if (iter != entries.end() && iter->second.batch == batch_idx)
+                {
+                    completeMove(iter->second);
+                }
+            }
+
+            batch.moves.clear();
+            batch.submitted = false;
+            VkResult result = vkResetFences(device, 1, &batch.fence);
+            VkAssert(result);
+            result = vkResetCommandBuffer(batch.cmd, 0);
+            VkAssert(result);
+        }
+    }
+
+    void DefragmenterImpl::completeMove(defrag_entry_t& entry)
+    {
+        retired_resource_t old_resource;
+        old_resource.destroyFrame = frameCount + retireDelay;
+        old_resource.allocation = std::move(*entry.allocation);
+        *entry.allocation = std::move(entry.newAllocation);
+        entry.newAllocation = Allocation();
+        entry.batch = std::numeric_limits<size_t>::max();
+        stats.BytesMoved += entry.allocation->Size();
+        ++stats.NumMoves;
+        --stats.MovesInFlight;
+
+        if (entry.buffer != nullptr)
+        {
+            old_resource.buffer = *entry.buffer;
+            *entry.buffer = entry.newBuffer;
+            entry.newBuffer = VK_NULL_HANDLE;
+            if (entry.bufferCallback)
+            {
+                entry.bufferCallback(*entry.buffer, *entry.allocation);
+            }
+        }
+        else
+        {
+            old_resource.image = *entry.image;
+            *entry.image = entry.newImage;
+            entry.newImage = VK_NULL_HANDLE;
+            if (entry.imageCallback)
+            {
+                entry.imageCallback(*entry.image, *entry.allocation);
+            }
+        }
+
+        retired.emplace_back(std::move(old_resource));
+    }
+
+    void DefragmenterImpl::destroyRetired(const bool all)
+    {
+        bool destroyed_any = false;
+        while (!retired.empty() && (all || retired.front().destroyFrame <= frameCount))
+        {
+            retired_resource_t& resource = retired.front();
+            if (resource.buffer != VK_NULL_HANDLE)
+            {
+                vkDestroyBuffer(device, resource.buffer, nullptr);
+            }
+            if (resource.image != VK_NULL_HANDLE)
+            {
+                vkDestroyImage(device, resource.image, nullptr);
+            }
+            const VkDeviceSize released = allocator->freeMemory(resource.allocation);
+            if (released != 0u)
+            {
+                stats.BytesReclaimed += released;
+                ++stats.BlocksReleased;
+            }
+            retired.pop_front();
+            destroyed_any = true;
+        }
+
+        if (destroyed_any)
+        {
+            // Freeing keeps one empty block around for re-use: compaction is meant to give that memory back
+            const VkDeviceSize released = allocator->releaseEmptyBlocks();
+            if (released != 0u)
+            {
+                stats.BytesReclaimed += released;
+                ++stats.BlocksReleased;
+            }
+        }
+    }
+
+    void DefragmenterImpl::discardMove(defrag_entry_t& entry)
+    {
+        if (entry.newBuffer != VK_NULL_HANDLE)
+        {
+            vkDestroyBuffer(device, entry.newBuffer, nullptr);
+            entry.newBuffer = VK_NULL_HANDLE;
+        }
+        if (entry.newImage != VK_NULL_HANDLE)
+        {
+            vkDestroyImage(device, entry.newImage, nullptr);
+            entry.newImage = VK_NULL_HANDLE;
+        }
+        allocator->freeMemory(entry.newAllocation);
+        if (entry.moving())
+        {
+            --stats.MovesInFlight;
+        }
+        entry.batch = std::numeric_limits<size_t>::max();
+    }
+
+    bool DefragmenterImpl::beginMove(defrag_entry_t& entry, VkCommandBuffer cmd)
+    {
+        VkMemoryRequirements memory_reqs;
+        if (entry.buffer != nullptr)
+        {
+            VkResult result = vkCreateBuffer(device, &entry.bufferInfo, nullptr, &entry.newBuffer);
+            VkAssert(result);
+            vkGetBufferMemoryRequirements(device, entry.newBuffer, &memory_reqs);
+        }
+        else
+        {
+            VkResult result = vkCreateImage(device, &entry.imageInfo, nullptr, &entry.newImage);
+            VkAssert(result);
+            vkGetImageMemoryRequirements(device, entry.newImage, &memory_reqs);
+        }
+
+        if (!allocator->allocateForMove(*entry.allocation, memory_reqs, entry.newAllocation))
+        {
+            discardMove(entry);
+            return false;
+        }
+
+        if (entry.buffer != nullptr)
+        {
+            VkResult result = vkBindBufferMemory(device, entry.newBuffer, entry.newAllocation.Memory(), entry.newAllocation.Offset());
+            VkAssert(result);
+            const VkBufferCopy region{ 0u, 0u, entry.bufferInfo.size };
+            vkCmdCopyBuffer(cmd, *entry.buffer, entry.newBuffer, 1, &region);
+        }
+        else
+        {
+            VkResult result = vkBindImageMemory(device, entry.newImage, entry.newAllocation.Memory(), entry.newAllocation.Offset());
+            VkAssert(result);
+            recordImageCopy(entry, cmd);
+        }
+
+        return true;
+    }
+
+    void DefragmenterImpl::recordImageCopy(const defrag_entry_t& entry, VkCommandBuffer cmd) const
+    {
+        const VkImageSubresourceRange range{ entry.aspect, 0u, entry.imageInfo.mipLevels, 0u, entry.imageInfo.arrayLayers };
+
+        VkImageMemoryBarrier pre_barriers[2]{ vk_image_memory_barrier_base, vk_image_memory_barrier_base };
+        pre_barriers[0].srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+        pre_barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        pre_barriers[0].oldLayout = entry.layout;
+        pre_barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        pre_barriers[0].image = *entry.image;
+        pre_barriers[0].subresourceRange = range;
+        pre_barriers[1].srcAccessMask = 0u;
+        pre_barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        pre_barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        pre_barriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        pre_barriers[1].image = entry.newImage;
+        pre_barriers[1].subresourceRange = range;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 2, pre_barriers);
+
+        std::vector<VkImageCopy> regions(entry.imageInfo.mipLevels);
+        for (uint32_t mip = 0u; mip < entry.imageInfo.mipLevels; ++mip)
+        {
+            VkImageCopy& region = regions[mip];
+            region.srcSubresource = VkImageSubresourceLayers{ entry.aspect, mip, 0u, entry.imageInfo.arrayLayers };
+            region.srcOffset = VkOffset3D{ 0, 0, 0 };
+            region.dstSubresource = region.srcSubresource;
+            region.dstOffset = VkOffset3D{ 0, 0, 0 };
+            region.extent = VkExtent3D{ std::max(entry.imageInfo.extent.width >> mip, 1u), std::max(entry.imageInfo.extent.height >> mip, 1u),
+                std::max(entry.imageInfo.extent.depth >> mip, 1u) };
+        }
+        vkCmdCopyImage(cmd, *entry.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, entry.newImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            static_cast<uint32_t>(regions.size()), regions.data());
+
+        // The old image stays in use until the move completes, so it goes back to its layout as well
+        VkImageMemoryBarrier post_barriers[2]{ pre_barriers[0], pre_barriers[1] };
+        post_barriers[0].srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        post_barriers[0].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+        post_barriers[0].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        post_barriers[0].newLayout = entry.layout;
+        post_barriers[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        post_barriers[1].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+        post_barriers[1].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        post_barriers[1].newLayout = entry.layout;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 2, post_barriers);
+    }
+
+    void DefragmenterImpl::submitMoves()
+    {
+        auto batch_iter = std::find_if(batches.begin(), batches.end(), [](const defrag_batch_t& batch) { return !batch.submitted; });
+        if (batch_iter == batches.end())
+        {
+            return;
+        }
+
+        // Empty the least occupied blocks first: they're the cheapest to release
+        // Entries with nowhere better to go are skipped before creating anything for them: once the heap is compacted, that's all of them
+        // Block occupancy is read once, under the allocator's lock: other threads may be allocating meanwhile, and sorting on live values
+        // would give std::sort an inconsistent ordering
+        std::vector<std::pair<VkDeviceSize, defrag_entry_t*>> candidates;
+        for (auto& entry : entries)
+        {
+            VkDeviceSize block_used = 0u;
+            if (!entry.second.moving() && allocator->canMoveFrom(*entry.second.allocation, &block_used))
+            {
+                candidates.emplace_back(block_used, &entry.second);
+            }
+        }
+
+        if (candidates.empty())
+        {
+            return;
+        }
+
+        std::sort(candidates.begin(), candidates.end(), [](const std::pair<VkDeviceSize, defrag_entry_t*>& a, const std::pair<VkDeviceSize, defrag_entry_t*>& b)
+        {
+            return a.first < b.first;
+        });
+
+        defrag_batch_t& batch = *batch_iter;
+        const size_t batch_idx = static_cast<size_t>(std::distance(batches.begin(), batch_iter));
+        VkResult result = vkBeginCommandBuffer(batch.cmd, &vk_command_buffer_begin_info_base);
+        VkAssert(result);
+
+        VkDeviceSize bytes_recorded = 0u;
+        uint32_t num_attempts = 0u;
+        for (const auto& candidate : candidates)
+        {
+            defrag_entry_t* entry = candidate.second;
+            const VkDeviceSize size = entry->allocation->Size();
+            if (bytes_recorded != 0u && bytes_recorded + size > maxBytesPerFrame)
+            {
+                continue;
+            }
+
+            // Earlier moves this frame may have taken the space this one was counting on
+            if (num_attempts != 0u && !allocator->canMoveFrom(*entry->allocation))
+            {
+                continue;
+            }
+
+            if (num_attempts == max_move_attempts_per_frame)
+            {
+                break;
+            }
+            ++num_attempts;
+
+            if (beginMove(*entry, batch.cmd))
+            {
+                entry->batch = batch_idx;
+                batch.moves.emplace_back(entry->allocation);
+                bytes_recorded += size;
+                ++stats.MovesInFlight;
+            }
+            else
+            {
+                ++stats.SkippedMoves;
+            }
+
+            if (bytes_recorded >= maxBytesPerFrame)
+            {
+                break;
+            }
+        }
+
+        result = vkEndCommandBuffer(batch.cmd);
+        VkAssert(result);
+
+        if (batch.moves.empty())
+        {
+            result = vkResetCommandBuffer(batch.cmd, 0);
+            VkAssert(result);
+            return;
+        }
+
+        VkSubmitInfo submit_info = vk_submit_info_base;
+        submit_info.commandBufferCount = 1u;
+        submit_info.pCommandBuffers = &batch.cmd;
+        result = vkQueueSubmit(queue, 1, &submit_info, batch.fence);
+        VkAssert(result);
+        batch.submitted = true;
+        LOG_IF(VERBOSE_LOGGING, INFO) << "Defragmenter submitted " << batch.moves.size() << " moves totalling " << bytes_recorded << " bytes.";
+    }
+
+    Defragmenter::Defragmenter(Allocator* allocator, VkQueue queue, const uint32_t queue_family_idx, const VkDeviceSize max_bytes_per_frame, const uint32_t retire_delay_frames) :
+        impl(std::make_unique<DefragmenterImpl>(allocator, queue, queue_family_idx, max_bytes_per_frame, retire_delay_frames)) {}
+
+    Defragmenter::~Defragmenter() {}
+
+    void Defragmenter::RegisterBuffer(Allocation* allocation, VkBuffer* buffer, const VkBufferCreateInfo& create_info, buffer_moved_callback_t callback)
+    {
+        assert((create_info.usage & (VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT)) == (VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT));
+        std::lock_guard<std::mutex> lock(impl->mutex);
+        defrag_entry_t& entry = impl->entries[allocation];
+        entry.allocation = allocation;
+        entry.buffer = buffer;
+        entry.bufferInfo = create_info;
+        // Chained structures can't be copied safely
+        entry.bufferInfo.pNext = nullptr;
+        entry.bufferCallback = std::move(callback);
+    }
+
+    void Defragmenter::RegisterImage(Allocation* allocation, VkImage* image, const VkImageCreateInfo& create_info, const VkImageLayout layout,
+        const VkImageAspectFlags aspect, image_moved_callback_t callback)
+    {
+        assert((create_info.usage & (VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT)) == (VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT));
+        assert(layout != VK_IMAGE_LAYOUT_UNDEFINED && layout != VK_IMAGE_LAYOUT_PREINITIALIZED);
+        std::lock_guard<std::mutex> lock(impl->mutex);
+        defrag_entry_t& entry = impl->entries[allocation];
+        entry.allocation = allocation;
+        entry.image = image;
+        entry.imageInfo = create_info;
+        entry.imageInfo.pNext = nullptr;
+        entry.imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        entry.layout = layout;
+        entry.aspect = aspect;
+        entry.imageCallback = std::move(callback);
+    }
+
+    void Defragmenter::SetImageLayout(const Allocation* allocation, const VkImageLayout layout)
+    {
+        assert(layout != VK_IMAGE_LAYOUT_UNDEFINED && layout != VK_IMAGE_LAYOUT_PREINITIALIZED);
+        std::lock_guard<std::mutex> lock(impl->mutex);
+        auto iter = impl->entries.find(allocation);
+        assert(iter != impl->entries.end() && iter->second.image != nullptr);
+        iter->second.layout = layout;
+    }
+
+    void Defragmenter::Unregister(const Allocation* allocation)
+    {
+        std::lock_guard<std::mutex> lock(impl->mutex);
+        auto iter = impl->entries.find(allocation);
+        if (iter == impl->entries.end())
+        {
+            return;
+        }
+
+        defrag_entry_t& entry = iter->second;
+        if (entry.moving())
+        {
+            // Can't destroy the copy while the queue may still be writing to it
+            impl->waitForBatch(impl->batches[entry.batch]);
+            impl->discardMove(entry);
+        }
+        impl->entries.erase(iter);
+    }
+
+    void Defragmenter::Update()
+    {
+        std::lock_guard<std::mutex> lock(impl->mutex);
+        ++impl->frameCount;
+        impl->completeBatches();
+        impl->destroyRetired(false);
+        impl->submitMoves();
+    }
+
+    DefragmentationStats Defragmenter::Stats() const noexcept
+    {
+        std::lock_guard<std::mutex> lock(impl->mutex);
+        return impl->stats;
+    }
+
+    uint32_t Defragmenter::NumRegistered() const noexcept
+    {
+        std::lock_guard<std::mutex> lock(impl->mutex);
+        return static_cast<uint32_t>(impl->entries.size());
+    }
+
+}
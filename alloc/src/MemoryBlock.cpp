@@ -0,0 +1,413 @@
+#include "vpr_stdafx.h"
+#include "MemoryBlock.hpp"
+#include "vkAssert.hpp"
+#include <array>
+#include <unordered_map>
+#include <mutex>
+#include <cassert>
+#include <algorithm>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace vpr
+{
+
+    // Second level splits each power-of-two size class into 16 linear bins
+    constexpr static uint32_t sl_index_count_log2 = 4u;
+    constexpr static uint32_t sl_index_count = 1u << sl_index_count_log2;
+    // Sizes below this are all placed in the first level, in linear bins of (small_block_size / sl_index_count) bytes
+    constexpr static uint32_t small_block_size_log2 = 8u;
+    constexpr static VkDeviceSize small_block_size = VkDeviceSize(1u) << small_block_size_log2;
+    constexpr static uint32_t fl_index_count = 64u - small_block_size_log2 + 1u;
+    // Free space left over after an allocation smaller than this isn't split off into its own region
+    constexpr static VkDeviceSize min_split_size = 16u;
+
+    static uint32_t bit_scan_msb(const uint64_t value) noexcept
+    {
+        assert(value != 0u);
+#if defined(_MSC_VER)
+        unsigned long result;
+        _BitScanReverse64(&result, value);
+        return static_cast<uint32_t>(result);
+#else
+        return 63u - static_cast<uint32_t>(__builtin_clzll(value));
+#endif
+    }
+
+    static uint32_t bit_scan_lsb(const uint64_t value) noexcept
+    {
+        assert(value != 0u);
+#if defined(_MSC_VER)
+        unsigned long result;
+        _BitScanForward64(&result, value);
+        return static_cast<uint32_t>(result);
+#else
+        return static_cast<uint32_t>(__builtin_ctzll(value));
+#endif
+    }
+
+    static VkDeviceSize align_up(const VkDeviceSize value, const VkDeviceSize alignment) noexcept
+    {
+        return ((value + alignment - 1u) / alignment) * alignment;
+    }
+
+    struct tlsf_region_t
+    {
+        VkDeviceSize offset{ 0u };
+        VkDeviceSize size{ 0u };
+        suballocation_type type{ suballocation_type::Free };
+        tlsf_region_t* prevPhysical{ nullptr };
+        tlsf_region_t* nextPhysical{ nullptr };
+        tlsf_region_t* prevFree{ nullptr };
+        tlsf_region_t* nextFree{ nullptr };
+
+        bool isFree() const noexcept
+        {
+            return type == suballocation_type::Free;
+        }
+    };
+
+    struct MemoryBlockImpl
+    {
+        MemoryBlockImpl(const VkDevice dvc, const VkDeviceMemory memory, const uint32_t memory_type_idx, const VkDeviceSize size, const VkDeviceSize granularity);
+        ~MemoryBlockImpl();
+
+        static void mappingInsert(const VkDeviceSize size, uint32_t& fl, uint32_t& sl) noexcept;
+        static void mappingSearch(VkDeviceSize size, uint32_t& fl, uint32_t& sl) noexcept;
+        tlsf_region_t* findFreeRegion(uint32_t fl, uint32_t sl) const noexcept;
+        tlsf_region_t* findFittingRegion(const VkDeviceSize size, const VkDeviceSize alignment) const noexcept;
+        void insertFree(tlsf_region_t* region) noexcept;
+        void removeFree(tlsf_region_t* region) noexcept;
+        tlsf_region_t* splitFront(tlsf_region_t* region, const VkDeviceSize front_size);
+        void mergeWithNext(tlsf_region_t* region) noexcept;
+
+        VkDevice device{ VK_NULL_HANDLE };
+        VkDeviceMemory memory{ VK_NULL_HANDLE };
+        uint32_t memoryTypeIdx{ 0u };
+        VkDeviceSize size{ 0u };
+        VkDeviceSize bufferImageGranularity{ 1u };
+        VkDeviceSize usedBytes{ 0u };
+
+        uint64_t flBitmap{ 0u };
+        std::array<uint32_t, fl_index_count> slBitmaps{};
+        std::array<std::array<tlsf_region_t*, sl_index_count>, fl_index_count> freeLists{};
+        tlsf_region_t* firstRegion{ nullptr };
+        std::unordered_map<VkDeviceSize, tlsf_region_t*> usedRegions;
+
+        std::mutex mapMutex;
+        void* mappedPtr{ nullptr };
+        uint32_t mapCount{ 0u };
+    };
+
+    MemoryBlockImpl::MemoryBlockImpl(const VkDevice dvc, const VkDeviceMemory mem, const uint32_t memory_type_idx, const VkDeviceSize _size, const VkDeviceSize granularity) :
+        device(dvc), memory(mem), memoryTypeIdx(memory_type_idx), size(_size), bufferImageGranularity(granularity)
+    {
+        firstRegion = new tlsf_region_t;
+        firstRegion->size = size;
+        insertFree(firstRegion);
+    }
+
+    MemoryBlockImpl::~MemoryBlockImpl()
+    {
+        tlsf_region_t* region = firstRegion;
+        while (region != nullptr)
+        {
+            tlsf_region_t* next = region->nextPhysical;
+            delete region;
+            region = next;
+        }
+
+        if (mappedPtr != nullptr)
+        {
+            vkUnmapMemory(device, memory);
+        }
+        vkFreeMemory(device, memory, nullptr);
+    }
+
+    void MemoryBlockImpl::mappingInsert(const VkDeviceSize size, uint32_t& fl, uint32_t& sl) noexcept
+    {
+        if (size < small_block_size)
+        {
+            fl = 0u;
+            sl = static_cast<uint32_t>(size / (small_block_size / sl_index_count));
+        }
+        else
+        {
+            const uint32_t msb = bit_scan_msb(size);
+            sl = static_cast<uint32_t>(size >> (msb - sl_index_count_log2)) ^ sl_index_count;
+            fl = msb - small_block_size_log2 + 1u;
+        }
+    }
+
+    void MemoryBlockImpl::mappingSearch(VkDeviceSize size, uint32_t& fl, uint32_t& sl) noexcept
+    {
+        // Round up to the next bin boundary, so that any region in the resulting bin is large enough
+        if (size >= small_block_size)
+        {
+            size += (VkDeviceSize(1u) << (bit_scan_msb(size) - sl_index_count_log2)) - 1u;
+        }
+        else
+        {
+            size += (small_block_size / sl_index_count) - 1u;
+        }
+        mappingInsert(size, fl, sl);
+    }
+
+    tlsf_region_t* MemoryBlockImpl::findFreeRegion(uint32_t fl, uint32_t sl) const noexcept
+    {
+        if (fl >= fl_index_count)
+        {
+            return nullptr;
+        }
+
+        uint32_t sl_map = slBitmaps[fl] & (~0u << sl);
+        if (sl_map == 0u)
+        {
+            if (fl + 1u >= fl_index_count)
+            {
+                return nullptr;
+            }
+            const uint64_t fl_map = flBitmap & (~uint64_t(0u) << (fl + 1u));
+            if (fl_map == 0u)
+            {
+                return nullptr;
+            }
+            fl = bit_scan_lsb(fl_map);
+            sl_map = slBitmaps[fl];
+        }
+
+        sl = bit_scan_lsb(sl_map);
+        return freeLists[fl][sl];
+    }
+
+    tlsf_region_t* MemoryBlockImpl::findFittingRegion(const VkDeviceSize alloc_size, const VkDeviceSize alignment) const noexcept
+    {
+        uint32_t fl = 0u;
+        uint32_t sl = 0u;
+        mappingSearch(alloc_size, fl, sl);
+        tlsf_region_t* region = findFreeRegion(fl, sl);
+        if (region != nullptr && align_up(region->offset, alignment) + alloc_size <= region->offset + region->size)
+        {
+            return region;
+        }
+
+        // First candidate can't fit once aligned: search again, reserving enough space for worst-case alignment padding
+        if (alignment > 1u)
+        {
+            mappingSearch(alloc_size + alignment - 1u, fl, sl);
+            return findFreeRegion(fl, sl);
+        }
+
+        return nullptr;
+    }
+
+    void MemoryBlockImpl::insertFree(tlsf_region_t* region) noexcept
+    {
+        uint32_t fl = 0u;
+        uint32_t sl = 0u;
+        mappingInsert(region->size, fl, sl);
+        region->type = suballocation_type::Free;
+        region->prevFree = nullptr;
+        region->nextFree = freeLists[fl][sl];
+        if (region->nextFree != nullptr)
+        {
+            region->nextFree->prevFree = region;
+        }
+        freeLists[fl][sl] = region;
+        flBitmap |= (uint64_t(1u) << fl);
+        slBitmaps[fl] |= (1u << sl);
+    }
+
+    void MemoryBlockImpl::removeFree(tlsf_region_t* region) noexcept
+    {
+        uint32_t fl = 0u;
+        uint32_t sl = 0u;
+        mappingInsert(region->size, fl, sl);
+        if (region->prevFree != nullptr)
+        {
+            region->prevFree->nextFree = region->nextFree;
+        }
+        else
+        {
+            freeLists[fl][sl] = region->nextFree;
+            if (freeLists[fl][sl] == nullptr)
+            {
+                slBitmaps[fl] &= ~(1u << sl);
+                if (slBitmaps[fl] == 0u)
+                {
+                    flBitmap &= ~(uint64_t(1u) << fl);
+                }
+            }
+        }
+
+        if (region->nextFree != nullptr)
+        {
+            region->nextFree->prevFree = region->prevFree;
+        }
+
+        region->prevFree = nullptr;
+        region->nextFree = nullptr;
+    }
+
+    tlsf_region_t* MemoryBlockImpl::splitFront(tlsf_region_t* region, const VkDeviceSize front_size)
+    {
+        // Region must not be in a free list: returns the back half, leaving region as the front half
+        tlsf_region_t* back = new tlsf_region_t;
+        back->offset = region->offset + front_size;
+        back->size = region->size - front_size;
+        back->prevPhysical = region;
+        back->nextPhysical = region->nextPhysical;
+        if (back->nextPhysical != nullptr)
+        {
+            back->nextPhysical->prevPhysical = back;
+        }
+        region->nextPhysical = back;
+        region->size = front_size;
+        return back;
+    }
+
+    void MemoryBlockImpl::mergeWithNext(tlsf_region_t* region) noexcept
+    {
+        tlsf_region_t* next = region->nextPhysical;
+        region->size += next->size;
+        region->nextPhysical = next->nextPhysical;
+        if (region->nextPhysical != nullptr)
+        {
+            region->nextPhysical->prevPhysical = region;
+        }
+        delete next;
+    }
+
+    MemoryBlock::MemoryBlock(const VkDevice dvc, const VkDeviceMemory memory, const uint32_t memory_type_idx, const VkDeviceSize size, const VkDeviceSize buffer_image_granularity) :
+        impl(std::make_unique<MemoryBlockImpl>(dvc, memory, memory_type_idx, size, buffer_image_granularity)) {}
+
+    MemoryBlock::~MemoryBlock() {}
+
+    bool MemoryBlock::Allocate(const VkDeviceSize size, VkDeviceSize alignment, const suballocation_type type, Suballocation& result)
+    {
+        VkDeviceSize alloc_size = size != 0u ? size : 1u;
+        alignment = alignment != 0u ? alignment : 1u;
+
+        if ((type == suballocation_type::ImageOptimal || type == suballocation_type::Unknown) && impl->bufferImageGranularity > 1u)
+        {
+            // Make the resource exclusive owner of every granularity page it touches: its neighbours then can't conflict with it
+            alignment = std::max(alignment, impl->bufferImageGranularity);
+            alloc_size = align_up(alloc_size, impl->bufferImageGranularity);
+        }
+
+        tlsf_region_t* region = impl->findFittingRegion(alloc_size, alignment);
+        if (region == nullptr)
+        {
+            return false;
+        }
+
+        impl->removeFree(region);
+
+        const VkDeviceSize aligned_offset = align_up(region->offset, alignment);
+        const VkDeviceSize padding = aligned_offset - region->offset;
+        if (padding != 0u)
+        {
+            tlsf_region_t* aligned_region = impl->splitFront(region, padding);
+            impl->insertFree(region);
+            region = aligned_region;
+        }
+
+        if (region->size - alloc_size >= min_split_size)
+        {
+            // Free regions are never adjacent to each other, so the remainder can't be merged with anything
+            tlsf_region_t* remainder = impl->splitFront(region, alloc_size);
+            impl->insertFree(remainder);
+        }
+
+        region->type = type;
+        impl->usedBytes += region->size;
+        impl->usedRegions.emplace(region->offset, region);
+
+        result.Offset = region->offset;
+        result.Size = size;
+        result.Type = type;
+        return true;
+    }
+
+    void MemoryBlock::Free(const Suballocation& suballocation)
+    {
+        auto iter = impl->usedRegions.find(suballocation.Offset);
+        assert(iter != impl->usedRegions.end());
+        tlsf_region_t* region = iter->second;
+        impl->usedRegions.erase(iter);
+        impl->usedBytes -= region->size;
+        region->type = suballocation_type::Free;
+
+        if (region->nextPhysical != nullptr && region->nextPhysical->isFree())
+        {
+            impl->removeFree(region->nextPhysical);
+            impl->mergeWithNext(region);
+        }
+
+        if (region->prevPhysical != nullptr && region->prevPhysical->isFree())
+        {
+            tlsf_region_t* prev = region->prevPhysical;
+            impl->removeFree(prev);
+            impl->mergeWithNext(prev);
+            region = prev;
+        }
+
+        impl->insertFree(region);
+    }
+
+    void* MemoryBlock::Map()
+    {
+        std::lock_guard<std::mutex> guard(impl->mapMutex);
+        if (impl->mapCount == 0u)
+        {
+            VkResult result = vkMapMemory(impl->device, impl->memory, 0, VK_WHOLE_SIZE, 0, &impl->mappedPtr);
+            VkAssert(result);
+        }
+        ++impl->mapCount;
+        return impl->mappedPtr;
+    }
+
+    void MemoryBlock::Unmap()
+    {
+        std::lock_guard<std::mutex> guard(impl->mapMutex);
+        assert(impl->mapCount > 0u);
+        --impl->mapCount;
+        if (impl->mapCount == 0u)
+        {
+            vkUnmapMemory(impl->device, impl->memory);
+            impl->mappedPtr = nullptr;
+        }
+    }
+
+    VkDeviceMemory MemoryBlock::Memory() const noexcept
+    {
+        return impl->memory;
+    }
+
+    uint32_t MemoryBlock::MemoryTypeIdx() const noexcept
+    {
+        return impl->memoryTypeIdx;
+    }
+
+    VkDeviceSize MemoryBlock::Size() const noexcept
+    {
+        return impl->size;
+    }
+
+    VkDeviceSize MemoryBlock::UsedBytes() const noexcept
+    {
+        return impl->usedBytes;
+    }
+
+    size_t MemoryBlock::NumAllocations() const noexcept
+    {
+        return impl->usedRegions.size();
+    }
+
+    bool MemoryBlock::Empty() const noexcept
+    {
+        return impl->usedRegions.empty();
+    }
+
+}
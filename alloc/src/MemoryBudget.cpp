@@ -0,0 +1,215 @@
+#include "vpr_stdafx.h"
+#include "MemoryBudget.hpp"
+#include "LogicalDevice.hpp"
+#include "PhysicalDevice.hpp"
+#include "Instance.hpp"
+#include "CreateInfoBase.hpp"
+#include "easylogging++.h"
+#include <array>
+#include <atomic>
+#include <vector>
+#include <mutex>
+#include <cassert>
+
+namespace vpr
+{
+
+    struct threshold_entry_t
+    {
+        float threshold;
+        MemoryBudget::threshold_callback_t callback;
+        std::array<bool, VK_MAX_MEMORY_HEAPS> exceeded;
+    };
+
+    struct MemoryBudgetImpl
+    {
+        MemoryBudgetImpl(const Device* dvc);
+        void queryBudgets();
+        HeapBudget getHeapBudget(const uint32_t heap_idx) const noexcept;
+
+        const Device* device{ nullptr };
+        VkPhysicalDeviceMemoryProperties memoryProperties;
+        PFN_vkGetPhysicalDeviceMemoryProperties2KHR getMemoryProperties2{ nullptr };
+        // Budget and usage as of the last query, along with allocator bytes at that time: allocations made since are added on top of the usage
+        std::array<std::atomic<VkDeviceSize>, VK_MAX_MEMORY_HEAPS> budgets;
+        std::array<std::atomic<VkDeviceSize>, VK_MAX_MEMORY_HEAPS> queriedUsage;
+        std::array<std::atomic<VkDeviceSize>, VK_MAX_MEMORY_HEAPS> queriedAllocatorBytes;
+        std::array<std::atomic<VkDeviceSize>, VK_MAX_MEMORY_HEAPS> allocatorBytes;
+        std::mutex callbackMutex;
+        std::vector<threshold_entry_t> thresholds;
+        MemoryBudget::eviction_callback_t evictionCallback;
+    };
+
+    MemoryBudgetImpl::MemoryBudgetImpl(const Device* dvc) : device(dvc), memoryProperties(dvc->GetPhysicalDeviceMemoryProperties())
+    {
+        for (uint32_t i = 0u; i < VK_MAX_MEMORY_HEAPS; ++i)
+        {
+            budgets[i] = 0u;
+            queriedUsage[i] = 0u;
+            queriedAllocatorBytes[i] = 0u;
+            allocatorBytes[i] = 0u;
+        }
+
+        if (device->HasExtension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME))
+        {
+            const Instance* instance = device->ParentInstance();
+            if (instance->ApplicationInfo().apiVersion >= VK_API_VERSION_1_1)
+            {
+                getMemoryProperties2 = vkGetPhysicalDeviceMemoryProperties2;
+            }
+            else if (instance->HasExtension(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME))
+            {
+                getMemoryProperties2 = reinterpret_cast<PFN_vkGetPhysicalDeviceMemoryProperties2KHR>(
+                    vkGetInstanceProcAddr(instance->vkHandle(), "vkGetPhysicalDeviceMemoryProperties2KHR"));
+            }
+        }
+
+        LOG_IF(getMemoryProperties2 == nullptr, INFO) << "VK_EXT_memory_budget unavailable: memory budgets will be estimated from heap sizes.";
+        queryBudgets();
+    }
+
+    void MemoryBudgetImpl::queryBudgets()
+    {
+        if (getMemoryProperties2 != nullptr)
+        {
+            VkPhysicalDeviceMemoryBudgetPropertiesEXT budget_props = vk_physical_device_memory_budget_properties_ext_base;
+            VkPhysicalDeviceMemoryProperties2KHR memory_props = vk_physical_device_memory_properties_2_khr_base;
+            memory_props.pNext = &budget_props;
+            getMemoryProperties2(device->GetPhysicalDevice().vkHandle(), &memory_props);
+            for (uint32_t i = 0u; i < memoryProperties.memoryHeapCount; ++i)
+            {
+                budgets[i] = budget_props.heapBudget[i];
+                queriedUsage[i] = budget_props.heapUsage[i];
+                queriedAllocatorBytes[i] = allocatorBytes[i].load();
+            }
+        }
+        else
+        {
+            for (uint32_t i = 0u; i < memoryProperties.memoryHeapCount; ++i)
+            {
+                // Leave headroom for the driver, other processes, and memory allocated outside of vpr
+                budgets[i] = memoryProperties.memoryHeaps[i].size / 10u * 8u;
+                queriedUsage[i] = 0u;
+                queriedAllocatorBytes[i] = 0u;
+            }
+        }
+    }
+
+    HeapBudget MemoryBudgetImpl::getHeapBudget(const uint32_t heap_idx) const noexcept
+    {
+        HeapBudget result;
+        result.Size = memoryProperties.memoryHeaps[heap_idx].size;
+        result.Flags = memoryProperties.memoryHeaps[heap_idx].flags;
+        result.Budget = budgets[heap_idx].load();
+        result.AllocatorBytes = allocatorBytes[heap_idx].load();
+        const VkDeviceSize queried_usage = queriedUsage[heap_idx].load();
+        const VkDeviceSize queried_bytes = queriedAllocatorBytes[heap_idx].load();
+        if (result.AllocatorBytes >= queried_bytes)
+        {
+            result.Usage = queried_usage + (result.AllocatorBytes - queried_bytes);
+        }
+        else
+        {
+            const VkDeviceSize freed = queried_bytes - result.AllocatorBytes;
+            result.Usage = queried_usage > freed ? queried_usage - freed : 0u;
+        }
+        return result;
+    }
+
+    MemoryBudget::MemoryBudget(const Device* device) : impl(std::make_unique<MemoryBudgetImpl>(device)) {}
+
+    MemoryBudget::~MemoryBudget() {}
+
+    void MemoryBudget::Update()
+    {
+        impl->queryBudgets();
+
+        std::vector<std::pair<threshold_callback_t, std::pair<uint32_t, bool>>> triggered;
+        {
+            std::lock_guard<std::mutex> lock(impl->callbackMutex);
+            for (auto& entry : impl->thresholds)
+            {
+                for (uint32_t i = 0u; i < impl->memoryProperties.memoryHeapCount; ++i)
+                {
+                    const HeapBudget budget = impl->getHeapBudget(i);
+                    const bool exceeded = budget.Budget != 0u &&
+                        static_cast<double>(budget.Usage) > static_cast<double>(budget.Budget) * static_cast<double>(entry.threshold);
+                    if (exceeded != entry.exceeded[i])
+                    {
+                        entry.exceeded[i] = exceeded;
+                        triggered.emplace_back(entry.callback, std::make_pair(i, exceeded));
+                    }
+                }
+            }
+        }
+
+        // Run outside of the lock, so callbacks can add further callbacks
+        for (auto& trigger : triggered)
+        {
+            trigger.first(trigger.second.first, impl->getHeapBudget(trigger.second.first), trigger.second.second);
+        }
+    }
+
+    void MemoryBudget::AddThresholdCallback(const float threshold, threshold_callback_t callback)
+    {
+        std::lock_guard<std::mutex> lock(impl->callbackMutex);
+        threshold_entry_t entry{ threshold, std::move(callback), {} };
+        entry.exceeded.fill(false);
+        impl->thresholds.emplace_back(std::move(entry));
+    }
+
+    void MemoryBudget::SetEvictionCallback(eviction_callback_t callback)
+    {
+        std::lock_guard<std::mutex> lock(impl->callbackMutex);
+        impl->evictionCallback = std::move(callback);
+    }
+
+    bool MemoryBudget::CanAllocate(const uint32_t heap_idx, const VkDeviceSize size) const noexcept
+    {
+        const HeapBudget budget = impl->getHeapBudget(heap_idx);
+        return budget.Usage + size <= budget.Budget;
+    }
+
+    VkDeviceSize MemoryBudget::Evict(const uint32_t heap_idx, const VkDeviceSize bytes_needed)
+    {
+        eviction_callback_t callback;
+        {
+            std::lock_guard<std::mutex> lock(impl->callbackMutex);
+            callback = impl->evictionCallback;
+        }
+        if (!callback)
+        {
+            return 0u;
+        }
+        const VkDeviceSize freed = callback(heap_idx, bytes_needed);
+        LOG_IF(VERBOSE_LOGGING, INFO) << "Eviction callback freed " << freed << " of " << bytes_needed << " bytes requested from heap " << heap_idx;
+        return freed;
+    }
+
+    void MemoryBudget::NotifyAllocated(const uint32_t heap_idx, const VkDeviceSize size) noexcept
+    {
+        impl->allocatorBytes[heap_idx].fetch_add(size);
+    }
+
+    void MemoryBudget::NotifyFreed(const uint32_t heap_idx, const VkDeviceSize size) noexcept
+    {
+        impl->allocatorBytes[heap_idx].fetch_sub(size);
+    }
+
+    HeapBudget MemoryBudget::GetHeapBudget(const uint32_t heap_idx) const noexcept
+    {
+        assert(heap_idx < impl->memoryProperties.memoryHeapCount);
+        return impl->getHeapBudget(heap_idx);
+    }
+
+    uint32_t MemoryBudget::NumHeaps() const noexcept
+    {
+        return impl->memoryProperties.memoryHeapCount;
+    }
+
+    bool MemoryBudget::UsingBudgetExtension() const noexcept
+    {
+        return impl->getMemoryProperties2 != nullptr;
+    }
+
+}
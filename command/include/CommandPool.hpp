@@ -4,18 +4,28 @@
 #include "vpr_stdafx.h"
 #include "ForwardDecl.hpp"
 #include <memory>
+#include <limits>
 
 namespace vpr
 {
 
     struct CommandBuffers;
 
+    /**Opaque handle to a single-shot submission made via CommandPool::EndSingleCmdBufferAsync. Only valid for use with the pool that returned it.
+    *   \ingroup Command
+    */
+    struct VPR_API SingleCmdSubmission
+    {
+        uint64_t Id{ 0u };
+    };
+
     /** The Command group encompasses classes related to recording commands, submitting commands, and allocating/freeing/resetting VkCommandBuffer objects.
     *   \defgroup Command
     */
 
     /** The CommandPool class is the primary interface through which one will acquire VkCommandBuffer objects. The quantity of command buffers is not selected
-    *    upon construction: only the command buffer level, primary or secondary. Before use, one must call AllocateCmdBuffers or risk exceptions. StartSingleCmdBuffer
+    *    upon construction: only the command buffer level, primary or secondary. Before use, one must call AllocateCmdBuffers or risk exceptions (or use
+    *    AcquireCmdBuffer/ReleaseCmdBuffer, which grow the pool in chunks as needed). StartSingleCmdBuffer
     *    and EndSingleCmdBuffer can be used to retrieve (relatively wasteful, don't do it while rendering) single-shot command buffers for things like binding resources
     *    to sparse buffers, submitting transfers, or performing image layout transitions.'
     *    \todo Remove the bool "primary" index from the constructor, only accepting the VkCommandPoolCreateInfo struct
@@ -34,7 +44,25 @@ namespace vpr
         ~CommandPool();
 
 
+        /** Allocates the indexed command buffers retrieved via GetCmdBuffer/operator[]. If buffers already exist and num_buffers is greater than the
+        *   current quantity, only the difference is allocated and appended: existing buffers (and their indices) remain valid.
+        */
         void AllocateCmdBuffers(const uint32_t num_buffers, const VkCommandBufferLevel cmd_buffer_level);
+
+        /** Retrieves a command buffer from this pool's incremental allocator, which is separate from the indexed buffers created by AllocateCmdBuffers.
+        *   Buffers are taken from a free-list of previously released buffers when possible, and otherwise are allocated in chunks (of the size given
+        *   to SetCmdBufferChunkSize) so that the pool grows with demand without needing to be destroyed and recreated.
+        */
+        VkCommandBuffer AcquireCmdBuffer(const VkCommandBufferLevel cmd_buffer_level = VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+        /** Returns a buffer retrieved from AcquireCmdBuffer to the free-list. It must not be pending execution. If this pool was created with
+        *   VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT, the buffer is reset immediately and is available for re-use at once. Otherwise, it becomes
+        *   available after the next call to ResetCmdPool.
+        */
+        void ReleaseCmdBuffer(VkCommandBuffer cmd_buffer, const VkCommandBufferLevel cmd_buffer_level = VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+        /** Sets how many command buffers AcquireCmdBuffer allocates at once when the free-list is empty. Defaults to 16.*/
+        void SetCmdBufferChunkSize(const uint32_t chunk_size) noexcept;
+        /** Total number of buffers the incremental allocator has created, including those currently acquired.*/
+        size_t NumChunkAllocatedBuffers() const noexcept;
         
         /** Resets the entire command pool via a call to VkResetCommandPool. Uses VK_COMMAND_POOL_RESET_RELEASE_RESOURCES_BIT by default, which releases
         *   all resources that the Vulkan implementation internally allocates. This may take time, and may require re-allocation upon reinitialization
@@ -52,7 +80,8 @@ namespace vpr
         void ResetCmdBuffer(const size_t idx, const VkCommandBufferResetFlagBits command_buffer_reset_flag_bits = VK_COMMAND_BUFFER_RESET_RELEASE_RESOURCES_BIT);
         
         /** Frees the memory used for all command buffers in this pool, which effectively "deletes" them, unlike resetting a single command buffer or even resetting
-        *   the entire pool. This will require calling AllocateCmdBuffers again, as it ultimately resets the object into its base state.
+        *   the entire pool. This will require calling AllocateCmdBuffers again, as it ultimately resets the object into its base state. Only affects
+        *   the indexed buffers: those from AcquireCmdBuffer are unaffected. Capacity of the internal storage is retained, for re-allocation later.
         */
         void FreeCommandBuffers();
     
@@ -69,6 +98,26 @@ namespace vpr
         VkCommandBuffer StartSingleCmdBuffer();
         void EndSingleCmdBuffer(VkCommandBuffer& cmd_buffer, const VkQueue & queue);
 
+        /**Ends and submits a command buffer retrieved from StartSingleCmdBuffer, but does not wait on the queue to go idle. Instead, the submission
+        *   is tagged with a fence drawn from an internal pool, and the returned handle can be used with PollSingleCmdBuffer and WaitSingleCmdBuffer.
+        *   The command buffer is returned to this pool (for re-use by StartSingleCmdBuffer) only once the fence shows the device is done with it.
+        *   Like all other methods on this class, this is not thread-safe: the pool must be externally synchronized.
+        *   \param cmd_buffer Must have been retrieved from StartSingleCmdBuffer on this pool, and is invalid for use by the caller after this call.
+        */
+        SingleCmdSubmission EndSingleCmdBufferAsync(VkCommandBuffer cmd_buffer, const VkQueue& queue);
+        /**Returns true if the given submission has completed execution. Also recycles the command buffers and fences of any other submissions that have completed.*/
+        bool PollSingleCmdBuffer(const SingleCmdSubmission& submission);
+        /**Blocks until the given submission completes or the timeout (in nanoseconds) elapses. Returns VK_SUCCESS or VK_TIMEOUT.*/
+        VkResult WaitSingleCmdBuffer(const SingleCmdSubmission& submission, const uint64_t timeout = std::numeric_limits<uint64_t>::max());
+        /**Returns the fence of the given submission, or VK_NULL_HANDLE if it's already known to have completed. Lets a caller that externally
+        *   synchronizes this pool block on the fence without holding its lock: fences aren't reset for re-use while any are held, so the fence
+        *   stays valid to wait on. Call ReleaseSingleCmdBufferFence (with the pool synchronized again) once done waiting, then poll the submission.
+        */
+        VkFence HoldSingleCmdBufferFence(const SingleCmdSubmission& submission);
+        void ReleaseSingleCmdBufferFence();
+        /**Blocks until all outstanding single-shot submissions have completed.*/
+        void WaitAllSingleCmdBuffers();
+
         const size_t size() const noexcept;
 
         const VkCommandBuffer* Data() const noexcept;
@@ -76,6 +125,7 @@ namespace vpr
     private:
 
         void destroy();
+        void recycleCompletedSubmissions();
         VkCommandPool handle;
         std::unique_ptr<CommandBuffers> cmdBuffers;
         VkDevice parent;
@@ -0,0 +1,67 @@
+#pragma once
+#ifndef VULPES_VK_COMMAND_POOL_RING_HPP
+#define VULPES_VK_COMMAND_POOL_RING_HPP
+#include "vpr_stdafx.h"
+#include "ForwardDecl.hpp"
+#include <memory>
+
+namespace vpr
+{
+
+    struct CommandPoolRingImpl;
+
+    /**The CommandPoolRing owns one CommandPool per (thread, frame-in-flight) pair, so that many worker threads can record commands
+     * without ever sharing a VkCommandPool (and thus without any locking). Command buffers are handed out linearly from the pool
+     * belonging to the calling thread's index and the currently active frame: once a frame's fence has retired, BeginFrame() resets
+     * every pool for that frame with a single vkResetCommandPool call and rewinds the linear allocators back to zero.
+     *
+     * This means no per-buffer vkResetCommandBuffer calls, and no freeing/reallocating of command buffers: buffers are only allocated
+     * when a thread uses more in a frame than it ever has before, and are retained (and recycled) from then on.
+     *
+     * Pools are created with VK_COMMAND_POOL_CREATE_TRANSIENT_BIT and without VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT, which
+     * lets implementations use simpler linear allocators internally. Thread indices are user-assigned (e.g, a worker's index in a job
+     * system) and must be less than the thread count given at construction: each index must only ever be used by one thread at a time.
+     * \ingroup Command
+     */
+    class VPR_API CommandPoolRing
+    {
+        CommandPoolRing(const CommandPoolRing&) = delete;
+        CommandPoolRing& operator=(const CommandPoolRing&) = delete;
+    public:
+
+        /**Creates num_threads * num_frames command pools, all using the given queue family.
+         * \param num_threads Quantity of threads that will be recording commands concurrently.
+         * \param num_frames Quantity of frames that can be in-flight at once (usually 2 or 3).
+         */
+        CommandPoolRing(const VkDevice device, const uint32_t queue_family_idx, const size_t num_threads, const size_t num_frames);
+        ~CommandPoolRing();
+        CommandPoolRing(CommandPoolRing&& other) noexcept;
+        CommandPoolRing& operator=(CommandPoolRing&& other) noexcept;
+
+        /**Makes the given frame the active one, resetting all of its pools and their linear allocators. Command buffers previously
+         * retrieved for this frame become invalid after this call. Must not be called while threads are still recording into this frame.
+         * \param frame_idx Index of the frame to begin, modulo the number of frames given at construction.
+         * \param frame_fence If not VK_NULL_HANDLE, this fence is waited on before the pools are reset. It should be the fence last passed to
+         * vkQueueSubmit alongside this frame's command buffers. It is not reset by this method.
+         */
+        void BeginFrame(const size_t frame_idx, const VkFence frame_fence = VK_NULL_HANDLE);
+
+        /**Retrieves a fresh command buffer from the pool for the given thread in the current frame. Allocates more buffers if the thread has
+         * exhausted those previously allocated. The returned buffer is in the initial state, and must still be begun by the caller.
+         */
+        VkCommandBuffer AllocateCmdBuffer(const size_t thread_idx, const VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+
+        /**Direct access to the pool used by the given thread for the current frame.*/
+        CommandPool& GetPool(const size_t thread_idx);
+
+        size_t CurrentFrame() const noexcept;
+        size_t NumThreads() const noexcept;
+        size_t NumFrames() const noexcept;
+
+    private:
+        std::unique_ptr<CommandPoolRingImpl> impl;
+    };
+
+}
+
+#endif //!VULPES_VK_COMMAND_POOL_RING_HPP
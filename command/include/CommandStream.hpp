@@ -0,0 +1,84 @@
+#pragma once
+#ifndef VULPES_VK_COMMAND_STREAM_HPP
+#define VULPES_VK_COMMAND_STREAM_HPP
+#include "vpr_stdafx.h"
+#include "ForwardDecl.hpp"
+#include <memory>
+
+namespace vpr
+{
+
+    struct CommandStreamImpl;
+
+    /**Results of the last call to CommandStream::Optimize().
+     * \ingroup Command
+     */
+    struct VPR_API CommandStreamStats
+    {
+        size_t CommandsRecorded{ 0u };
+        size_t CommandsAfterOptimization{ 0u };
+        /**Pipeline, descriptor set, vertex/index buffer binds and dynamic state commands dropped because they set state that was already current.*/
+        size_t RedundantStateRemoved{ 0u };
+        /**Quantity of pipeline barriers folded into an adjacent barrier.*/
+        size_t BarriersMerged{ 0u };
+    };
+
+    /**A CommandStream is a deferred, CPU-side recording of commands: calls to it mirror their vkCmd* equivalents, but only append compact
+     * commands to a linear buffer owned by this object. Once recording is done, Optimize() removes binds and dynamic state that would not
+     * change the current state (e.g binding the same pipeline twice in a row) and merges adjacent pipeline barriers. Replay() then records the
+     * stream into a real VkCommandBuffer, such as one retrieved from a CommandPool.
+     *
+     * Streams can be replayed any number of times, into any number of command buffers, so content that doesn't change can be recorded and
+     * optimized once then cheaply replayed every frame. Only handles and plain data are stored: any Vulkan objects referenced must still be
+     * alive when Replay() is called.
+     *
+     * Barriers are only merged when they don't reference the same buffer or image, as layout transitions of the same subresource can't occur
+     * twice in one barrier. State tracking is conservative: binding a pipeline forgets the current viewport and scissor (as the pipeline may
+     * have them as static state), and binding descriptor sets with a new pipeline layout forgets all tracked descriptor sets.
+     * \ingroup Command
+     */
+    class VPR_API CommandStream
+    {
+        CommandStream(const CommandStream&) = delete;
+        CommandStream& operator=(const CommandStream&) = delete;
+    public:
+
+        CommandStream();
+        ~CommandStream();
+        CommandStream(CommandStream&& other) noexcept;
+        CommandStream& operator=(CommandStream&& other) noexcept;
+
+        void BindPipeline(const VkPipelineBindPoint bind_point, const VkPipeline pipeline);
+        void BindDescriptorSets(const VkPipelineBindPoint bind_point, const VkPipelineLayout layout, const uint32_t first_set, const uint32_t set_count,
+            const VkDescriptorSet* sets, const uint32_t dynamic_offset_count = 0u, const uint32_t* dynamic_offsets = nullptr);
+        void BindVertexBuffers(const uint32_t first_binding, const uint32_t binding_count, const VkBuffer* buffers, const VkDeviceSize* offsets);
+        void BindIndexBuffer(const VkBuffer buffer, const VkDeviceSize offset, const VkIndexType index_type);
+        void SetViewport(const uint32_t first_viewport, const uint32_t viewport_count, const VkViewport* viewports);
+        void SetScissor(const uint32_t first_scissor, const uint32_t scissor_count, const VkRect2D* scissors);
+        void PushConstants(const VkPipelineLayout layout, const VkShaderStageFlags stages, const uint32_t offset, const uint32_t size, const void* values);
+        void Draw(const uint32_t vertex_count, const uint32_t instance_count, const uint32_t first_vertex, const uint32_t first_instance);
+        void DrawIndexed(const uint32_t index_count, const uint32_t instance_count, const uint32_t first_index, const int32_t vertex_offset, const uint32_t first_instance);
+        void Dispatch(const uint32_t group_count_x, const uint32_t group_count_y, const uint32_t group_count_z);
+        void PipelineBarrier(const VkPipelineStageFlags src_stages, const VkPipelineStageFlags dst_stages, const VkDependencyFlags dependency_flags,
+            const uint32_t num_memory_barriers, const VkMemoryBarrier* memory_barriers, const uint32_t num_buffer_barriers, const VkBufferMemoryBarrier* buffer_barriers,
+            const uint32_t num_image_barriers, const VkImageMemoryBarrier* image_barriers);
+
+        /**Rewrites the stream in-place, removing redundant state and merging adjacent barriers. Safe to call more than once.*/
+        void Optimize();
+        /**Records every command in this stream into the given command buffer, which must be in the recording state.*/
+        void Replay(VkCommandBuffer cmd) const;
+        /**Removes all commands and resets Stats(), but keeps the memory allocated for them for re-use.*/
+        void Clear() noexcept;
+
+        size_t NumCommands() const noexcept;
+        /**Bytes of memory used by the recorded commands.*/
+        size_t SizeInBytes() const noexcept;
+        const CommandStreamStats& Stats() const noexcept;
+
+    private:
+        std::unique_ptr<CommandStreamImpl> impl;
+    };
+
+}
+
+#endif //!VULPES_VK_COMMAND_STREAM_HPP
@@ -0,0 +1,66 @@
+#pragma once
+#ifndef VULPES_VK_PARALLEL_CMD_RECORDER_HPP
+#define VULPES_VK_PARALLEL_CMD_RECORDER_HPP
+#include "vpr_stdafx.h"
+#include "ForwardDecl.hpp"
+#include <memory>
+#include <functional>
+
+namespace vpr
+{
+
+    class CommandPoolRing;
+    struct ParallelCmdRecorderImpl;
+
+    /**Builds inheritance info for secondary command buffers that will execute within the given subpass of a renderpass, from vk_command_buffer_inheritance_info_base.
+     * \param renderpass Usually retrieved from Renderpass::vkHandle() for the renderpass currently active in the primary command buffer.
+     * \param framebuffer Can be VK_NULL_HANDLE, but specifying it may let implementations optimize the secondary command buffers.
+     * \ingroup Command
+     */
+    VPR_API VkCommandBufferInheritanceInfo MakeSecondaryInheritanceInfo(const VkRenderPass renderpass, const uint32_t subpass, const VkFramebuffer framebuffer = VK_NULL_HANDLE) noexcept;
+
+    /**The ParallelCmdRecorder splits a list of draw/dispatch jobs for a single renderpass across a pool of worker threads. Jobs are grouped into
+     * contiguous chunks, with each chunk recorded into its own secondary command buffer. Chunks are initially dealt out evenly to per-worker queues,
+     * and workers that run out of work steal chunks from the front of other workers' queues, so uneven job costs still balance across threads.
+     *
+     * Once all chunks have been recorded, the secondary command buffers are executed from the primary command buffer with one vkCmdExecuteCommands
+     * call, in chunk order: the result is deterministic, and identical to recording the jobs in order on a single thread.
+     *
+     * Command buffers are allocated from the given CommandPoolRing, with each worker using its own thread index (and thus its own VkCommandPool).
+     * The ring's thread count determines the quantity of workers: NumThreads() - 1 background threads are created, and the thread calling Record()
+     * participates as the last worker. Call CommandPoolRing::BeginFrame before recording, as usual.
+     * \ingroup Command
+     */
+    class VPR_API ParallelCmdRecorder
+    {
+        ParallelCmdRecorder(const ParallelCmdRecorder&) = delete;
+        ParallelCmdRecorder& operator=(const ParallelCmdRecorder&) = delete;
+    public:
+
+        /**Function called once per job, from an arbitrary worker thread. Must only record into the given command buffer, and must be safe to call concurrently.*/
+        using RecordFunction = std::function<void(VkCommandBuffer cmd, const size_t job_idx)>;
+
+        ParallelCmdRecorder(CommandPoolRing* ring);
+        /**Joins all worker threads.*/
+        ~ParallelCmdRecorder();
+
+        /**Records num_jobs jobs into secondary command buffers across the worker threads, blocking until recording is complete. Then executes these
+         * buffers from the primary command buffer. The primary buffer must be in a renderpass instance begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS,
+         * matching the inheritance info given.
+         * \param jobs_per_buffer Quantity of jobs recorded into each secondary command buffer: too small and the overhead of vkCmdExecuteCommands dominates,
+         * too large and there won't be enough chunks to balance the work between threads.
+         */
+        void Record(VkCommandBuffer primary, const VkCommandBufferInheritanceInfo& inheritance, const size_t num_jobs, const RecordFunction& record_fn,
+            const size_t jobs_per_buffer = 256u);
+
+        size_t NumWorkers() const noexcept;
+        /**Returns how many chunks were stolen by workers other than the one they were originally assigned to during the last call to Record().*/
+        size_t LastStealCount() const noexcept;
+
+    private:
+        std::unique_ptr<ParallelCmdRecorderImpl> impl;
+    };
+
+}
+
+#endif //!VULPES_VK_PARALLEL_CMD_RECORDER_HPP
@@ -0,0 +1,69 @@
+#pragma once
+#ifndef VULPES_VK_QUEUE_HPP
+#define VULPES_VK_QUEUE_HPP
+#include "vpr_stdafx.h"
+#include "ForwardDecl.hpp"
+#include <memory>
+
+namespace vpr
+{
+
+    struct QueueImpl;
+
+    /**Statistics gathered by a Queue over its lifetime.
+     * \ingroup Command
+     */
+    struct VPR_API QueueStats
+    {
+        /**Quantity of VkSubmitInfo structures given to Submit().*/
+        uint64_t NumSubmissions{ 0u };
+        /**Quantity of vkQueueSubmit calls made by the submit thread: the ratio between this and NumSubmissions shows how much merging occured.*/
+        uint64_t NumQueueSubmits{ 0u };
+        /**Largest quantity of VkSubmitInfo structures merged into one vkQueueSubmit call.*/
+        uint64_t MaxSubmissionsPerCall{ 0u };
+    };
+
+    /**A Queue owns all submission to a single VkQueue, retrieved from Device::GraphicsQueue(), Device::ComputeQueue() and so on. Submit() copies
+     * the submission into a lock-free intake list and returns immediately, so any number of threads can submit at once without blocking on each
+     * other or inside the driver. A dedicated thread drains the intake and hands everything pending to the driver with one vkQueueSubmit call,
+     * preserving the order in which submissions entered the intake.
+     *
+     * As the submit thread is now the only user of the VkQueue, it alone satisfies the queue's external synchronization requirements: once a VkQueue
+     * is given to a Queue, only call vkQueueSubmit or vkQueueWaitIdle on it through this object.
+     *
+     * Submissions given a fence end the batch they are in, as vkQueueSubmit only accepts a single fence: the fence will signal once all submissions
+     * up to and including that one have completed.
+     * \ingroup Command
+     */
+    class VPR_API Queue
+    {
+        Queue(const Queue&) = delete;
+        Queue& operator=(const Queue&) = delete;
+    public:
+
+        /**Starts the submit thread.*/
+        Queue(const VkQueue queue);
+        /**Submits anything still pending, then joins the submit thread.*/
+        ~Queue();
+
+        /**Copies the arrays referenced by the submit info, so they need not outlive this call. If the first structure in the pNext chain is a
+         * VkTimelineSemaphoreSubmitInfo, it and its value arrays are copied as well. The rest of the pNext chain is not copied: if used, it must 
+         * remain valid until the submission has been handed to the driver, which Flush() can be used to guarantee.
+         * \param fence Optional fence to signal once this submission (and all submitted before it) completes.
+         */
+        void Submit(const VkSubmitInfo& submit_info, const VkFence fence = VK_NULL_HANDLE);
+        /**Wakes the submit thread and blocks until all work given to Submit() before this call has been handed to the driver.*/
+        void Flush();
+        /**Flushes, then waits for the underlying VkQueue to become idle.*/
+        void WaitIdle();
+
+        const VkQueue& vkHandle() const noexcept;
+        QueueStats Stats() const;
+
+    private:
+        std::unique_ptr<QueueImpl> impl;
+    };
+
+}
+
+#endif //!VULPES_VK_QUEUE_HPP
@@ -0,0 +1,98 @@
+#pragma once
+#ifndef VULPES_VK_TRANSFER_BATCHER_HPP
+#define VULPES_VK_TRANSFER_BATCHER_HPP
+#include "vpr_stdafx.h"
+#include "ForwardDecl.hpp"
+#include "CommandPool.hpp"
+#include <memory>
+#include <chrono>
+#include <functional>
+
+namespace vpr
+{
+
+    struct TransferBatcherImpl;
+
+    /**Statistics gathered by a TransferBatcher over its lifetime, useful for tuning the size and latency thresholds.
+     * \ingroup Command
+     */
+    struct VPR_API TransferBatchStats
+    {
+        /**Total number of vkQueueSubmit calls made by the batcher.*/
+        uint64_t NumFlushes{ 0u };
+        /**Total number of recording operations (copies, barriers, user callbacks) across all batches.*/
+        uint64_t NumOperations{ 0u };
+        /**Total bytes reported as transferred across all batches.*/
+        VkDeviceSize BytesTransferred{ 0u };
+        /**Flushes that occured because the batch exceeded the size threshold.*/
+        uint64_t SizeTriggeredFlushes{ 0u };
+        /**Flushes that occured because the oldest operation in the batch exceeded the latency threshold.*/
+        uint64_t LatencyTriggeredFlushes{ 0u };
+        /**Flushes that occured from explicit calls to Flush() or EndFrame().*/
+        uint64_t ExplicitFlushes{ 0u };
+        /**Largest quantity of operations coalesced into a single submission.*/
+        uint64_t MaxOperationsPerBatch{ 0u };
+        /**Largest quantity of bytes coalesced into a single submission.*/
+        VkDeviceSize MaxBytesPerBatch{ 0u };
+    };
+
+    /**The TransferBatcher coalesces transfer work from many callers into a single command buffer, which is submitted with one vkQueueSubmit
+     * call once it exceeds a size threshold, once the oldest work in it exceeds a latency threshold, or at the end of a frame. This replaces
+     * issuing a StartSingleCmdBuffer/EndSingleCmdBuffer pair (and thus an allocation, submit, and full queue idle) per upload.
+     *
+     * The queue given should usually be retrieved via Device::TransferQueue(), along with the transfer queue family index from Device::QueueFamilyIndices().
+     * Submissions are non-blocking, and are built on CommandPool::EndSingleCmdBufferAsync: the handle returned by Flush() can be waited on
+     * with Wait() before using the destination resources on the host, or before freeing the source (staging) resources.
+     *
+     * All recording methods are thread-safe, and may be called from any number of threads at once. Thresholds are checked after each recording
+     * operation, and in Update(): call Update() once per frame (or more often) so that latency-triggered flushes still occur when no new work arrives.
+     * \ingroup Command
+     */
+    class VPR_API TransferBatcher
+    {
+        TransferBatcher(const TransferBatcher&) = delete;
+        TransferBatcher& operator=(const TransferBatcher&) = delete;
+    public:
+
+        /**\param flush_size_threshold Once the bytes recorded into the current batch exceed this, it is submitted.
+         * \param max_latency Once the oldest operation in the current batch has waited this long, the batch is submitted.
+         */
+        TransferBatcher(const VkDevice device, const VkQueue transfer_queue, const uint32_t transfer_queue_family_idx,
+            const VkDeviceSize flush_size_threshold, const std::chrono::microseconds max_latency);
+        ~TransferBatcher();
+        TransferBatcher(TransferBatcher&& other) noexcept;
+        TransferBatcher& operator=(TransferBatcher&& other) noexcept;
+
+        void CopyBuffer(const VkBuffer src, const VkBuffer dst, const uint32_t num_regions, const VkBufferCopy* regions);
+        /**\param bytes_transferred Size of the source data, as texel sizes aren't known here. Used for the size threshold and statistics.*/
+        void CopyBufferToImage(const VkBuffer src, const VkImage dst, const VkImageLayout dst_layout, const uint32_t num_regions, const VkBufferImageCopy* regions,
+            const VkDeviceSize bytes_transferred);
+        void PipelineBarrier(const VkPipelineStageFlags src_stages, const VkPipelineStageFlags dst_stages, const VkDependencyFlags dependency_flags,
+            const uint32_t num_memory_barriers, const VkMemoryBarrier* memory_barriers, const uint32_t num_buffer_barriers, const VkBufferMemoryBarrier* buffer_barriers,
+            const uint32_t num_image_barriers, const VkImageMemoryBarrier* image_barriers);
+        /**Records arbitrary commands into the current batch, with the batch lock held for the duration of the callback.
+         * \param bytes_transferred Quantity of bytes the recorded work transfers, used for the size threshold and statistics.
+         */
+        void Record(const std::function<void(VkCommandBuffer)>& record_fn, const VkDeviceSize bytes_transferred);
+
+        /**Checks the latency threshold, flushing the current batch if required.*/
+        void Update();
+        /**Submits the current batch, if it is not empty. Returns the handle of the most recent submission made by this batcher.*/
+        SingleCmdSubmission Flush();
+        /**Identical to Flush(), intended to be called once all transfer work for a frame has been recorded.*/
+        SingleCmdSubmission EndFrame();
+        /**Waits on a submission returned from Flush() or EndFrame(). Returns VK_SUCCESS or VK_TIMEOUT.*/
+        VkResult Wait(const SingleCmdSubmission& submission, const uint64_t timeout = std::numeric_limits<uint64_t>::max());
+        /**Returns true if the submission returned from Flush() or EndFrame() has completed.*/
+        bool Poll(const SingleCmdSubmission& submission);
+
+        TransferBatchStats Stats() const;
+        void ResetStats();
+
+    private:
+        std::unique_ptr<TransferBatcherImpl> impl;
+    };
+
+}
+
+#endif //!VULPES_VK_TRANSFER_BATCHER_HPP
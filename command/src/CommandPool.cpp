@@ -7,6 +7,8 @@
 INITIALIZE_EASYLOGGINGPP
 #endif
 #include <vector>
+#include <algorithm>
+#include <cassert>
 namespace vpr
 {
 
@@ -15,17 +17,73 @@ namespace vpr
         LOG(INFO) << "Updating easyloggingpp storage pointer in vpr_command module...";
     }
 
+    struct pending_submission_t
+    {
+        uint64_t Id;
+        VkCommandBuffer CmdBuffer;
+        VkFence Fence;
+    };
+
     struct CommandBuffers  {
         std::vector<VkCommandBuffer> Data;
+        VkCommandPoolCreateFlags CreateFlags{ 0 };
+        // Single-shot buffers that have finished executing and been reset, ready for re-use
+        std::vector<VkCommandBuffer> SingleCmdFreeList;
+        std::vector<pending_submission_t> PendingSubmissions;
+        std::vector<VkFence> AvailableFences;
+        // Signaled fences that still need resetting: we reset these in batches, right before we need more fences
+        std::vector<VkFence> RetiredFences;
+        // Fences handed out by HoldSingleCmdBufferFence: retired fences can't be reset while someone may still be waiting on them
+        uint32_t NumHeldFences{ 0u };
+        uint64_t NextSubmissionId{ 1u };
+        // Incremental allocator state: per-level free-lists, and buffers awaiting a pool reset before re-use
+        uint32_t ChunkSize{ 16u };
+        size_t NumChunkAllocated{ 0u };
+        std::vector<VkCommandBuffer> FreePrimary;
+        std::vector<VkCommandBuffer> FreeSecondary;
+        std::vector<VkCommandBuffer> AwaitingResetPrimary;
+        std::vector<VkCommandBuffer> AwaitingResetSecondary;
+        VkFence acquireFence(const VkDevice device);
     };
 
+    VkFence CommandBuffers::acquireFence(const VkDevice device)
+    {
+        if (AvailableFences.empty() && !RetiredFences.empty() && NumHeldFences == 0u)
+        {
+            VkResult result = vkResetFences(device, static_cast<uint32_t>(RetiredFences.size()), RetiredFences.data());
+            VkAssert(result);
+            AvailableFences.swap(RetiredFences);
+        }
+
+        if (!AvailableFences.empty())
+        {
+            VkFence fence = AvailableFences.back();
+            AvailableFences.pop_back();
+            return fence;
+        }
+
+        VkFence fence{ VK_NULL_HANDLE };
+        VkFenceCreateInfo fence_info = vk_fence_create_info_base;
+        VkResult result = vkCreateFence(device, &fence_info, nullptr, &fence);
+        VkAssert(result);
+        return fence;
+    }
+
     CommandPool::CommandPool(const VkDevice _parent, const VkCommandPoolCreateInfo & create_info) : parent(_parent), handle(VK_NULL_HANDLE), cmdBuffers(std::make_unique<CommandBuffers>()) {
         vkCreateCommandPool(parent, &create_info, nullptr, &handle);
+        cmdBuffers->CreateFlags = create_info.flags;
     }
 
     void CommandPool::ResetCmdPool(const VkCommandPoolResetFlagBits command_pool_reset_flags)
     {
         vkResetCommandPool(parent, handle, command_pool_reset_flags);
+        // Released buffers that couldn't be individually reset are now back in the initial state
+        auto& free_primary = cmdBuffers->FreePrimary;
+        auto& free_secondary = cmdBuffers->FreeSecondary;
+        free_primary.insert(free_primary.end(), cmdBuffers->AwaitingResetPrimary.cbegin(), cmdBuffers->AwaitingResetPrimary.cend());
+        free_secondary.insert(free_secondary.end(), cmdBuffers->AwaitingResetSecondary.cbegin(), cmdBuffers->AwaitingResetSecondary.cend());
+        cmdBuffers->AwaitingResetPrimary.clear();
+        cmdBuffers->AwaitingResetSecondary.clear();
     }
 
     CommandPool::CommandPool(CommandPool && other) noexcept
@@ -38,6 +96,13 @@ namespace vpr
 
     CommandPool & CommandPool::operator=(CommandPool && other) noexcept
     {
+        if (this == &other)
+        {
+            return *this;
+        }
+
+        // Our own pool, fences and in-flight submissions would otherwise be abandoned
+        destroy();
         handle = std::move(other.handle);
         cmdBuffers = std::move(other.cmdBuffers);
         parent = std::move(other.parent);
@@ -52,6 +117,29 @@ namespace vpr
 
     void CommandPool::destroy()
     {
+        if (!cmdBuffers)
+        {
+            return;
+        }
+
+        if (!cmdBuffers->PendingSubmissions.empty())
+        {
+            WaitAllSingleCmdBuffers();
+        }
+
+        for (auto& fence : cmdBuffers->AvailableFences)
+        {
+            vkDestroyFence(parent, fence, nullptr);
+        }
+
+        for (auto& fence : cmdBuffers->RetiredFences)
+        {
+            vkDestroyFence(parent, fence, nullptr);
+        }
+
+        cmdBuffers->AvailableFences.clear();
+        cmdBuffers->RetiredFences.clear();
+
         if (!cmdBuffers->Data.empty())
         {
             FreeCommandBuffers();
@@ -68,18 +156,20 @@ namespace vpr
     void CommandPool::AllocateCmdBuffers(const uint32_t num_buffers, const VkCommandBufferLevel cmd_buffer_level)
     {
 
-        if (!cmdBuffers->Data.empty())
+        const size_t prev_size = cmdBuffers->Data.size();
+        if (num_buffers <= prev_size)
         {
             return;
         }
 
+        const uint32_t num_to_allocate = num_buffers - static_cast<uint32_t>(prev_size);
         cmdBuffers->Data.resize(num_buffers);
         VkCommandBufferAllocateInfo alloc_info = vk_command_buffer_allocate_info_base;
         alloc_info.commandPool = handle;
-        alloc_info.commandBufferCount = num_buffers;
+        alloc_info.commandBufferCount = num_to_allocate;
         alloc_info.level = cmd_buffer_level;
-        VkResult result = vkAllocateCommandBuffers(parent, &alloc_info, cmdBuffers->Data.data());
-        LOG_IF(VERBOSE_LOGGING, INFO) << std::to_string(num_buffers) << " command buffers allocated for command pool " << handle;
+        VkResult result = vkAllocateCommandBuffers(parent, &alloc_info, cmdBuffers->Data.data() + prev_size);
+        LOG_IF(VERBOSE_LOGGING, INFO) << std::to_string(num_to_allocate) << " command buffers allocated for command pool " << handle;
         VkAssert(result);
     }
 
@@ -88,7 +178,55 @@ namespace vpr
         vkFreeCommandBuffers(parent, handle, static_cast<uint32_t>(cmdBuffers->Data.size()), cmdBuffers->Data.data());
         LOG_IF(VERBOSE_LOGGING, INFO) << std::to_string(cmdBuffers->Data.size()) << " command buffers freed.";
         cmdBuffers->Data.clear();
-        cmdBuffers->Data.shrink_to_fit();
+    }
+
+    VkCommandBuffer CommandPool::AcquireCmdBuffer(const VkCommandBufferLevel cmd_buffer_level)
+    {
+        auto& free_list = (cmd_buffer_level == VK_COMMAND_BUFFER_LEVEL_PRIMARY) ? cmdBuffers->FreePrimary : cmdBuffers->FreeSecondary;
+
+        if (free_list.empty())
+        {
+            const size_t chunk_size = static_cast<size_t>(cmdBuffers->ChunkSize);
+            free_list.resize(chunk_size, VK_NULL_HANDLE);
+            VkCommandBufferAllocateInfo alloc_info = vk_command_buffer_allocate_info_base;
+            alloc_info.commandPool = handle;
+            alloc_info.commandBufferCount = cmdBuffers->ChunkSize;
+            alloc_info.level = cmd_buffer_level;
+            VkResult result = vkAllocateCommandBuffers(parent, &alloc_info, free_list.data());
+            VkAssert(result);
+            cmdBuffers->NumChunkAllocated += chunk_size;
+            LOG_IF(VERBOSE_LOGGING, INFO) << "Allocated chunk of " << std::to_string(chunk_size) << " command buffers for command pool " << handle;
+        }
+
+        VkCommandBuffer result = free_list.back();
+        free_list.pop_back();
+        return result;
+    }
+
+    void CommandPool::ReleaseCmdBuffer(VkCommandBuffer cmd_buffer, const VkCommandBufferLevel cmd_buffer_level)
+    {
+        const bool primary = (cmd_buffer_level == VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+        if (cmdBuffers->CreateFlags & VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT)
+        {
+            // Don't release resources: this buffer is likely to be re-used for similar work soon
+            VkResult result = vkResetCommandBuffer(cmd_buffer, 0);
+            VkAssert(result);
+            (primary ? cmdBuffers->FreePrimary : cmdBuffers->FreeSecondary).emplace_back(cmd_buffer);
+        }
+        else
+        {
+            (primary ? cmdBuffers->AwaitingResetPrimary : cmdBuffers->AwaitingResetSecondary).emplace_back(cmd_buffer);
+        }
+    }
+
+    void CommandPool::SetCmdBufferChunkSize(const uint32_t chunk_size) noexcept
+    {
+        cmdBuffers->ChunkSize = std::max(chunk_size, 1u);
+    }
+
+    size_t CommandPool::NumChunkAllocatedBuffers() const noexcept
+    {
+        return cmdBuffers->NumChunkAllocated;
     }
 
     void CommandPool::ResetCmdBuffer(const size_t idx, const VkCommandBufferResetFlagBits command_buffer_reset_flag_bits)
@@ -118,14 +256,22 @@ namespace vpr
 
     VkCommandBuffer CommandPool::StartSingleCmdBuffer()
     {
-        VkCommandBufferAllocateInfo allocInfo = {};
-        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        allocInfo.commandPool = handle;
-        allocInfo.commandBufferCount = 1;
+        VkCommandBuffer commandBuffer{ VK_NULL_HANDLE };
 
-        VkCommandBuffer commandBuffer;
-        vkAllocateCommandBuffers(parent, &allocInfo, &commandBuffer);
+        if (!cmdBuffers->SingleCmdFreeList.empty())
+        {
+            commandBuffer = cmdBuffers->SingleCmdFreeList.back();
+            cmdBuffers->SingleCmdFreeList.pop_back();
+        }
+        else
+        {
+            VkCommandBufferAllocateInfo allocInfo = {};
+            allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            allocInfo.commandPool = handle;
+            allocInfo.commandBufferCount = 1;
+            vkAllocateCommandBuffers(parent, &allocInfo, &commandBuffer);
+        }
 
         VkCommandBufferBeginInfo beginInfo = {};
         beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -155,6 +301,125 @@ namespace vpr
         VkAssert(result);
     }
 
+    SingleCmdSubmission CommandPool::EndSingleCmdBufferAsync(VkCommandBuffer cmd_buffer, const VkQueue& queue)
+    {
+        VkResult result = vkEndCommandBuffer(cmd_buffer);
+        VkAssert(result);
+
+        // Good time to reclaim anything that has finished, so the fence and buffer free-lists stay warm
+        recycleCompletedSubmissions();
+        VkFence fence = cmdBuffers->acquireFence(parent);
+
+        VkSubmitInfo submitInfo = vk_submit_info_base;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &cmd_buffer;
+
+        result = vkQueueSubmit(queue, 1, &submitInfo, fence);
+        VkAssert(result);
+
+        const uint64_t id = cmdBuffers->NextSubmissionId++;
+        cmdBuffers->PendingSubmissions.emplace_back(pending_submission_t{ id, cmd_buffer, fence });
+        return SingleCmdSubmission{ id };
+    }
+
+    bool CommandPool::PollSingleCmdBuffer(const SingleCmdSubmission& submission)
+    {
+        recycleCompletedSubmissions();
+        auto iter = std::find_if(cmdBuffers->PendingSubmissions.cbegin(), cmdBuffers->PendingSubmissions.cend(),
+            [id = submission.Id](const pending_submission_t& pending) { return pending.Id == id; });
+        return iter == cmdBuffers->PendingSubmissions.cend();
+    }
+
+    VkResult CommandPool::WaitSingleCmdBuffer(const SingleCmdSubmission& submission, const uint64_t timeout)
+    {
+        auto iter = std::find_if(cmdBuffers->PendingSubmissions.cbegin(), cmdBuffers->PendingSubmissions.cend(),
+            [id = submission.Id](const pending_submission_t& pending) { return pending.Id == id; });
+
+        if (iter == cmdBuffers->PendingSubmissions.cend())
+        {
+            // Already completed and recycled
+            return VK_SUCCESS;
+        }
+
+        VkResult result = vkWaitForFences(parent, 1, &iter->Fence, VK_TRUE, timeout);
+        if (result == VK_TIMEOUT)
+        {
+            return result;
+        }
+        VkAssert(result);
+
+        recycleCompletedSubmissions();
+        return VK_SUCCESS;
+    }
+
+    VkFence CommandPool::HoldSingleCmdBufferFence(const SingleCmdSubmission& submission)
+    {
+        auto iter = std::find_if(cmdBuffers->PendingSubmissions.cbegin(), cmdBuffers->PendingSubmissions.cend(),
+            [id = submission.Id](const pending_submission_t& pending) { return pending.Id == id; });
+
+        if (iter == cmdBuffers->PendingSubmissions.cend())
+        {
+            return VK_NULL_HANDLE;
+        }
+
+        ++cmdBuffers->NumHeldFences;
+        return iter->Fence;
+    }
+
+    void CommandPool::ReleaseSingleCmdBufferFence()
+    {
+        assert(cmdBuffers->NumHeldFences != 0u);
+        --cmdBuffers->NumHeldFences;
+    }
+
+    void CommandPool::WaitAllSingleCmdBuffers()
+    {
+        if (cmdBuffers->PendingSubmissions.empty())
+        {
+            return;
+        }
+
+        std::vector<VkFence> fences;
+        fences.reserve(cmdBuffers->PendingSubmissions.size());
+        for (const auto& pending : cmdBuffers->PendingSubmissions)
+        {
+            fences.emplace_back(pending.Fence);
+        }
+
+        VkResult result = vkWaitForFences(parent, static_cast<uint32_t>(fences.size()), fences.data(), VK_TRUE, std::numeric_limits<uint64_t>::max());
+        VkAssert(result);
+        recycleCompletedSubmissions();
+    }
+
+    void CommandPool::recycleCompletedSubmissions()
+    {
+        auto& pending = cmdBuffers->PendingSubmissions;
+        const bool can_reset_buffers = (cmdBuffers->CreateFlags & VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT) != 0;
+
+        auto iter = std::remove_if(pending.begin(), pending.end(), [&](const pending_submission_t& submission)
+        {
+            if (vkGetFenceStatus(parent, submission.Fence) != VK_SUCCESS)
+            {
+                return false;
+            }
+
+            cmdBuffers->RetiredFences.emplace_back(submission.Fence);
+            if (can_reset_buffers)
+            {
+                VkResult result = vkResetCommandBuffer(submission.CmdBuffer, 0);
+                VkAssert(result);
+                cmdBuffers->SingleCmdFreeList.emplace_back(submission.CmdBuffer);
+            }
+            else
+            {
+                vkFreeCommandBuffers(parent, handle, 1, &submission.CmdBuffer);
+            }
+            return true;
+        });
+
+        pending.erase(iter, pending.end());
+    }
+
     const size_t CommandPool::size() const noexcept
     {
         return cmdBuffers->Data.size();
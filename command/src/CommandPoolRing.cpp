@@ -0,0 +1,141 @@
+#include "vpr_stdafx.h"
+#include "CommandPoolRing.hpp"
+#include "CommandPool.hpp"
+#include "vkAssert.hpp"
+#include "CreateInfoBase.hpp"
+#include "easylogging++.h"
+#include <vector>
+#include <algorithm>
+
+namespace vpr
+{
+
+    // Slots are written to by different threads: padding them out to a cache line avoids false sharing of the cursors.
+    struct alignas(64) ring_slot_t
+    {
+        ring_slot_t(const VkDevice device, const VkCommandPoolCreateInfo& info) : pool(device, info) {}
+        CommandPool pool;
+        std::vector<VkCommandBuffer> primary;
+        std::vector<VkCommandBuffer> secondary;
+        size_t primaryUsed{ 0u };
+        size_t secondaryUsed{ 0u };
+    };
+
+    struct CommandPoolRingImpl
+    {
+        CommandPoolRingImpl(const VkDevice dvc, const uint32_t queue_family_idx, const size_t num_threads, const size_t num_frames);
+        ring_slot_t& slot(const size_t thread_idx);
+        void grow(ring_slot_t& slot, std::vector<VkCommandBuffer>& buffers, const VkCommandBufferLevel level);
+        VkDevice device{ VK_NULL_HANDLE };
+        size_t numThreads{ 0u };
+        size_t numFrames{ 0u };
+        size_t currentFrame{ 0u };
+        // Laid out frame-major: all of the threads for frame 0, then all of the threads for frame 1, etc
+        std::vector<ring_slot_t> slots;
+    };
+
+    constexpr static size_t min_ring_chunk_size = 4u;
+
+    CommandPoolRingImpl::CommandPoolRingImpl(const VkDevice dvc, const uint32_t queue_family_idx, const size_t num_threads, const size_t num_frames) :
+        device(dvc), numThreads(num_threads), numFrames(num_frames)
+    {
+        assert(num_threads > 0 && num_frames > 0);
+        VkCommandPoolCreateInfo pool_info = vk_command_pool_info_base;
+        pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        pool_info.queueFamilyIndex = queue_family_idx;
+        slots.reserve(num_threads * num_frames);
+        for (size_t i = 0; i < num_threads * num_frames; ++i)
+        {
+            slots.emplace_back(device, pool_info);
+        }
+    }
+
+    ring_slot_t& CommandPoolRingImpl::slot(const size_t thread_idx)
+    {
+        assert(thread_idx < numThreads);
+        return slots[currentFrame * numThreads + thread_idx];
+    }
+
+    void CommandPoolRingImpl::grow(ring_slot_t& slot, std::vector<VkCommandBuffer>& buffers, const VkCommandBufferLevel level)
+    {
+        const size_t prev_size = buffers.size();
+        const size_t chunk_size = std::max(prev_size, min_ring_chunk_size);
+        buffers.resize(prev_size + chunk_size, VK_NULL_HANDLE);
+
+        VkCommandBufferAllocateInfo alloc_info = vk_command_buffer_allocate_info_base;
+        alloc_info.commandPool = slot.pool.vkHandle();
+        alloc_info.level = level;
+        alloc_info.commandBufferCount = static_cast<uint32_t>(chunk_size);
+        VkResult result = vkAllocateCommandBuffers(device, &alloc_info, buffers.data() + prev_size);
+        VkAssert(result);
+        LOG_IF(VERBOSE_LOGGING, INFO) << std::to_string(chunk_size) << " command buffers added to ring command pool " << slot.pool.vkHandle();
+    }
+
+    CommandPoolRing::CommandPoolRing(const VkDevice device, const uint32_t queue_family_idx, const size_t num_threads, const size_t num_frames) :
+        impl(std::make_unique<CommandPoolRingImpl>(device, queue_family_idx, num_threads, num_frames)) {}
+
+    CommandPoolRing::~CommandPoolRing() {}
+
+    CommandPoolRing::CommandPoolRing(CommandPoolRing&& other) noexcept : impl(std::move(other.impl)) {}
+
+    CommandPoolRing& CommandPoolRing::operator=(CommandPoolRing&& other) noexcept
+    {
+        impl = std::move(other.impl);
+        return *this;
+    }
+
+    void CommandPoolRing::BeginFrame(const size_t frame_idx, const VkFence frame_fence)
+    {
+        if (frame_fence != VK_NULL_HANDLE)
+        {
+            VkResult result = vkWaitForFences(impl->device, 1, &frame_fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+            VkAssert(result);
+        }
+
+        impl->currentFrame = frame_idx % impl->numFrames;
+        for (size_t i = 0; i < impl->numThreads; ++i)
+        {
+            ring_slot_t& slot = impl->slot(i);
+            // Don't release resources: we're going to immediately re-use the same amount of memory again this frame
+            slot.pool.ResetCmdPool(VkCommandPoolResetFlagBits(0));
+            slot.primaryUsed = 0u;
+            slot.secondaryUsed = 0u;
+        }
+    }
+
+    VkCommandBuffer CommandPoolRing::AllocateCmdBuffer(const size_t thread_idx, const VkCommandBufferLevel level)
+    {
+        ring_slot_t& slot = impl->slot(thread_idx);
+        const bool primary = (level == VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+        std::vector<VkCommandBuffer>& buffers = primary ? slot.primary : slot.secondary;
+        size_t& used = primary ? slot.primaryUsed : slot.secondaryUsed;
+
+        if (used == buffers.size())
+        {
+            impl->grow(slot, buffers, level);
+        }
+
+        return buffers[used++];
+    }
+
+    CommandPool& CommandPoolRing::GetPool(const size_t thread_idx)
+    {
+        return impl->slot(thread_idx).pool;
+    }
+
+    size_t CommandPoolRing::CurrentFrame() const noexcept
+    {
+        return impl->currentFrame;
+    }
+
+    size_t CommandPoolRing::NumThreads() const noexcept
+    {
+        return impl->numThreads;
+    }
+
+    size_t CommandPoolRing::NumFrames() const noexcept
+    {
+        return impl->numFrames;
+    }
+
+}
@@ -0,0 +1,694 @@
+#include "vpr_stdafx.h"
+#include "CommandStream.hpp"
+#include "vkAssert.hpp"
+#include <vector>
+#include <array>
+#include <cstring>
+#include <algorithm>
+#include <limits>
+#include <type_traits>
+
+namespace vpr
+{
+
+    enum class stream_cmd_type : uint32_t
+    {
+        BindPipeline = 0,
+        BindDescriptorSets,
+        BindVertexBuffers,
+        BindIndexBuffer,
+        SetViewport,
+        SetScissor,
+        PushConstants,
+        Draw,
+        DrawIndexed,
+        Dispatch,
+        PipelineBarrier
+    };
+
+    // Every command starts with this header, and all segments after it are padded to 8 bytes so the stream can be stored as 64-bit words
+    struct stream_cmd_header_t
+    {
+        stream_cmd_type Type;
+        uint32_t SizeInWords;
+    };
+    static_assert(sizeof(stream_cmd_header_t) == sizeof(uint64_t), "Command header must be exactly one word in size.");
+
+    struct bind_pipeline_t
+    {
+        VkPipelineBindPoint BindPoint;
+        VkPipeline Pipeline;
+    };
+
+    struct bind_descriptor_sets_t
+    {
+        VkPipelineBindPoint BindPoint;
+        VkPipelineLayout Layout;
+        uint32_t FirstSet;
+        uint32_t SetCount;
+        uint32_t DynamicOffsetCount;
+    };
+
+    struct bind_vertex_buffers_t
+    {
+        uint32_t FirstBinding;
+        uint32_t BindingCount;
+    };
+
+    struct bind_index_buffer_t
+    {
+        VkBuffer Buffer;
+        VkDeviceSize Offset;
+        VkIndexType IndexType;
+    };
+
+    struct set_dynamic_array_t
+    {
+        uint32_t First;
+        uint32_t Count;
+    };
+
+    struct push_constants_t
+    {
+        VkPipelineLayout Layout;
+        VkShaderStageFlags Stages;
+        uint32_t Offset;
+        uint32_t Size;
+    };
+
+    struct draw_t
+    {
+        uint32_t VertexCount;
+        uint32_t InstanceCount;
+        uint32_t FirstVertex;
+        uint32_t FirstInstance;
+    };
+
+    struct draw_indexed_t
+    {
+        uint32_t IndexCount;
+        uint32_t InstanceCount;
+        uint32_t FirstIndex;
+        int32_t VertexOffset;
+        uint32_t FirstInstance;
+    };
+
+    struct dispatch_t
+    {
+        uint32_t X;
+        uint32_t Y;
+        uint32_t Z;
+    };
+
+    struct pipeline_barrier_t
+    {
+        VkPipelineStageFlags SrcStages;
+        VkPipelineStageFlags DstStages;
+        VkDependencyFlags DependencyFlags;
+        uint32_t MemoryBarrierCount;
+        uint32_t BufferBarrierCount;
+        uint32_t ImageBarrierCount;
+    };
+
+    constexpr static size_t padded_size(const size_t bytes) noexcept
+    {
+        return (bytes + sizeof(uint64_t) - 1u) & ~(sizeof(uint64_t) - 1u);
+    }
+
+    template<typename T>
+    constexpr static size_t segment_size(const size_t count = 1u) noexcept
+    {
+        return padded_size(sizeof(T) * count);
+    }
+
+    // Walks the segments of a single command, for both reading and writing
+    template<typename ByteType>
+    struct segment_cursor_t
+    {
+        ByteType* Ptr;
+
+        template<typename T>
+        auto Take(const size_t count = 1u)
+        {
+            using result_t = std::conditional_t<std::is_const<ByteType>::value, const T*, T*>;
+            result_t result = reinterpret_cast<result_t>(Ptr);
+            Ptr += segment_size<T>(count);
+            return result;
+        }
+
+        void Skip(const size_t bytes)
+        {
+            Ptr += padded_size(bytes);
+        }
+    };
+
+    struct CommandStreamImpl
+    {
+        segment_cursor_t<uint8_t> append(const stream_cmd_type type, const size_t payload_bytes);
+        void appendBarrier(const VkPipelineStageFlags src_stages, const VkPipelineStageFlags dst_stages, const VkDependencyFlags dependency_flags,
+            const uint32_t num_memory_barriers, const VkMemoryBarrier* memory_barriers, const uint32_t num_buffer_barriers, const VkBufferMemoryBarrier* buffer_barriers,
+            const uint32_t num_image_barriers, const VkImageMemoryBarrier* image_barriers);
+
+        std::vector<uint64_t> words;
+        size_t numCommands{ 0u };
+        CommandStreamStats stats;
+    };
+
+    segment_cursor_t<uint8_t> CommandStreamImpl::append(const stream_cmd_type type, const size_t payload_bytes)
+    {
+        const size_t payload_words = padded_size(payload_bytes) / sizeof(uint64_t);
+        const size_t offset = words.size();
+        words.resize(offset + 1u + payload_words, 0u);
+        stream_cmd_header_t header{ type, static_cast<uint32_t>(1u + payload_words) };
+        std::memcpy(&words[offset], &header, sizeof(header));
+        ++numCommands;
+        return segment_cursor_t<uint8_t>{ reinterpret_cast<uint8_t*>(&words[offset + 1u]) };
+    }
+
+    void CommandStreamImpl::appendBarrier(const VkPipelineStageFlags src_stages, const VkPipelineStageFlags dst_stages, const VkDependencyFlags dependency_flags,
+        const uint32_t num_memory_barriers, const VkMemoryBarrier* memory_barriers, const uint32_t num_buffer_barriers, const VkBufferMemoryBarrier* buffer_barriers,
+        const uint32_t num_image_barriers, const VkImageMemoryBarrier* image_barriers)
+    {
+        auto cursor = append(stream_cmd_type::PipelineBarrier, segment_size<pipeline_barrier_t>() + segment_size<VkMemoryBarrier>(num_memory_barriers) +
+            segment_size<VkBufferMemoryBarrier>(num_buffer_barriers) + segment_size<VkImageMemoryBarrier>(num_image_barriers));
+        *cursor.Take<pipeline_barrier_t>() = pipeline_barrier_t{ src_stages, dst_stages, dependency_flags, num_memory_barriers, num_buffer_barriers, num_image_barriers };
+        std::copy(memory_barriers, memory_barriers + num_memory_barriers, cursor.Take<VkMemoryBarrier>(num_memory_barriers));
+        std::copy(buffer_barriers, buffer_barriers + num_buffer_barriers, cursor.Take<VkBufferMemoryBarrier>(num_buffer_barriers));
+        std::copy(image_barriers, image_barriers + num_image_barriers, cursor.Take<VkImageMemoryBarrier>(num_image_barriers));
+    }
+
+    CommandStream::CommandStream() : impl(std::make_unique<CommandStreamImpl>()) {}
+
+    CommandStream::~CommandStream() {}
+
+    CommandStream::CommandStream(CommandStream&& other) noexcept : impl(std::move(other.impl)) {}
+
+    CommandStream& CommandStream::operator=(CommandStream&& other) noexcept
+    {
+        impl = std::move(other.impl);
+        return *this;
+    }
+
+    void CommandStream::BindPipeline(const VkPipelineBindPoint bind_point, const VkPipeline pipeline)
+    {
+        auto cursor = impl->append(stream_cmd_type::BindPipeline, segment_size<bind_pipeline_t>());
+        *cursor.Take<bind_pipeline_t>() = bind_pipeline_t{ bind_point, pipeline };
+    }
+
+    void CommandStream::BindDescriptorSets(const VkPipelineBindPoint bind_point, const VkPipelineLayout layout, const uint32_t first_set, const uint32_t set_count,
+        const VkDescriptorSet* sets, const uint32_t dynamic_offset_count, const uint32_t* dynamic_offsets)
+    {
+        auto cursor = impl->append(stream_cmd_type::BindDescriptorSets, segment_size<bind_descriptor_sets_t>() + segment_size<VkDescriptorSet>(set_count) +
+            segment_size<uint32_t>(dynamic_offset_count));
+        *cursor.Take<bind_descriptor_sets_t>() = bind_descriptor_sets_t{ bind_point, layout, first_set, set_count, dynamic_offset_count };
+        std::copy(sets, sets + set_count, cursor.Take<VkDescriptorSet>(set_count));
+        std::copy(dynamic_offsets, dynamic_offsets + dynamic_offset_count, cursor.Take<uint32_t>(dynamic_offset_count));
+    }
+
+    void CommandStream::BindVertexBuffers(const uint32_t first_binding, const uint32_t binding_count, const VkBuffer* buffers, const VkDeviceSize* offsets)
+    {
+        auto cursor = impl->append(stream_cmd_type::BindVertexBuffers, segment_size<bind_vertex_buffers_t>() + segment_size<VkBuffer>(binding_count) +
+            segment_size<VkDeviceSize>(binding_count));
+        *cursor.Take<bind_vertex_buffers_t>() = bind_vertex_buffers_t{ first_binding, binding_count };
+        std::copy(buffers, buffers + binding_count, cursor.Take<VkBuffer>(binding_count));
+        std::copy(offsets, offsets + binding_count, cursor.Take<VkDeviceSize>(binding_count));
+    }
+
+    void CommandStream::BindIndexBuffer(const VkBuffer buffer, const VkDeviceSize offset, const VkIndexType index_type)
+    {
+        auto cursor = impl->append(stream_cmd_type::BindIndexBuffer, segment_size<bind_index_buffer_t>());
+        *cursor.Take<bind_index_buffer_t>() = bind_index_buffer_t{ buffer, offset, index_type };
+    }
+
+    void CommandStream::SetViewport(const uint32_t first_viewport, const uint32_t viewport_count, const VkViewport* viewports)
+    {
+        auto cursor = impl->append(stream_cmd_type::SetViewport, segment_size<set_dynamic_array_t>() + segment_size<VkViewport>(viewport_count));
+        *cursor.Take<set_dynamic_array_t>() = set_dynamic_array_t{ first_viewport, viewport_count };
+        std::copy(viewports, viewports + viewport_count, cursor.Take<VkViewport>(viewport_count));
+    }
+
+    void CommandStream::SetScissor(const uint32_t first_scissor, const uint32_t scissor_count, const VkRect2D* scissors)
+    {
+        auto cursor = impl->append(stream_cmd_type::SetScissor, segment_size<set_dynamic_array_t>() + segment_size<VkRect2D>(scissor_count));
+        *cursor.Take<set_dynamic_array_t>() = set_dynamic_array_t{ first_scissor, scissor_count };
+        std::copy(scissors, scissors + scissor_count, cursor.Take<VkRect2D>(scissor_count));
+    }
+
+    void CommandStream::PushConstants(const VkPipelineLayout layout, const VkShaderStageFlags stages, const uint32_t offset, const uint32_t size, const void* values)
+    {
+        auto cursor = impl->append(stream_cmd_type::PushConstants, segment_size<push_constants_t>() + padded_size(size));
+        *cursor.Take<push_constants_t>() = push_constants_t{ layout, stages, offset, size };
+        std::memcpy(cursor.Ptr, values, size);
+    }
+
+    void CommandStream::Draw(const uint32_t vertex_count, const uint32_t instance_count, const uint32_t first_vertex, const uint32_t first_instance)
+    {
+        auto cursor = impl->append(stream_cmd_type::Draw, segment_size<draw_t>());
+        *cursor.Take<draw_t>() = draw_t{ vertex_count, instance_count, first_vertex, first_instance };
+    }
+
+    void CommandStream::DrawIndexed(const uint32_t index_count, const uint32_t instance_count, const uint32_t first_index, const int32_t vertex_offset, const uint32_t first_instance)
+    {
+        auto cursor = impl->append(stream_cmd_type::DrawIndexed, segment_size<draw_indexed_t>());
+        *cursor.Take<draw_indexed_t>() = draw_indexed_t{ index_count, instance_count, first_index, vertex_offset, first_instance };
+    }
+
+    void CommandStream::Dispatch(const uint32_t group_count_x, const uint32_t group_count_y, const uint32_t group_count_z)
+    {
+        auto cursor = impl->append(stream_cmd_type::Dispatch, segment_size<dispatch_t>());
+        *cursor.Take<dispatch_t>() = dispatch_t{ group_count_x, group_count_y, group_count_z };
+    }
+
+    void CommandStream::PipelineBarrier(const VkPipelineStageFlags src_stages, const VkPipelineStageFlags dst_stages, const VkDependencyFlags dependency_flags,
+        const uint32_t num_memory_barriers, const VkMemoryBarrier* memory_barriers, const uint32_t num_buffer_barriers, const VkBufferMemoryBarrier* buffer_barriers,
+        const uint32_t num_image_barriers, const VkImageMemoryBarrier* image_barriers)
+    {
+        impl->appendBarrier(src_stages, dst_stages, dependency_flags, num_memory_barriers, memory_barriers, num_buffer_barriers, buffer_barriers,
+            num_image_barriers, image_barriers);
+    }
+
+    namespace
+    {
+
+        struct bound_set_t
+        {
+            VkDescriptorSet Set{ VK_NULL_HANDLE };
+            // Dynamic offsets can't be attributed to individual sets without the layout, so we track the whole call that bound each set
+            uint32_t CallFirstSet{ 0u };
+            uint32_t CallSetCount{ 0u };
+            std::vector<uint32_t> CallOffsets;
+        };
+
+        struct bind_point_state_t
+        {
+            VkPipeline Pipeline{ VK_NULL_HANDLE };
+            VkPipelineLayout Layout{ VK_NULL_HANDLE };
+            std::vector<bound_set_t> Sets;
+        };
+
+        struct pending_barrier_t
+        {
+            bool Active{ false };
+            VkPipelineStageFlags SrcStages{ 0u };
+            VkPipelineStageFlags DstStages{ 0u };
+            VkDependencyFlags DependencyFlags{ 0u };
+            std::vector<VkMemoryBarrier> MemoryBarriers;
+            std::vector<VkBufferMemoryBarrier> BufferBarriers;
+            std::vector<VkImageMemoryBarrier> ImageBarriers;
+        };
+
+        struct stream_state_tracker_t
+        {
+            bool pipelineRedundant(const bind_pipeline_t& cmd);
+            bool descriptorSetsRedundant(const bind_descriptor_sets_t& cmd, const VkDescriptorSet* sets, const uint32_t* offsets);
+            bool vertexBuffersRedundant(const bind_vertex_buffers_t& cmd, const VkBuffer* buffers, const VkDeviceSize* offsets);
+            bool indexBufferRedundant(const bind_index_buffer_t& cmd);
+            template<typename T>
+            bool dynamicArrayRedundant(std::vector<T>& tracked, std::vector<bool>& valid, const set_dynamic_array_t& cmd, const T* values);
+
+            std::array<bind_point_state_t, 2> bindPoints;
+            std::vector<VkBuffer> vertexBuffers;
+            std::vector<VkDeviceSize> vertexOffsets;
+            bool indexBufferValid{ false };
+            bind_index_buffer_t indexBuffer{};
+            std::vector<VkViewport> viewports;
+            std::vector<bool> viewportsValid;
+            std::vector<VkRect2D> scissors;
+            std::vector<bool> scissorsValid;
+        };
+
+        bool stream_state_tracker_t::pipelineRedundant(const bind_pipeline_t& cmd)
+        {
+            if (static_cast<size_t>(cmd.BindPoint) >= bindPoints.size())
+            {
+                // Extension bind points aren't tracked
+                return false;
+            }
+            bind_point_state_t& state = bindPoints[static_cast<size_t>(cmd.BindPoint)];
+            if (state.Pipeline == cmd.Pipeline)
+            {
+                return true;
+            }
+            state.Pipeline = cmd.Pipeline;
+            if (cmd.BindPoint == VK_PIPELINE_BIND_POINT_GRAPHICS)
+            {
+                // New pipeline may have static viewport/scissor state, overwriting what we've set
+                viewportsValid.assign(viewportsValid.size(), false);
+                scissorsValid.assign(scissorsValid.size(), false);
+            }
+            return false;
+        }
+
+        bool stream_state_tracker_t::descriptorSetsRedundant(const bind_descriptor_sets_t& cmd, const VkDescriptorSet* sets, const uint32_t* offsets)
+        {
+            if (static_cast<size_t>(cmd.BindPoint) >= bindPoints.size())
+            {
+                return false;
+            }
+            bind_point_state_t& state = bindPoints[static_cast<size_t>(cmd.BindPoint)];
+            if (state.Layout != cmd.Layout)
+            {
+                state.Layout = cmd.Layout;
+                state.Sets.clear();
+            }
+
+            if (state.Sets.size() < cmd.FirstSet + cmd.SetCount)
+            {
+                state.Sets.resize(cmd.FirstSet + cmd.SetCount);
+            }
+
+            bool redundant = true;
+            for (uint32_t i = 0; i < cmd.SetCount && redundant; ++i)
+            {
+                const bound_set_t& bound = state.Sets[cmd.FirstSet + i];
+                redundant = (bound.Set == sets[i]) && (bound.CallFirstSet == cmd.FirstSet) && (bound.CallSetCount == cmd.SetCount) &&
+                    (bound.CallOffsets.size() == cmd.DynamicOffsetCount) && std::equal(offsets, offsets + cmd.DynamicOffsetCount, bound.CallOffsets.cbegin());
+            }
+
+            if (!redundant)
+            {
+                for (uint32_t i = 0; i < cmd.SetCount; ++i)
+                {
+                    bound_set_t& bound = state.Sets[cmd.FirstSet + i];
+                    bound.Set = sets[i];
+                    bound.CallFirstSet = cmd.FirstSet;
+                    bound.CallSetCount = cmd.SetCount;
+                    bound.CallOffsets.assign(offsets, offsets + cmd.DynamicOffsetCount);
+                }
+            }
+
+            return redundant;
+        }
+
+        bool stream_state_tracker_t::vertexBuffersRedundant(const bind_vertex_buffers_t& cmd, const VkBuffer* buffers, const VkDeviceSize* offsets)
+        {
+            const size_t required_size = cmd.FirstBinding + cmd.BindingCount;
+            if (vertexBuffers.size() < required_size)
+            {
+                vertexBuffers.resize(required_size, VK_NULL_HANDLE);
+                vertexOffsets.resize(required_size, std::numeric_limits<VkDeviceSize>::max());
+            }
+
+            bool redundant = true;
+            for (uint32_t i = 0; i < cmd.BindingCount; ++i)
+            {
+                const size_t binding = cmd.FirstBinding + i;
+                if (vertexBuffers[binding] != buffers[i] || vertexOffsets[binding] != offsets[i])
+                {
+                    redundant = false;
+                    vertexBuffers[binding] = buffers[i];
+                    vertexOffsets[binding] = offsets[i];
+                }
+            }
+
+            return redundant;
+        }
+
+        bool stream_state_tracker_t::indexBufferRedundant(const bind_index_buffer_t& cmd)
+        {
+            if (indexBufferValid && indexBuffer.Buffer == cmd.Buffer && indexBuffer.Offset == cmd.Offset && indexBuffer.IndexType == cmd.IndexType)
+            {
+                return true;
+            }
+            indexBufferValid = true;
+            indexBuffer = cmd;
+            return false;
+        }
+
+        template<typename T>
+        bool stream_state_tracker_t::dynamicArrayRedundant(std::vector<T>& tracked, std::vector<bool>& valid, const set_dynamic_array_t& cmd, const T* values)
+        {
+            const size_t required_size = cmd.First + cmd.Count;
+            if (tracked.size() < required_size)
+            {
+                tracked.resize(required_size);
+                valid.resize(required_size, false);
+            }
+
+            bool redundant = true;
+            for (uint32_t i = 0; i < cmd.Count; ++i)
+            {
+                const size_t idx = cmd.First + i;
+                if (!valid[idx] || std::memcmp(&tracked[idx], &values[i], sizeof(T)) != 0)
+                {
+                    redundant = false;
+                    tracked[idx] = values[i];
+                    valid[idx] = true;
+                }
+            }
+
+            return redundant;
+        }
+
+        template<typename BarrierType, typename HandleFn>
+        bool barriers_overlap(const std::vector<BarrierType>& pending, const BarrierType* incoming, const uint32_t count, HandleFn&& handle_fn)
+        {
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                for (const auto& barrier : pending)
+                {
+                    if (handle_fn(barrier) == handle_fn(incoming[i]))
+                    {
+                        return true;
+                    }
+                }
+            }
+            return false;
+        }
+
+    }
+
+    void CommandStream::Optimize()
+    {
+        CommandStreamImpl optimized;
+        optimized.words.reserve(impl->words.size());
+        optimized.stats.CommandsRecorded = impl->numCommands;
+
+        stream_state_tracker_t tracker;
+        pending_barrier_t pending;
+
+        auto flush_pending_barrier = [&]()
+        {
+            if (pending.Active)
+            {
+                optimized.appendBarrier(pending.SrcStages, pending.DstStages, pending.DependencyFlags,
+                    static_cast<uint32_t>(pending.MemoryBarriers.size()), pending.MemoryBarriers.data(),
+                    static_cast<uint32_t>(pending.BufferBarriers.size()), pending.BufferBarriers.data(),
+                    static_cast<uint32_t>(pending.ImageBarriers.size()), pending.ImageBarriers.data());
+                pending = pending_barrier_t{};
+            }
+        };
+
+        size_t word_idx = 0u;
+        while (word_idx < impl->words.size())
+        {
+            stream_cmd_header_t header;
+            std::memcpy(&header, &impl->words[word_idx], sizeof(header));
+            segment_cursor_t<const uint8_t> cursor{ reinterpret_cast<const uint8_t*>(&impl->words[word_idx + 1u]) };
+            bool redundant = false;
+
+            switch (header.Type)
+            {
+            case stream_cmd_type::BindPipeline:
+                redundant = tracker.pipelineRedundant(*cursor.Take<bind_pipeline_t>());
+                break;
+            case stream_cmd_type::BindDescriptorSets:
+            {
+                const bind_descriptor_sets_t* cmd = cursor.Take<bind_descriptor_sets_t>();
+                const VkDescriptorSet* sets = cursor.Take<VkDescriptorSet>(cmd->SetCount);
+                const uint32_t* offsets = cursor.Take<uint32_t>(cmd->DynamicOffsetCount);
+                redundant = tracker.descriptorSetsRedundant(*cmd, sets, offsets);
+                break;
+            }
+            case stream_cmd_type::BindVertexBuffers:
+            {
+                const bind_vertex_buffers_t* cmd = cursor.Take<bind_vertex_buffers_t>();
+                const VkBuffer* buffers = cursor.Take<VkBuffer>(cmd->BindingCount);
+                const VkDeviceSize* offsets = cursor.Take<VkDeviceSize>(cmd->BindingCount);
+                redundant = tracker.vertexBuffersRedundant(*cmd, buffers, offsets);
+                break;
+            }
+            case stream_cmd_type::BindIndexBuffer:
+                redundant = tracker.indexBufferRedundant(*cursor.Take<bind_index_buffer_t>());
+                break;
+            case stream_cmd_type::SetViewport:
+            {
+                const set_dynamic_array_t* cmd = cursor.Take<set_dynamic_array_t>();
+                redundant = tracker.dynamicArrayRedundant(tracker.viewports, tracker.viewportsValid, *cmd, cursor.Take<VkViewport>(cmd->Count));
+                break;
+            }
+            case stream_cmd_type::SetScissor:
+            {
+                const set_dynamic_array_t* cmd = cursor.Take<set_dynamic_array_t>();
+                redundant = tracker.dynamicArrayRedundant(tracker.scissors, tracker.scissorsValid, *cmd, cursor.Take<VkRect2D>(cmd->Count));
+                break;
+            }
+            case stream_cmd_type::PipelineBarrier:
+            {
+                const pipeline_barrier_t* cmd = cursor.Take<pipeline_barrier_t>();
+                const VkMemoryBarrier* memory_barriers = cursor.Take<VkMemoryBarrier>(cmd->MemoryBarrierCount);
+                const VkBufferMemoryBarrier* buffer_barriers = cursor.Take<VkBufferMemoryBarrier>(cmd->BufferBarrierCount);
+                const VkImageMemoryBarrier* image_barriers = cursor.Take<VkImageMemoryBarrier>(cmd->ImageBarrierCount);
+
+                const bool can_merge = pending.Active && (pending.DependencyFlags == cmd->DependencyFlags) &&
+                    !barriers_overlap(pending.BufferBarriers, buffer_barriers, cmd->BufferBarrierCount, [](const VkBufferMemoryBarrier& b) { return b.buffer; }) &&
+                    !barriers_overlap(pending.ImageBarriers, image_barriers, cmd->ImageBarrierCount, [](const VkImageMemoryBarrier& b) { return b.image; });
+
+                if (can_merge)
+                {
+                    ++optimized.stats.BarriersMerged;
+                }
+                else
+                {
+                    flush_pending_barrier();
+                    pending.Active = true;
+                    pending.DependencyFlags = cmd->DependencyFlags;
+                }
+
+                pending.SrcStages |= cmd->SrcStages;
+                pending.DstStages |= cmd->DstStages;
+                pending.MemoryBarriers.insert(pending.MemoryBarriers.end(), memory_barriers, memory_barriers + cmd->MemoryBarrierCount);
+                pending.BufferBarriers.insert(pending.BufferBarriers.end(), buffer_barriers, buffer_barriers + cmd->BufferBarrierCount);
+                pending.ImageBarriers.insert(pending.ImageBarriers.end(), image_barriers, image_barriers + cmd->ImageBarrierCount);
+                word_idx += header.SizeInWords;
+                continue;
+            }
+            default:
+                break;
+            }
+
+            if (redundant)
+            {
+                ++optimized.stats.RedundantStateRemoved;
+            }
+            else
+            {
+                flush_pending_barrier();
+                optimized.words.insert(optimized.words.end(), impl->words.cbegin() + word_idx, impl->words.cbegin() + word_idx + header.SizeInWords);
+                ++optimized.numCommands;
+            }
+
+            word_idx += header.SizeInWords;
+        }
+
+        flush_pending_barrier();
+        optimized.stats.CommandsAfterOptimization = optimized.numCommands;
+        *impl = std::move(optimized);
+    }
+
+    void CommandStream::Replay(VkCommandBuffer cmd) const
+    {
+        size_t word_idx = 0u;
+        while (word_idx < impl->words.size())
+        {
+            stream_cmd_header_t header;
+            std::memcpy(&header, &impl->words[word_idx], sizeof(header));
+            segment_cursor_t<const uint8_t> cursor{ reinterpret_cast<const uint8_t*>(&impl->words[word_idx + 1u]) };
+
+            switch (header.Type)
+            {
+            case stream_cmd_type::BindPipeline:
+            {
+                const bind_pipeline_t* data = cursor.Take<bind_pipeline_t>();
+                vkCmdBindPipeline(cmd, data->BindPoint, data->Pipeline);
+                break;
+            }
+            case stream_cmd_type::BindDescriptorSets:
+            {
+                const bind_descriptor_sets_t* data = cursor.Take<bind_descriptor_sets_t>();
+                const VkDescriptorSet* sets = cursor.Take<VkDescriptorSet>(data->SetCount);
+                const uint32_t* offsets = cursor.Take<uint32_t>(data->DynamicOffsetCount);
+                vkCmdBindDescriptorSets(cmd, data->BindPoint, data->Layout, data->FirstSet, data->SetCount, sets, data->DynamicOffsetCount,
+                    data->DynamicOffsetCount != 0u ? offsets : nullptr);
+                break;
+            }
+            case stream_cmd_type::BindVertexBuffers:
+            {
+                const bind_vertex_buffers_t* data = cursor.Take<bind_vertex_buffers_t>();
+                const VkBuffer* buffers = cursor.Take<VkBuffer>(data->BindingCount);
+                const VkDeviceSize* offsets = cursor.Take<VkDeviceSize>(data->BindingCount);
+                vkCmdBindVertexBuffers(cmd, data->FirstBinding, data->BindingCount, buffers, offsets);
+                break;
+            }
+            case stream_cmd_type::BindIndexBuffer:
+            {
+                const bind_index_buffer_t* data = cursor.Take<bind_index_buffer_t>();
+                vkCmdBindIndexBuffer(cmd, data->Buffer, data->Offset, data->IndexType);
+                break;
+            }
+            case stream_cmd_type::SetViewport:
+            {
+                const set_dynamic_array_t* data = cursor.Take<set_dynamic_array_t>();
+                vkCmdSetViewport(cmd, data->First, data->Count, cursor.Take<VkViewport>(data->Count));
+                break;
+            }
+            case stream_cmd_type::SetScissor:
+            {
+                const set_dynamic_array_t* data = cursor.Take<set_dynamic_array_t>();
+                vkCmdSetScissor(cmd, data->First, data->Count, cursor.Take<VkRect2D>(data->Count));
+                break;
+            }
+            case stream_cmd_type::PushConstants:
+            {
+                const push_constants_t* data = cursor.Take<push_constants_t>();
+                vkCmdPushConstants(cmd, data->Layout, data->Stages, data->Offset, data->Size, cursor.Ptr);
+                break;
+            }
+            case stream_cmd_type::Draw:
+            {
+                const draw_t* data = cursor.Take<draw_t>();
+                vkCmdDraw(cmd, data->VertexCount, data->InstanceCount, data->FirstVertex, data->FirstInstance);
+                break;
+            }
+            case stream_cmd_type::DrawIndexed:
+            {
+                const draw_indexed_t* data = cursor.Take<draw_indexed_t>();
+                vkCmdDrawIndexed(cmd, data->IndexCount, data->InstanceCount, data->FirstIndex, data->VertexOffset, data->FirstInstance);
+                break;
+            }
+            case stream_cmd_type::Dispatch:
+            {
+                const dispatch_t* data = cursor.Take<dispatch_t>();
+                vkCmdDispatch(cmd, data->X, data->Y, data->Z);
+                break;
+            }
+            case stream_cmd_type::PipelineBarrier:
+            {
+                const pipeline_barrier_t* data = cursor.Take<pipeline_barrier_t>();
+                const VkMemoryBarrier* memory_barriers = cursor.Take<VkMemoryBarrier>(data->MemoryBarrierCount);
+                const VkBufferMemoryBarrier* buffer_barriers = cursor.Take<VkBufferMemoryBarrier>(data->BufferBarrierCount);
+                const VkImageMemoryBarrier* image_barriers = cursor.Take<VkImageMemoryBarrier>(data->ImageBarrierCount);
+                vkCmdPipelineBarrier(cmd, data->SrcStages, data->DstStages, data->DependencyFlags, data->MemoryBarrierCount, memory_barriers,
+                    data->BufferBarrierCount, buffer_barriers, data->ImageBarrierCount, image_barriers);
+                break;
+            }
+            }
+
+            word_idx += header.SizeInWords;
+        }
+    }
+
+    void CommandStream::Clear() noexcept
+    {
+        impl->words.clear();
+        impl->numCommands = 0u;
+        // Stats describe the stream's current contents: keeping them would skew the ratios of the next stream recorded
+        impl->stats = CommandStreamStats{};
+    }
+
+    size_t CommandStream::NumCommands() const noexcept
+    {
+        return impl->numCommands;
+    }
+
+    size_t CommandStream::SizeInBytes() const noexcept
+    {
+        return impl->words.size() * sizeof(uint64_t);
+    }
+
+    const CommandStreamStats& CommandStream::Stats() const noexcept
+    {
+        return impl->stats;
+    }
+
+}
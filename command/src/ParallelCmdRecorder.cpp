@@ -0,0 +1,237 @@
+#include "vpr_stdafx.h"
+#include "ParallelCmdRecorder.hpp"
+#include "CommandPoolRing.hpp"
+#include "vkAssert.hpp"
+#include "CreateInfoBase.hpp"
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+
+namespace vpr
+{
+
+    struct alignas(64) work_queue_t
+    {
+        std::mutex mutex;
+        std::deque<size_t> chunks;
+    };
+
+    struct ParallelCmdRecorderImpl
+    {
+        ParallelCmdRecorderImpl(CommandPoolRing* ring);
+        ~ParallelCmdRecorderImpl();
+        void workerLoop(const size_t worker_idx);
+        bool popChunk(const size_t worker_idx, size_t& chunk_idx);
+        void recordChunk(const size_t worker_idx, const size_t chunk_idx);
+        void drainQueues(const size_t worker_idx);
+
+        CommandPoolRing* ring{ nullptr };
+        std::vector<std::thread> threads;
+        std::vector<work_queue_t> queues;
+
+        std::mutex stateMutex;
+        std::condition_variable wakeCondition;
+        std::condition_variable doneCondition;
+        uint64_t generation{ 0u };
+        bool shutdown{ false };
+        std::atomic<size_t> remainingChunks{ 0u };
+        std::atomic<size_t> stealCount{ 0u };
+
+        // State for the Record() call in progress: only written while no chunks are queued
+        const ParallelCmdRecorder::RecordFunction* recordFn{ nullptr };
+        VkCommandBufferInheritanceInfo inheritance{ vk_command_buffer_inheritance_info_base };
+        size_t numJobs{ 0u };
+        size_t jobsPerChunk{ 0u };
+        std::vector<VkCommandBuffer> results;
+    };
+
+    ParallelCmdRecorderImpl::ParallelCmdRecorderImpl(CommandPoolRing* _ring) : ring(_ring), queues(_ring->NumThreads())
+    {
+        // Last worker index is reserved for the thread calling Record()
+        const size_t num_threads = ring->NumThreads() - 1u;
+        threads.reserve(num_threads);
+        for (size_t i = 0; i < num_threads; ++i)
+        {
+            threads.emplace_back(&ParallelCmdRecorderImpl::workerLoop, this, i);
+        }
+    }
+
+    ParallelCmdRecorderImpl::~ParallelCmdRecorderImpl()
+    {
+        {
+            std::lock_guard<std::mutex> guard(stateMutex);
+            shutdown = true;
+        }
+        wakeCondition.notify_all();
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+    }
+
+    void ParallelCmdRecorderImpl::workerLoop(const size_t worker_idx)
+    {
+        uint64_t seen_generation = 0u;
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(stateMutex);
+                wakeCondition.wait(lock, [&]() { return shutdown || generation != seen_generation; });
+                if (shutdown)
+                {
+                    return;
+                }
+                seen_generation = generation;
+            }
+            drainQueues(worker_idx);
+        }
+    }
+
+    bool ParallelCmdRecorderImpl::popChunk(const size_t worker_idx, size_t& chunk_idx)
+    {
+        {
+            // Owner takes from the back of its own queue...
+            work_queue_t& own_queue = queues[worker_idx];
+            std::lock_guard<std::mutex> guard(own_queue.mutex);
+            if (!own_queue.chunks.empty())
+            {
+                chunk_idx = own_queue.chunks.back();
+                own_queue.chunks.pop_back();
+                return true;
+            }
+        }
+
+        // ...while thieves take from the front of everyone else's, starting with our neighbour so thieves spread out
+        for (size_t offset = 1u; offset < queues.size(); ++offset)
+        {
+            work_queue_t& victim = queues[(worker_idx + offset) % queues.size()];
+            std::lock_guard<std::mutex> guard(victim.mutex);
+            if (!victim.chunks.empty())
+            {
+                chunk_idx = victim.chunks.front();
+                victim.chunks.pop_front();
+                stealCount.fetch_add(1u, std::memory_order_relaxed);
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void ParallelCmdRecorderImpl::recordChunk(const size_t worker_idx, const size_t chunk_idx)
+    {
+        VkCommandBuffer cmd = ring->AllocateCmdBuffer(worker_idx, VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+
+        VkCommandBufferBeginInfo begin_info = vk_command_buffer_begin_info_base;
+        begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+        begin_info.pInheritanceInfo = &inheritance;
+        VkResult result = vkBeginCommandBuffer(cmd, &begin_info);
+        VkAssert(result);
+
+        const size_t first_job = chunk_idx * jobsPerChunk;
+        const size_t last_job = std::min(first_job + jobsPerChunk, numJobs);
+        for (size_t job = first_job; job < last_job; ++job)
+        {
+            (*recordFn)(cmd, job);
+        }
+
+        result = vkEndCommandBuffer(cmd);
+        VkAssert(result);
+        results[chunk_idx] = cmd;
+
+        if (remainingChunks.fetch_sub(1u, std::memory_order_acq_rel) == 1u)
+        {
+            std::lock_guard<std::mutex> guard(stateMutex);
+            doneCondition.notify_all();
+        }
+    }
+
+    void ParallelCmdRecorderImpl::drainQueues(const size_t worker_idx)
+    {
+        size_t chunk_idx = 0u;
+        while (popChunk(worker_idx, chunk_idx))
+        {
+            recordChunk(worker_idx, chunk_idx);
+        }
+    }
+
+    VkCommandBufferInheritanceInfo MakeSecondaryInheritanceInfo(const VkRenderPass renderpass, const uint32_t subpass, const VkFramebuffer framebuffer) noexcept
+    {
+        VkCommandBufferInheritanceInfo result = vk_command_buffer_inheritance_info_base;
+        result.renderPass = renderpass;
+        result.subpass = subpass;
+        result.framebuffer = framebuffer;
+        return result;
+    }
+
+    ParallelCmdRecorder::ParallelCmdRecorder(CommandPoolRing* ring) : impl(std::make_unique<ParallelCmdRecorderImpl>(ring)) {}
+
+    ParallelCmdRecorder::~ParallelCmdRecorder() {}
+
+    void ParallelCmdRecorder::Record(VkCommandBuffer primary, const VkCommandBufferInheritanceInfo& inheritance, const size_t num_jobs,
+        const RecordFunction& record_fn, const size_t jobs_per_buffer)
+    {
+        if (num_jobs == 0u)
+        {
+            return;
+        }
+
+        const size_t jobs_per_chunk = std::max(jobs_per_buffer, size_t(1u));
+        const size_t num_chunks = (num_jobs + jobs_per_chunk - 1u) / jobs_per_chunk;
+        const size_t num_workers = impl->queues.size();
+
+        impl->recordFn = &record_fn;
+        impl->inheritance = inheritance;
+        impl->numJobs = num_jobs;
+        impl->jobsPerChunk = jobs_per_chunk;
+        impl->results.assign(num_chunks, VK_NULL_HANDLE);
+        impl->stealCount.store(0u, std::memory_order_relaxed);
+        impl->remainingChunks.store(num_chunks, std::memory_order_release);
+
+        // Deal out contiguous ranges of chunks, so that neighbouring (and probably similar) work tends to stay on one thread
+        const size_t chunks_per_worker = (num_chunks + num_workers - 1u) / num_workers;
+        for (size_t i = 0; i < num_workers; ++i)
+        {
+            work_queue_t& queue = impl->queues[i];
+            std::lock_guard<std::mutex> guard(queue.mutex);
+            const size_t first = std::min(i * chunks_per_worker, num_chunks);
+            const size_t last = std::min(first + chunks_per_worker, num_chunks);
+            // Owners pop from the back, so store in reverse to have them record in ascending order
+            for (size_t chunk = last; chunk > first; --chunk)
+            {
+                queue.chunks.push_back(chunk - 1u);
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> guard(impl->stateMutex);
+            ++impl->generation;
+        }
+        impl->wakeCondition.notify_all();
+
+        impl->drainQueues(num_workers - 1u);
+
+        {
+            std::unique_lock<std::mutex> lock(impl->stateMutex);
+            impl->doneCondition.wait(lock, [&]() { return impl->remainingChunks.load(std::memory_order_acquire) == 0u; });
+        }
+
+        vkCmdExecuteCommands(primary, static_cast<uint32_t>(impl->results.size()), impl->results.data());
+        impl->recordFn = nullptr;
+    }
+
+    size_t ParallelCmdRecorder::NumWorkers() const noexcept
+    {
+        return impl->queues.size();
+    }
+
+    size_t ParallelCmdRecorder::LastStealCount() const noexcept
+    {
+        return impl->stealCount.load(std::memory_order_relaxed);
+    }
+
+}
@@ -0,0 +1,239 @@
+#include "vpr_stdafx.h"
+#include "Queue.hpp"
+#include "vkAssert.hpp"
+#include "CreateInfoBase.hpp"
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+
+namespace vpr
+{
+
+    struct queue_submission_t
+    {
+        queue_submission_t* next{ nullptr };
+        const void* pNext{ nullptr };
+        std::vector<VkSemaphore> waitSemaphores;
+        std::vector<VkPipelineStageFlags> waitStages;
+        std::vector<VkCommandBuffer> cmdBuffers;
+        std::vector<VkSemaphore> signalSemaphores;
+        VkFence fence{ VK_NULL_HANDLE };
+        bool hasTimelineInfo{ false };
+        VkTimelineSemaphoreSubmitInfo timelineInfo{ vk_timeline_semaphore_submit_info_base };
+        std::vector<uint64_t> waitValues;
+        std::vector<uint64_t> signalValues;
+    };
+
+    struct QueueImpl
+    {
+        QueueImpl(const VkQueue queue);
+        ~QueueImpl();
+        void push(queue_submission_t* submission);
+        void threadLoop();
+        void submitList(queue_submission_t* list);
+        void submitBatch(const VkFence fence);
+
+        VkQueue handle{ VK_NULL_HANDLE };
+        // Intake is a lock-free stack: producers push onto the head, and the submit thread takes the whole list in one exchange
+        std::atomic<queue_submission_t*> intakeHead{ nullptr };
+        std::atomic<uint64_t> numEnqueued{ 0u };
+        std::atomic<bool> threadSleeping{ false };
+
+        mutable std::mutex stateMutex;
+        std::condition_variable wakeCondition;
+        std::condition_variable flushedCondition;
+        uint64_t numHandedOff{ 0u };
+        bool shutdown{ false };
+        QueueStats stats;
+
+        // Held by whoever is currently using the VkQueue itself
+        std::mutex queueMutex;
+        std::vector<VkSubmitInfo> batch;
+        std::thread thread;
+    };
+
+    QueueImpl::QueueImpl(const VkQueue queue) : handle(queue)
+    {
+        thread = std::thread(&QueueImpl::threadLoop, this);
+    }
+
+    QueueImpl::~QueueImpl()
+    {
+        {
+            std::lock_guard<std::mutex> guard(stateMutex);
+            shutdown = true;
+        }
+        wakeCondition.notify_all();
+        thread.join();
+    }
+
+    void QueueImpl::push(queue_submission_t* submission)
+    {
+        // Counted before publishing, so a Flush() target never includes a submission the handed-off count could skip past
+        numEnqueued.fetch_add(1u, std::memory_order_seq_cst);
+        submission->next = intakeHead.load(std::memory_order_relaxed);
+        while (!intakeHead.compare_exchange_weak(submission->next, submission, std::memory_order_seq_cst, std::memory_order_relaxed));
+
+        // Only pay for the mutex when the submit thread might be asleep: it marks itself as sleeping before checking the intake, so
+        // either it sees our submission or we see the flag
+        if (threadSleeping.load(std::memory_order_seq_cst))
+        {
+            std::lock_guard<std::mutex> guard(stateMutex);
+            wakeCondition.notify_one();
+        }
+    }
+
+    void QueueImpl::threadLoop()
+    {
+        while (true)
+        {
+            queue_submission_t* list = intakeHead.exchange(nullptr, std::memory_order_acq_rel);
+            if (list != nullptr)
+            {
+                submitList(list);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(stateMutex);
+            threadSleeping.store(true, std::memory_order_seq_cst);
+            wakeCondition.wait(lock, [this]() { return shutdown || intakeHead.load(std::memory_order_seq_cst) != nullptr; });
+            threadSleeping.store(false, std::memory_order_relaxed);
+            if (shutdown && intakeHead.load(std::memory_order_acquire) == nullptr)
+            {
+                return;
+            }
+        }
+    }
+
+    void QueueImpl::submitList(queue_submission_t* list)
+    {
+        // Stack is newest-first: reverse it so submissions reach the driver in the order they were made
+        queue_submission_t* ordered = nullptr;
+        uint64_t count = 0u;
+        while (list != nullptr)
+        {
+            queue_submission_t* next = list->next;
+            list->next = ordered;
+            ordered = list;
+            list = next;
+            ++count;
+        }
+
+        uint64_t num_queue_submits = 0u;
+        {
+            std::lock_guard<std::mutex> guard(queueMutex);
+            for (queue_submission_t* submission = ordered; submission != nullptr; submission = submission->next)
+            {
+                VkSubmitInfo submit_info = vk_submit_info_base;
+                if (submission->hasTimelineInfo)
+                {
+                    submission->timelineInfo.pWaitSemaphoreValues = submission->waitValues.data();
+                    submission->timelineInfo.pSignalSemaphoreValues = submission->signalValues.data();
+                    submit_info.pNext = &submission->timelineInfo;
+                }
+                else
+                {
+                    submit_info.pNext = submission->pNext;
+                }
+                submit_info.waitSemaphoreCount = static_cast<uint32_t>(submission->waitSemaphores.size());
+                submit_info.pWaitSemaphores = submission->waitSemaphores.data();
+                submit_info.pWaitDstStageMask = submission->waitStages.data();
+                submit_info.commandBufferCount = static_cast<uint32_t>(submission->cmdBuffers.size());
+                submit_info.pCommandBuffers = submission->cmdBuffers.data();
+                submit_info.signalSemaphoreCount = static_cast<uint32_t>(submission->signalSemaphores.size());
+                submit_info.pSignalSemaphores = submission->signalSemaphores.data();
+                batch.emplace_back(submit_info);
+
+                if (submission->fence != VK_NULL_HANDLE)
+                {
+                    submitBatch(submission->fence);
+                    ++num_queue_submits;
+                }
+            }
+
+            if (!batch.empty())
+            {
+                submitBatch(VK_NULL_HANDLE);
+                ++num_queue_submits;
+            }
+        }
+
+        while (ordered != nullptr)
+        {
+            queue_submission_t* next = ordered->next;
+            delete ordered;
+            ordered = next;
+        }
+
+        {
+            std::lock_guard<std::mutex> guard(stateMutex);
+            numHandedOff += count;
+            stats.NumSubmissions += count;
+            stats.NumQueueSubmits += num_queue_submits;
+            stats.MaxSubmissionsPerCall = std::max(stats.MaxSubmissionsPerCall, count);
+        }
+        flushedCondition.notify_all();
+    }
+
+    void QueueImpl::submitBatch(const VkFence fence)
+    {
+        VkResult result = vkQueueSubmit(handle, static_cast<uint32_t>(batch.size()), batch.data(), fence);
+        VkAssert(result);
+        batch.clear();
+    }
+
+    Queue::Queue(const VkQueue queue) : impl(std::make_unique<QueueImpl>(queue)) {}
+
+    Queue::~Queue() {}
+
+    void Queue::Submit(const VkSubmitInfo& submit_info, const VkFence fence)
+    {
+        queue_submission_t* submission = new queue_submission_t;
+        submission->pNext = submit_info.pNext;
+        if (submit_info.pNext != nullptr && reinterpret_cast<const VkTimelineSemaphoreSubmitInfo*>(submit_info.pNext)->sType == VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO)
+        {
+            // Timeline values are the most common pNext by far, so copy them too: only the rest of the chain must outlive this call then
+            const VkTimelineSemaphoreSubmitInfo* timeline_info = reinterpret_cast<const VkTimelineSemaphoreSubmitInfo*>(submit_info.pNext);
+            submission->hasTimelineInfo = true;
+            submission->timelineInfo = *timeline_info;
+            submission->waitValues.assign(timeline_info->pWaitSemaphoreValues, timeline_info->pWaitSemaphoreValues + timeline_info->waitSemaphoreValueCount);
+            submission->signalValues.assign(timeline_info->pSignalSemaphoreValues, timeline_info->pSignalSemaphoreValues + timeline_info->signalSemaphoreValueCount);
+        }
+        submission->waitSemaphores.assign(submit_info.pWaitSemaphores, submit_info.pWaitSemaphores + submit_info.waitSemaphoreCount);
+        submission->waitStages.assign(submit_info.pWaitDstStageMask, submit_info.pWaitDstStageMask + submit_info.waitSemaphoreCount);
+        submission->cmdBuffers.assign(submit_info.pCommandBuffers, submit_info.pCommandBuffers + submit_info.commandBufferCount);
+        submission->signalSemaphores.assign(submit_info.pSignalSemaphores, submit_info.pSignalSemaphores + submit_info.signalSemaphoreCount);
+        submission->fence = fence;
+        impl->push(submission);
+    }
+
+    void Queue::Flush()
+    {
+        const uint64_t target = impl->numEnqueued.load(std::memory_order_acquire);
+        std::unique_lock<std::mutex> lock(impl->stateMutex);
+        impl->flushedCondition.wait(lock, [&]() { return impl->numHandedOff >= target; });
+    }
+
+    void Queue::WaitIdle()
+    {
+        Flush();
+        std::lock_guard<std::mutex> guard(impl->queueMutex);
+        VkResult result = vkQueueWaitIdle(impl->handle);
+        VkAssert(result);
+    }
+
+    const VkQueue& Queue::vkHandle() const noexcept
+    {
+        return impl->handle;
+    }
+
+    QueueStats Queue::Stats() const
+    {
+        std::lock_guard<std::mutex> guard(impl->stateMutex);
+        return impl->stats;
+    }
+
+}
@@ -0,0 +1,242 @@
+#include "vpr_stdafx.h"
+#include "TransferBatcher.hpp"
+#include "vkAssert.hpp"
+#include "CreateInfoBase.hpp"
+#include "easylogging++.h"
+#include <mutex>
+#include <algorithm>
+
+namespace vpr
+{
+
+    enum class flush_reason : uint32_t
+    {
+        Size = 0,
+        Latency = 1,
+        Explicit = 2
+    };
+
+    struct TransferBatcherImpl
+    {
+        TransferBatcherImpl(const VkDevice device, const VkQueue queue, const uint32_t queue_family_idx, const VkDeviceSize size_threshold,
+            const std::chrono::microseconds latency);
+        // All of these expect the mutex to be held by the caller
+        VkCommandBuffer currentCmdBuffer();
+        void endOperation(const VkDeviceSize bytes);
+        void flush(const flush_reason reason);
+
+        std::mutex mutex;
+        VkDevice device{ VK_NULL_HANDLE };
+        CommandPool pool;
+        VkQueue queue{ VK_NULL_HANDLE };
+        VkDeviceSize sizeThreshold{ 0u };
+        std::chrono::microseconds maxLatency;
+        VkCommandBuffer cmd{ VK_NULL_HANDLE };
+        std::chrono::steady_clock::time_point batchStart;
+        uint64_t batchOperations{ 0u };
+        VkDeviceSize batchBytes{ 0u };
+        SingleCmdSubmission lastSubmission;
+        TransferBatchStats stats;
+    };
+
+    static VkCommandPoolCreateInfo make_batcher_pool_info(const uint32_t queue_family_idx)
+    {
+        VkCommandPoolCreateInfo pool_info = vk_command_pool_info_base;
+        pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        pool_info.queueFamilyIndex = queue_family_idx;
+        return pool_info;
+    }
+
+    TransferBatcherImpl::TransferBatcherImpl(const VkDevice _device, const VkQueue _queue, const uint32_t queue_family_idx, const VkDeviceSize size_threshold,
+        const std::chrono::microseconds latency) : device(_device), pool(_device, make_batcher_pool_info(queue_family_idx)), queue(_queue), sizeThreshold(size_threshold), maxLatency(latency) {}
+
+    VkCommandBuffer TransferBatcherImpl::currentCmdBuffer()
+    {
+        if (cmd == VK_NULL_HANDLE)
+        {
+            cmd = pool.StartSingleCmdBuffer();
+            batchStart = std::chrono::steady_clock::now();
+        }
+        return cmd;
+    }
+
+    void TransferBatcherImpl::endOperation(const VkDeviceSize bytes)
+    {
+        ++batchOperations;
+        batchBytes += bytes;
+
+        if (batchBytes >= sizeThreshold)
+        {
+            flush(flush_reason::Size);
+        }
+        else if (std::chrono::steady_clock::now() - batchStart >= maxLatency)
+        {
+            flush(flush_reason::Latency);
+        }
+    }
+
+    void TransferBatcherImpl::flush(const flush_reason reason)
+    {
+        if (cmd == VK_NULL_HANDLE)
+        {
+            return;
+        }
+
+        lastSubmission = pool.EndSingleCmdBufferAsync(cmd, queue);
+        cmd = VK_NULL_HANDLE;
+
+        ++stats.NumFlushes;
+        stats.NumOperations += batchOperations;
+        stats.BytesTransferred += batchBytes;
+        stats.MaxOperationsPerBatch = std::max(stats.MaxOperationsPerBatch, batchOperations);
+        stats.MaxBytesPerBatch = std::max(stats.MaxBytesPerBatch, batchBytes);
+        switch (reason)
+        {
+        case flush_reason::Size:
+            ++stats.SizeTriggeredFlushes;
+            break;
+        case flush_reason::Latency:
+            ++stats.LatencyTriggeredFlushes;
+            break;
+        case flush_reason::Explicit:
+            ++stats.ExplicitFlushes;
+            break;
+        }
+
+        LOG_IF(VERBOSE_LOGGING, INFO) << "TransferBatcher submitted " << std::to_string(batchOperations) << " operations totalling " << std::to_string(batchBytes) << " bytes.";
+        batchOperations = 0u;
+        batchBytes = 0u;
+    }
+
+    TransferBatcher::TransferBatcher(const VkDevice device, const VkQueue transfer_queue, const uint32_t transfer_queue_family_idx,
+        const VkDeviceSize flush_size_threshold, const std::chrono::microseconds max_latency) :
+        impl(std::make_unique<TransferBatcherImpl>(device, transfer_queue, transfer_queue_family_idx, flush_size_threshold, max_latency)) {}
+
+    TransferBatcher::~TransferBatcher()
+    {
+        if (impl)
+        {
+            // Pending work would otherwise leak: submit it, and the pool will wait on it upon destruction
+            std::lock_guard<std::mutex> guard(impl->mutex);
+            impl->flush(flush_reason::Explicit);
+        }
+    }
+
+    TransferBatcher::TransferBatcher(TransferBatcher&& other) noexcept : impl(std::move(other.impl)) {}
+
+    TransferBatcher& TransferBatcher::operator=(TransferBatcher&& other) noexcept
+    {
+        if (impl && impl != other.impl)
+        {
+            // As in the destructor: copies recorded but not yet submitted would otherwise be silently dropped
+            std::lock_guard<std::mutex> guard(impl->mutex);
+            impl->flush(flush_reason::Explicit);
+        }
+        impl = std::move(other.impl);
+        return *this;
+    }
+
+    void TransferBatcher::CopyBuffer(const VkBuffer src, const VkBuffer dst, const uint32_t num_regions, const VkBufferCopy* regions)
+    {
+        VkDeviceSize bytes = 0u;
+        for (uint32_t i = 0; i < num_regions; ++i)
+        {
+            bytes += regions[i].size;
+        }
+
+        std::lock_guard<std::mutex> guard(impl->mutex);
+        vkCmdCopyBuffer(impl->currentCmdBuffer(), src, dst, num_regions, regions);
+        impl->endOperation(bytes);
+    }
+
+    void TransferBatcher::CopyBufferToImage(const VkBuffer src, const VkImage dst, const VkImageLayout dst_layout, const uint32_t num_regions, const VkBufferImageCopy* regions,
+        const VkDeviceSize bytes_transferred)
+    {
+        std::lock_guard<std::mutex> guard(impl->mutex);
+        vkCmdCopyBufferToImage(impl->currentCmdBuffer(), src, dst, dst_layout, num_regions, regions);
+        impl->endOperation(bytes_transferred);
+    }
+
+    void TransferBatcher::PipelineBarrier(const VkPipelineStageFlags src_stages, const VkPipelineStageFlags dst_stages, const VkDependencyFlags dependency_flags,
+        const uint32_t num_memory_barriers, const VkMemoryBarrier* memory_barriers, const uint32_t num_buffer_barriers, const VkBufferMemoryBarrier* buffer_barriers,
+        const uint32_t num_image_barriers, const VkImageMemoryBarrier* image_barriers)
+    {
+        std::lock_guard<std::mutex> guard(impl->mutex);
+        vkCmdPipelineBarrier(impl->currentCmdBuffer(), src_stages, dst_stages, dependency_flags, num_memory_barriers, memory_barriers,
+            num_buffer_barriers, buffer_barriers, num_image_barriers, image_barriers);
+        impl->endOperation(0u);
+    }
+
+    void TransferBatcher::Record(const std::function<void(VkCommandBuffer)>& record_fn, const VkDeviceSize bytes_transferred)
+    {
+        std::lock_guard<std::mutex> guard(impl->mutex);
+        record_fn(impl->currentCmdBuffer());
+        impl->endOperation(bytes_transferred);
+    }
+
+    void TransferBatcher::Update()
+    {
+        std::lock_guard<std::mutex> guard(impl->mutex);
+        if (impl->cmd != VK_NULL_HANDLE && (std::chrono::steady_clock::now() - impl->batchStart >= impl->maxLatency))
+        {
+            impl->flush(flush_reason::Latency);
+        }
+    }
+
+    SingleCmdSubmission TransferBatcher::Flush()
+    {
+        std::lock_guard<std::mutex> guard(impl->mutex);
+        impl->flush(flush_reason::Explicit);
+        return impl->lastSubmission;
+    }
+
+    SingleCmdSubmission TransferBatcher::EndFrame()
+    {
+        return Flush();
+    }
+
+    VkResult TransferBatcher::Wait(const SingleCmdSubmission& submission, const uint64_t timeout)
+    {
+        VkFence fence{ VK_NULL_HANDLE };
+        {
+            std::lock_guard<std::mutex> guard(impl->mutex);
+            fence = impl->pool.HoldSingleCmdBufferFence(submission);
+        }
+
+        if (fence == VK_NULL_HANDLE)
+        {
+            return VK_SUCCESS;
+        }
+
+        // Don't block in the driver with the lock held, as that would stall every other thread trying to record transfers
+        VkResult result = vkWaitForFences(impl->device, 1, &fence, VK_TRUE, timeout);
+        if (result != VK_TIMEOUT)
+        {
+            VkAssert(result);
+        }
+
+        std::lock_guard<std::mutex> guard(impl->mutex);
+        impl->pool.ReleaseSingleCmdBufferFence();
+        // Recycles the submission: it may also have completed (and been recycled by another thread) during a wait that timed out
+        return impl->pool.PollSingleCmdBuffer(submission) ? VK_SUCCESS : VK_TIMEOUT;
+    }
+
+    bool TransferBatcher::Poll(const SingleCmdSubmission& submission)
+    {
+        std::lock_guard<std::mutex> guard(impl->mutex);
+        return impl->pool.PollSingleCmdBuffer(submission);
+    }
+
+    TransferBatchStats TransferBatcher::Stats() const
+    {
+        std::lock_guard<std::mutex> guard(impl->mutex);
+        return impl->stats;
+    }
+
+    void TransferBatcher::ResetStats()
+    {
+        std::lock_guard<std::mutex> guard(impl->mutex);
+        impl->stats = TransferBatchStats{};
+    }
+
+}
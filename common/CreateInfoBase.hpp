@@ -226,6 +226,17 @@ namespace vpr {
 		{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 },
 	};
 
+	// Format needs to be set, along with buffer: range covers the whole buffer by default
+	constexpr static VkBufferViewCreateInfo vk_buffer_view_create_info_base{
+		VK_STRUCTURE_TYPE_BUFFER_VIEW_CREATE_INFO,
+		nullptr,
+		0,
+		VK_NULL_HANDLE,
+		VK_FORMAT_UNDEFINED,
+		0,
+		VK_WHOLE_SIZE
+	};
+
 	constexpr static VkRenderPassCreateInfo vk_render_pass_create_info_base{
 		VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
 		nullptr,
@@ -528,6 +539,19 @@ namespace vpr {
 		nullptr,
 	};
 
+	constexpr static VkDescriptorUpdateTemplateCreateInfo vk_descriptor_update_template_create_info_base {
+		VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO,
+		nullptr,
+		0,
+		0,
+		nullptr,
+		VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET,
+		VK_NULL_HANDLE,
+		VK_PIPELINE_BIND_POINT_GRAPHICS,
+		VK_NULL_HANDLE,
+		0,
+	};
+
 
 	constexpr static VkComputePipelineCreateInfo vk_compute_pipeline_create_info_base{
 		VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
@@ -571,6 +595,38 @@ namespace vpr {
         0
     };
 
+    constexpr static VkSemaphoreTypeCreateInfo vk_semaphore_type_create_info_base {
+        VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+        nullptr,
+        VK_SEMAPHORE_TYPE_TIMELINE,
+        0
+    };
+
+    constexpr static VkSemaphoreWaitInfo vk_semaphore_wait_info_base {
+        VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+        nullptr,
+        0,
+        0,
+        nullptr,
+        nullptr
+    };
+
+    constexpr static VkSemaphoreSignalInfo vk_semaphore_signal_info_base {
+        VK_STRUCTURE_TYPE_SEMAPHORE_SIGNAL_INFO,
+        nullptr,
+        VK_NULL_HANDLE,
+        0
+    };
+
+    constexpr static VkTimelineSemaphoreSubmitInfo vk_timeline_semaphore_submit_info_base {
+        VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+        nullptr,
+        0,
+        nullptr,
+        0,
+        nullptr
+    };
+
     constexpr static VkEventCreateInfo vk_event_create_info_base {
         VK_STRUCTURE_TYPE_EVENT_CREATE_INFO,
         nullptr,
@@ -621,6 +677,19 @@ namespace vpr {
         VkSparseImageMemoryRequirements{}
     };
 
+    constexpr static VkPhysicalDeviceMemoryProperties2KHR vk_physical_device_memory_properties_2_khr_base {
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2_KHR,
+        nullptr,
+        VkPhysicalDeviceMemoryProperties{}
+    };
+
+    constexpr static VkPhysicalDeviceMemoryBudgetPropertiesEXT vk_physical_device_memory_budget_properties_ext_base {
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT,
+        nullptr,
+        {},
+        {}
+    };
+
 	constexpr static VkOffset2D vk_offset_2d_base {
 		std::numeric_limits<int32_t>::max(),
 		std::numeric_limits<int32_t>::max()
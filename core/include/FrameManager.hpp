@@ -0,0 +1,89 @@
+#pragma once
+#ifndef VULPES_VK_FRAME_MANAGER_HPP
+#define VULPES_VK_FRAME_MANAGER_HPP
+#include "vpr_stdafx.h"
+#include "ForwardDecl.hpp"
+#include <memory>
+#include <chrono>
+#include <limits>
+
+namespace vpr
+{
+
+    struct FrameManagerImpl;
+
+    /**The FrameManager implements the acquire -> record -> submit -> present loop around a Swapchain, with a configurable quantity of
+     * frames in flight. Each in-flight frame owns an image-acquired semaphore and a fence, while each swapchain image owns a render-complete
+     * semaphore (as presentation of an image may still be waiting on it when the frame that signaled it comes around again).
+     *
+     * Usage per frame is:
+     * 1. BeginFrame(): waits for the fence of the frame slot being re-used, then acquires the next image. If another frame still owns that image
+     *    (possible when the in-flight depth differs from the image count), it waits on that frame's fence too. If this returns
+     *    VK_ERROR_OUT_OF_DATE_KHR, recreate the swapchain, call SwapchainRecreated(), and try again. If it returns VK_TIMEOUT, call it
+     *    again: an image acquired before the timeout is kept, and the wait resumes.
+     * 2. Record command buffers for CurrentImageIdx(), using per-frame resources indexed by CurrentFrameIdx().
+     * 3. Submit(), or a custom vkQueueSubmit waiting on ImageAcquiredSemaphore(), signaling RenderCompleteSemaphore() and SubmitFence().
+     *    The frame's fence is only reset here, so a frame abandoned after BeginFrame() (e.g. to recreate the swapchain) leaves it signaled.
+     * 4. Present(), which also advances to the next frame slot.
+     *
+     * Time the host spends blocked on fences in BeginFrame() is recorded, as a high CPU wait time is the sign of a GPU-bound application (or
+     * of too few frames in flight).
+     * \ingroup Core
+     */
+    class VPR_API FrameManager
+    {
+        FrameManager(const FrameManager&) = delete;
+        FrameManager& operator=(const FrameManager&) = delete;
+    public:
+
+        /**\param frames_in_flight Quantity of frames that can be recorded by the host while the GPU is still processing previous ones. Two is
+         * the usual choice: more increases latency, fewer serializes the CPU and GPU.
+         */
+        FrameManager(const Device* device, const Swapchain* swapchain, const uint32_t frames_in_flight = 2u);
+        /**Waits for all frames in flight to complete, before destroying the sync objects.*/
+        ~FrameManager();
+
+        /**Waits for the current frame slot to become available and acquires the next swapchain image. Returns the result of vkAcquireNextImageKHR:
+         * VK_SUCCESS or VK_SUBOPTIMAL_KHR mean the frame can proceed, anything else means it can't (and the frame fence is left untouched).
+         * Also returns VK_TIMEOUT if a fence wait exceeds the timeout (in nanoseconds, applied to each wait).
+         */
+        VkResult BeginFrame(const uint64_t timeout = std::numeric_limits<uint64_t>::max());
+        /**Submits the given command buffers, waiting on the image-acquired semaphore at the given stage and signaling the render complete semaphore and frame fence.*/
+        void Submit(const VkQueue queue, const uint32_t num_cmd_buffers, const VkCommandBuffer* cmd_buffers,
+            const VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+        /**Presents the current image once rendering has completed, then moves on to the next frame slot. Returns the result of vkQueuePresentKHR.*/
+        VkResult Present(const VkQueue queue);
+        /**Call after recreating the swapchain given at construction: waits for all frames in flight, then recreates the per-image sync objects to match the new image count.*/
+        void SwapchainRecreated();
+        /**Blocks until every frame in flight has completed.*/
+        void WaitAll() const;
+
+        uint32_t FramesInFlight() const noexcept;
+        /**Index of the current frame slot, in [0, FramesInFlight()): use to index per-frame resources like command pools or uniform buffers.*/
+        uint32_t CurrentFrameIdx() const noexcept;
+        /**Index of the swapchain image acquired by the last successful call to BeginFrame().*/
+        uint32_t CurrentImageIdx() const noexcept;
+        /**Total quantity of frames presented so far.*/
+        uint64_t FrameCount() const noexcept;
+
+        VkSemaphore ImageAcquiredSemaphore() const noexcept;
+        VkSemaphore RenderCompleteSemaphore() const noexcept;
+        /**Fence of the current frame slot, for waiting on. Use SubmitFence() to signal it.*/
+        VkFence FrameFence() const noexcept;
+        /**Resets the fence of the current frame slot (once per frame) and returns it, to be signaled by a custom submission of the frame.*/
+        VkFence SubmitFence();
+
+        /**Time spent waiting on fences during the last call to BeginFrame().*/
+        std::chrono::microseconds LastCpuWaitTime() const noexcept;
+        /**Time spent waiting on fences during the last BeginFrame() call made for the given frame slot.*/
+        std::chrono::microseconds CpuWaitTime(const uint32_t frame_idx) const;
+        /**Total time spent waiting on fences in BeginFrame() so far.*/
+        std::chrono::microseconds TotalCpuWaitTime() const noexcept;
+
+    private:
+        std::unique_ptr<FrameManagerImpl> impl;
+    };
+
+}
+
+#endif //!VULPES_VK_FRAME_MANAGER_HPP
@@ -57,6 +57,10 @@ namespace vpr
         bool HasDedicatedComputeQueues() const;
         /**Returns true when the VK_KHR_dedicated_allocation extension and it's cohort has been loaded. Used by memory allocation systems to improve fit and potential performance of certain memory allocations.*/
         bool DedicatedAllocationExtensionsEnabled() const noexcept;
+        /**True if the timelineSemaphore feature was enabled, which happens automatically on Vulkan 1.2 or with VK_KHR_timeline_semaphore
+         * enabled, when the physical device supports it. Required to create timeline Semaphores.
+         */
+        bool TimelineSemaphoresEnabled() const noexcept;
         bool HasExtension(const char* name) const noexcept;
         /**Important note - uses strdup, so the data must be free'd by the user once they are done reading the extensions array!*/
         void GetEnabledExtensions(size_t* num_extensions, char** extensions) const;
@@ -0,0 +1,291 @@
+#include "vpr_stdafx.h"
+#include "FrameManager.hpp"
+#include "LogicalDevice.hpp"
+#include "Swapchain.hpp"
+#include "vkAssert.hpp"
+#include "CreateInfoBase.hpp"
+#include "easylogging++.h"
+#include <vector>
+#include <cassert>
+
+namespace vpr
+{
+
+    struct frame_sync_t
+    {
+        VkSemaphore imageAcquired{ VK_NULL_HANDLE };
+        VkFence fence{ VK_NULL_HANDLE };
+        std::chrono::microseconds cpuWaitTime{ 0 };
+        // Only reset right before the frame's submission: a frame that acquires but never submits must leave its fence signaled
+        bool fenceReset{ false };
+    };
+
+    struct FrameManagerImpl
+    {
+        FrameManagerImpl(const Device* dvc, const Swapchain* swap, const uint32_t frames_in_flight);
+        ~FrameManagerImpl();
+        void createFrameObjects();
+        void createImageObjects();
+        void destroyFrameObjects();
+        void destroyImageObjects();
+        void waitAll() const;
+        VkResult waitFence(const VkFence fence, const uint64_t timeout, std::chrono::microseconds& wait_time) const;
+
+        const Device* device{ nullptr };
+        const Swapchain* swapchain{ nullptr };
+        std::vector<frame_sync_t> frames;
+        std::vector<VkSemaphore> renderComplete;
+        // Fence of the frame that last rendered to each image, or VK_NULL_HANDLE if no frame has yet
+        std::vector<VkFence> imageOwners;
+        uint32_t currentFrame{ 0u };
+        uint32_t currentImage{ 0u };
+        // Set when BeginFrame() acquired an image, but timed out waiting for its previous owner: the next call resumes from that wait
+        bool acquirePending{ false };
+        VkResult acquireResult{ VK_SUCCESS };
+        uint64_t frameCount{ 0u };
+        std::chrono::microseconds lastWaitTime{ 0 };
+        std::chrono::microseconds totalWaitTime{ 0 };
+    };
+
+    FrameManagerImpl::FrameManagerImpl(const Device* dvc, const Swapchain* swap, const uint32_t frames_in_flight) : device(dvc), swapchain(swap),
+        frames(frames_in_flight)
+    {
+        assert(frames_in_flight > 0u);
+        createFrameObjects();
+        createImageObjects();
+    }
+
+    FrameManagerImpl::~FrameManagerImpl()
+    {
+        waitAll();
+        destroyImageObjects();
+        destroyFrameObjects();
+    }
+
+    void FrameManagerImpl::createFrameObjects()
+    {
+        VkFenceCreateInfo fence_info = vk_fence_create_info_base;
+        // Created signaled, so the first BeginFrame() for each slot doesn't block forever
+        fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+        for (auto& frame : frames)
+        {
+            VkResult result = vkCreateSemaphore(device->vkHandle(), &vk_semaphore_create_info_base, nullptr, &frame.imageAcquired);
+            VkAssert(result);
+            result = vkCreateFence(device->vkHandle(), &fence_info, nullptr, &frame.fence);
+            VkAssert(result);
+        }
+    }
+
+    void FrameManagerImpl::createImageObjects()
+    {
+        const uint32_t image_count = swapchain->ImageCount();
+        renderComplete.resize(image_count, VK_NULL_HANDLE);
+        imageOwners.assign(image_count, VK_NULL_HANDLE);
+        for (auto& semaphore : renderComplete)
+        {
+            VkResult result = vkCreateSemaphore(device->vkHandle(), &vk_semaphore_create_info_base, nullptr, &semaphore);
+            VkAssert(result);
+        }
+    }
+
+    void FrameManagerImpl::destroyFrameObjects()
+    {
+        for (auto& frame : frames)
+        {
+            vkDestroySemaphore(device->vkHandle(), frame.imageAcquired, nullptr);
+            vkDestroyFence(device->vkHandle(), frame.fence, nullptr);
+            frame.imageAcquired = VK_NULL_HANDLE;
+            frame.fence = VK_NULL_HANDLE;
+        }
+    }
+
+    void FrameManagerImpl::destroyImageObjects()
+    {
+        for (auto& semaphore : renderComplete)
+        {
+            vkDestroySemaphore(device->vkHandle(), semaphore, nullptr);
+        }
+        renderComplete.clear();
+        imageOwners.clear();
+    }
+
+    void FrameManagerImpl::waitAll() const
+    {
+        std::vector<VkFence> fences;
+        fences.reserve(frames.size());
+        for (const auto& frame : frames)
+        {
+            fences.emplace_back(frame.fence);
+        }
+        VkResult result = vkWaitForFences(device->vkHandle(), static_cast<uint32_t>(fences.size()), fences.data(), VK_TRUE, std::numeric_limits<uint64_t>::max());
+        VkAssert(result);
+    }
+
+    VkResult FrameManagerImpl::waitFence(const VkFence fence, const uint64_t timeout, std::chrono::microseconds& wait_time) const
+    {
+        const auto start = std::chrono::high_resolution_clock::now();
+        VkResult result = vkWaitForFences(device->vkHandle(), 1, &fence, VK_TRUE, timeout);
+        wait_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+        return result;
+    }
+
+    FrameManager::FrameManager(const Device* device, const Swapchain* swapchain, const uint32_t frames_in_flight) :
+        impl(std::make_unique<FrameManagerImpl>(device, swapchain, frames_in_flight)) {}
+
+    FrameManager::~FrameManager() {}
+
+    VkResult FrameManager::BeginFrame(const uint64_t timeout)
+    {
+        frame_sync_t& frame = impl->frames[impl->currentFrame];
+        std::chrono::microseconds wait_time{ 0 };
+
+        if (!impl->acquirePending)
+        {
+            VkResult result = impl->waitFence(frame.fence, timeout, wait_time);
+            if (result != VK_SUCCESS)
+            {
+                return result;
+            }
+
+            result = vkAcquireNextImageKHR(impl->device->vkHandle(), impl->swapchain->vkHandle(), timeout, frame.imageAcquired, VK_NULL_HANDLE, &impl->currentImage);
+            if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
+            {
+                return result;
+            }
+            impl->acquireResult = result;
+            frame.fenceReset = false;
+        }
+
+        VkFence& image_owner = impl->imageOwners[impl->currentImage];
+        if (image_owner != VK_NULL_HANDLE && image_owner != frame.fence)
+        {
+            VkResult result = impl->waitFence(image_owner, timeout, wait_time);
+            if (result != VK_SUCCESS)
+            {
+                // The image is already acquired (and its semaphore pending): the next call picks up from this wait
+                impl->acquirePending = true;
+                impl->lastWaitTime = wait_time;
+                impl->totalWaitTime += wait_time;
+                return result;
+            }
+        }
+        image_owner = frame.fence;
+        impl->acquirePending = false;
+
+        frame.cpuWaitTime = wait_time;
+        impl->lastWaitTime = wait_time;
+        impl->totalWaitTime += wait_time;
+        return impl->acquireResult;
+    }
+
+    void FrameManager::Submit(const VkQueue queue, const uint32_t num_cmd_buffers, const VkCommandBuffer* cmd_buffers, const VkPipelineStageFlags wait_stage)
+    {
+        frame_sync_t& frame = impl->frames[impl->currentFrame];
+        VkSubmitInfo submit_info = vk_submit_info_base;
+        submit_info.waitSemaphoreCount = 1;
+        submit_info.pWaitSemaphores = &frame.imageAcquired;
+        submit_info.pWaitDstStageMask = &wait_stage;
+        submit_info.commandBufferCount = num_cmd_buffers;
+        submit_info.pCommandBuffers = cmd_buffers;
+        submit_info.signalSemaphoreCount = 1;
+        submit_info.pSignalSemaphores = &impl->renderComplete[impl->currentImage];
+        VkResult result = vkQueueSubmit(queue, 1, &submit_info, SubmitFence());
+        VkAssert(result);
+    }
+
+    VkResult FrameManager::Present(const VkQueue queue)
+    {
+        VkPresentInfoKHR present_info = vk_present_info_base;
+        present_info.waitSemaphoreCount = 1;
+        present_info.pWaitSemaphores = &impl->renderComplete[impl->currentImage];
+        present_info.swapchainCount = 1;
+        present_info.pSwapchains = &impl->swapchain->vkHandle();
+        present_info.pImageIndices = &impl->currentImage;
+        VkResult result = vkQueuePresentKHR(queue, &present_info);
+
+        impl->currentFrame = (impl->currentFrame + 1u) % static_cast<uint32_t>(impl->frames.size());
+        ++impl->frameCount;
+        return result;
+    }
+
+    void FrameManager::SwapchainRecreated()
+    {
+        impl->waitAll();
+        impl->destroyImageObjects();
+        // An acquire may have signaled a semaphore that was never waited on: start from fresh ones
+        impl->destroyFrameObjects();
+        impl->createFrameObjects();
+        impl->acquirePending = false;
+        impl->createImageObjects();
+        LOG_IF(VERBOSE_LOGGING, INFO) << "FrameManager sync objects recreated for " << impl->renderComplete.size() << " swapchain images.";
+    }
+
+    void FrameManager::WaitAll() const
+    {
+        impl->waitAll();
+    }
+
+    uint32_t FrameManager::FramesInFlight() const noexcept
+    {
+        return static_cast<uint32_t>(impl->frames.size());
+    }
+
+    uint32_t FrameManager::CurrentFrameIdx() const noexcept
+    {
+        return impl->currentFrame;
+    }
+
+    uint32_t FrameManager::CurrentImageIdx() const noexcept
+    {
+        return impl->currentImage;
+    }
+
+    uint64_t FrameManager::FrameCount() const noexcept
+    {
+        return impl->frameCount;
+    }
+
+    VkSemaphore FrameManager::ImageAcquiredSemaphore() const noexcept
+    {
+        return impl->frames[impl->currentFrame].imageAcquired;
+    }
+
+    VkSemaphore FrameManager::RenderCompleteSemaphore() const noexcept
+    {
+        return impl->renderComplete[impl->currentImage];
+    }
+
+    VkFence FrameManager::FrameFence() const noexcept
+    {
+        return impl->frames[impl->currentFrame].fence;
+    }
+
+    VkFence FrameManager::SubmitFence()
+    {
+        frame_sync_t& frame = impl->frames[impl->currentFrame];
+        if (!frame.fenceReset)
+        {
+            VkResult result = vkResetFences(impl->device->vkHandle(), 1, &frame.fence);
+            VkAssert(result);
+            frame.fenceReset = true;
+        }
+        return frame.fence;
+    }
+
+    std::chrono::microseconds FrameManager::LastCpuWaitTime() const noexcept
+    {
+        return impl->lastWaitTime;
+    }
+
+    std::chrono::microseconds FrameManager::CpuWaitTime(const uint32_t frame_idx) const
+    {
+        assert(frame_idx < impl->frames.size());
+        return impl->frames[frame_idx].cpuWaitTime;
+    }
+
+    std::chrono::microseconds FrameManager::TotalCpuWaitTime() const noexcept
+    {
+        return impl->totalWaitTime;
+    }
+
+}
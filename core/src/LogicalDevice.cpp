@@ -22,6 +22,10 @@ namespace vpr
         const Device* device = nullptr;
         std::map<VkQueueFlags, VkDeviceQueueCreateInfo> queueInfos;
         bool enableDedicatedAllocations{ false };
+        // Chained into the device create info, when the timelineSemaphore feature is supported and not already in the user's chain
+        VkPhysicalDeviceTimelineSemaphoreFeatures timelineSemaphoreFeatures{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES, nullptr, VK_FALSE };
+        bool timelineSemaphoresEnabled{ false };
+        void enableTimelineSemaphores(const Instance* instance, const VkPhysicalDevice physical_device, VkDeviceCreateInfo& create_info);
         void prepareRequiredExtensions(const VprExtensionPack* extensions, std::vector<const char*>& output);
         void prepareOptionalExtensions(const VprExtensionPack* extensions, std::vector<const char*>& output) noexcept;
         void checkExtensions(std::vector<const char*>& requested_extensions, bool throw_on_error) const;
@@ -110,6 +114,11 @@ namespace vpr
         return dataMembers->enableDedicatedAllocations;
     }
 
+    bool Device::TimelineSemaphoresEnabled() const noexcept
+    {
+        return dataMembers->timelineSemaphoresEnabled;
+    }
+
     bool Device::HasExtension(const char* name) const noexcept
     {
         auto iter = std::find_if(std::cbegin(dataMembers->enabledExtensions), std::cend(dataMembers->enabledExtensions),
@@ -374,6 +383,8 @@ namespace vpr
             createInfo.pNext = extensions->pNextChainStart;
         }
 
+        dataMembers->enableTimelineSemaphores(parentInstance, parent->vkHandle(), createInfo);
+
         VkResult result = vkCreateDevice(parent->vkHandle(), &createInfo, nullptr, &handle);
         VkAssert(result);
 
@@ -415,7 +426,7 @@ namespace vpr
             std::vector<const char*> all_extensions;
             dataMembers->prepareRequiredExtensions(extensions, all_extensions);
             dataMembers->prepareOptionalExtensions(extensions, all_extensions);
-            if (parentInstance->ApplicationInfo().apiVersion < VK_VERSION_1_1)
+            if (parentInstance->ApplicationInfo().apiVersion < VK_API_VERSION_1_1)
             {
                 dataMembers->checkDedicatedAllocExtensions(all_extensions);
             }
@@ -620,6 +631,60 @@ namespace vpr
         extensions.erase(iter, extensions.end());
     }
     
+    void DeviceDataMembers::enableTimelineSemaphores(const Instance* instance, const VkPhysicalDevice physical_device, VkDeviceCreateInfo& create_info)
+    {
+        const uint32_t api_version = instance->ApplicationInfo().apiVersion;
+        const bool core_timelines = api_version >= VK_API_VERSION_1_2;
+        if (!core_timelines && !device->HasExtension(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME))
+        {
+            return;
+        }
+
+        // The user may have enabled (or deliberately disabled) it themselves: adding our own struct as well would be invalid
+        for (const VkBaseInStructure* next = reinterpret_cast<const VkBaseInStructure*>(create_info.pNext); next != nullptr; next = next->pNext)
+        {
+            if (next->sType == VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES)
+            {
+                timelineSemaphoresEnabled = reinterpret_cast<const VkPhysicalDeviceTimelineSemaphoreFeatures*>(next)->timelineSemaphore == VK_TRUE;
+                return;
+            }
+            else if (next->sType == VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES)
+            {
+                timelineSemaphoresEnabled = reinterpret_cast<const VkPhysicalDeviceVulkan12Features*>(next)->timelineSemaphore == VK_TRUE;
+                return;
+            }
+        }
+
+        PFN_vkGetPhysicalDeviceFeatures2 get_features2 = nullptr;
+        if (api_version >= VK_API_VERSION_1_1)
+        {
+            get_features2 = vkGetPhysicalDeviceFeatures2;
+        }
+        else if (instance->HasExtension(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME))
+        {
+            get_features2 = reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2>(vkGetInstanceProcAddr(instance->vkHandle(), "vkGetPhysicalDeviceFeatures2KHR"));
+        }
+
+        if (get_features2 == nullptr)
+        {
+            LOG(WARNING) << "VK_KHR_timeline_semaphore is enabled, but support for its feature can't be queried without VK_KHR_get_physical_device_properties2.";
+            return;
+        }
+
+        VkPhysicalDeviceTimelineSemaphoreFeatures supported{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES, nullptr, VK_FALSE };
+        VkPhysicalDeviceFeatures2 features2{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, &supported, {} };
+        get_features2(physical_device, &features2);
+        if (supported.timelineSemaphore != VK_TRUE)
+        {
+            return;
+        }
+
+        timelineSemaphoreFeatures.timelineSemaphore = VK_TRUE;
+        timelineSemaphoreFeatures.pNext = const_cast<void*>(create_info.pNext);
+        create_info.pNext = &timelineSemaphoreFeatures;
+        timelineSemaphoresEnabled = true;
+    }
+
     void DeviceDataMembers::checkDedicatedAllocExtensions(const std::vector<const char*>& exts)
     {
 
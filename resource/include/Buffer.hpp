@@ -0,0 +1,65 @@
+#pragma once
+#ifndef VPR_BUFFER_HPP
+#define VPR_BUFFER_HPP
+#include "vpr_stdafx.h"
+#include "ForwardDecl.hpp"
+#include "AllocationRequirements.hpp"
+#include <memory>
+
+namespace vpr
+{
+
+    struct BufferImpl;
+
+    /**RAII wrapper around a VkBuffer and the Allocation backing it, suballocated from an Allocator.
+     *
+     * Buffers in host-visible memory can be persistently mapped (set AllocationRequirements::PersistentlyMapped), in which case Write()
+     * and MappedData() never call vkMapMemory. Writes to non-coherent memory are tracked as dirty ranges, merged, and made visible to the
+     * device with a single vkFlushMappedMemoryRanges call in FlushDirtyRanges(): for coherent memory, tracking is skipped entirely.
+     *
+     * Texel buffer views are created the first time they're requested, and cached per format and range.
+     * \ingroup Resources
+     */
+    class VPR_API Buffer
+    {
+        Buffer(const Buffer&) = delete;
+        Buffer& operator=(const Buffer&) = delete;
+    public:
+
+        /**Creates the buffer and binds memory to it: throws if either fails.*/
+        Buffer(Allocator* allocator, const VkBufferCreateInfo& create_info, const AllocationRequirements& alloc_reqs);
+        ~Buffer();
+        Buffer(Buffer&& other) noexcept;
+        Buffer& operator=(Buffer&& other) noexcept;
+
+        /**Copies data into the buffer, which must be in host-visible memory. Maps the buffer for the duration of the call if it isn't persistently mapped.*/
+        void Write(const void* data, const VkDeviceSize size, const VkDeviceSize offset = 0u);
+        /**Records that the given range was written through MappedData() or Map(), so it will be flushed by FlushDirtyRanges().*/
+        void MarkDirty(const VkDeviceSize offset, const VkDeviceSize size);
+        /**Flushes all ranges written since the last flush. Does nothing for coherent memory.*/
+        void FlushDirtyRanges();
+        /**Makes device writes to the given range visible to the host. Does nothing for coherent memory.*/
+        void Invalidate(const VkDeviceSize offset = 0u, const VkDeviceSize size = VK_WHOLE_SIZE);
+
+        /**Returns a pointer to the start of the buffer's memory. Must be paired with Unmap(): prefer persistent mapping for frequently written buffers.*/
+        void* Map();
+        void Unmap();
+        /**Pointer to the start of the buffer if it was persistently mapped, otherwise nullptr.*/
+        void* MappedData() const noexcept;
+
+        /**Returns a texel buffer view of the given format and range, creating it if this is the first request for it.*/
+        VkBufferView View(const VkFormat format, const VkDeviceSize offset = 0u, const VkDeviceSize range = VK_WHOLE_SIZE) const;
+
+        const VkBuffer& vkHandle() const noexcept;
+        VkDeviceSize Size() const noexcept;
+        VkBufferUsageFlags Usage() const noexcept;
+        const Allocation& MemoryAllocation() const noexcept;
+        bool HostCoherent() const noexcept;
+
+    private:
+        std::unique_ptr<BufferImpl> impl;
+    };
+
+}
+
+#endif //!VPR_BUFFER_HPP
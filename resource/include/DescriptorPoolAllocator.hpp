@@ -0,0 +1,71 @@
+#pragma once
+#ifndef VPR_DESCRIPTOR_POOL_ALLOCATOR_HPP
+#define VPR_DESCRIPTOR_POOL_ALLOCATOR_HPP
+#include "vpr_stdafx.h"
+#include "ForwardDecl.hpp"
+#include <memory>
+
+namespace vpr
+{
+
+    struct DescriptorPoolAllocatorImpl;
+
+    /**\ingroup Resources*/
+    struct VPR_API DescriptorPoolAllocatorStats
+    {
+        uint32_t NumPools{ 0u };
+        /**Sets currently allocated, across all pools.*/
+        uint32_t SetsAllocated{ 0u };
+        /**Allocations that found the current pool exhausted, and moved on to another pool.*/
+        uint64_t PoolExhaustions{ 0u };
+    };
+
+    /**Allocates descriptor sets from a growing list of descriptor pools, so pool sizes needn't be decided up front as with DescriptorPool.
+     * When a pool runs out of sets or descriptors (tracked by the allocator itself, or reported by the driver as VK_ERROR_OUT_OF_POOL_MEMORY
+     * or VK_ERROR_FRAGMENTED_POOL), allocation moves on to the next pool with room, creating a new pool if there is none.
+     *
+     * New pools are sized from the average count of each descriptor type per set allocated so far, so pools end up holding the mix of descriptors
+     * actually in use rather than a guessed-at worst case. Until anything has been allocated, the first pool is sized from the first set requested
+     * (or from the hints given to AddResourceType()). Allocation is thread-safe.
+     * \ingroup Resources
+     */
+    class VPR_API DescriptorPoolAllocator
+    {
+        DescriptorPoolAllocator(const DescriptorPoolAllocator&) = delete;
+        DescriptorPoolAllocator& operator=(const DescriptorPoolAllocator&) = delete;
+    public:
+
+        /**\param sets_per_pool maxSets of each pool created.
+         * \param create_flags Include VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT to allow Free(): otherwise, sets can only be freed all at once by Reset().
+         */
+        DescriptorPoolAllocator(const VkDevice& device, const uint32_t sets_per_pool = 64u, const VkDescriptorPoolCreateFlags create_flags = 0u);
+        ~DescriptorPoolAllocator();
+        DescriptorPoolAllocator(DescriptorPoolAllocator&& other) noexcept;
+        DescriptorPoolAllocator& operator=(DescriptorPoolAllocator&& other) noexcept;
+
+        /**Optional hint of the descriptors an average set needs, used to size pools until sets have actually been allocated.*/
+        void AddResourceType(const VkDescriptorType descriptor_type, const uint32_t count_per_set);
+
+        /**Allocates a set of the given layout. Returns the error from vkAllocateDescriptorSets or vkCreateDescriptorPool if even a new pool can't fit it.
+         * \param descriptor_counts Count of each descriptor type the layout uses (see DescriptorSetLayout::GetPoolSizes()).
+         * \param dest_pool Written with the pool the set was allocated from: pass it to Free().
+         */
+        VkResult Allocate(const VkDescriptorSetLayout set_layout, const VkDescriptorPoolSize* descriptor_counts, const uint32_t num_descriptor_counts,
+            VkDescriptorSet* dest_set, VkDescriptorPool* dest_pool);
+        /**Allocates a set of the given layout, using the layout's own descriptor counts. Throws if allocation fails.*/
+        VkDescriptorSet Allocate(const DescriptorSetLayout& set_layout, VkDescriptorPool* dest_pool);
+        /**Returns a set to its pool. Does nothing unless the pools were created with VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT.*/
+        void Free(const VkDescriptorPool pool, const VkDescriptorSet descriptor_set);
+        /**Resets every pool, freeing all sets allocated from them at once. Pools are kept for re-use: none of their sets may still be in use by the device.*/
+        void Reset();
+
+        VkDescriptorPoolCreateFlags CreateFlags() const noexcept;
+        DescriptorPoolAllocatorStats Stats() const;
+
+    private:
+        std::unique_ptr<DescriptorPoolAllocatorImpl> impl;
+    };
+
+}
+
+#endif //!VPR_DESCRIPTOR_POOL_ALLOCATOR_HPP
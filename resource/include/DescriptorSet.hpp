@@ -3,13 +3,19 @@
 #define VULPES_VK_DESCRIPTOR_SET_H
 #include "vpr_stdafx.h"
 #include <memory>
+#include <vector>
 
 namespace vpr
 {
 
+    class DescriptorPoolAllocator;
+    class DescriptorSetLayout;
+    class DescriptorUpdateTemplate;
+    class DescriptorUpdateBatch;
+
     /**RAII wrapper around a descriptor set, simplifying adding individual descriptor bindings for whatever stage they're required at. Wrapping descriptor functionality
      * in your own way for projects that are even slightly more advanced than test rigs is probably wise, however. Managing descriptor state, reducing bindings, and 
-     * coalescing what features/resources you can is for the best - along with using update templates, which this implementation does not support.
+     * coalescing what features/resources you can is for the best - along with using update templates, via the Update() overload taking a DescriptorUpdateTemplate.
      * \ingroup Resources
     */
     class VPR_API DescriptorSet
@@ -19,12 +25,14 @@ namespace vpr
     public:
 
         DescriptorSet(const VkDevice& parent);
+        /**Sizes binding storage for the given layout up front, so adding descriptors never allocates. Sets with only a few bindings don't allocate either way.*/
+        DescriptorSet(const VkDevice& parent, const DescriptorSetLayout& layout);
         ~DescriptorSet();
 
         DescriptorSet(DescriptorSet&& other) noexcept;
         DescriptorSet& operator=(DescriptorSet&& other) noexcept;
 
-        /**Sets the required image info for the descriptor at the given index */
+        /**Sets the required image info for the descriptor at the given index. Adding info for a binding that already has some replaces it.*/
         void AddDescriptorInfo(VkDescriptorImageInfo info, const VkDescriptorType type, const size_t item_binding_idx);
         /**Functionally the same as AddDescriptorInfo with VkDescriptorImageInfo. */
         void AddDescriptorInfo(VkDescriptorBufferInfo info, const VkDescriptorType descr_type, const size_t item_binding_idx);
@@ -37,14 +45,29 @@ namespace vpr
         *  and make sure you have enough space in the given pool for all of these resources. 
         */
         void Init(const VkDescriptorPool& parent_pool, const VkDescriptorSetLayout& set_layout);
-        // Calls vkUpdateDescriptorSets, updating the bindings with potentially new handles representing different buffers
+        /**Allocates this set from a DescriptorPoolAllocator instead of a fixed pool, so running out of pool space isn't a concern. The set is
+         * returned to the allocator upon destruction, unless the allocator's pools can't free sets individually (e.g. those of a TransientDescriptorPool):
+         * then destruction frees nothing, and the set becomes invalid once the allocator is reset.
+         */
+        void Init(DescriptorPoolAllocator* pool_allocator, const DescriptorSetLayout& set_layout);
+        // Calls vkUpdateDescriptorSets for the bindings changed since the last update: re-adding a binding's current descriptor doesn't count as a change
         void Update() const;
+        /**Updates every descriptor covered by the template from a single host struct, with one vkUpdateDescriptorSetWithTemplate call. Doesn't
+         * require any descriptor infos to have been added: the set just needs to have been initialized. Descriptor infos added before this are
+         * forgotten, so any added afterwards are always written by the next Update().
+         */
+        void Update(const DescriptorUpdateTemplate& update_template, const void* data) const;
         // Clears the write descriptors and info vectors, requiring an update call after re-adding the descriptors
         void Reset();
       
+        /**Number of bindings changed since the set was last updated.*/
+        uint32_t NumDirtyBindings() const noexcept;
         const VkDescriptorSet& vkHandle() const noexcept;
   
     private:
+        friend class DescriptorUpdateBatch;
+        /**Appends writes for dirty bindings, allocating the set first if needed, and marks them clean. The writes point into this set's storage.*/
+        uint32_t gatherDirtyWrites(std::vector<VkWriteDescriptorSet>& writes) const;
 
         void allocate(const VkDescriptorPool& parent_pool, const VkDescriptorSetLayout& set_layout) const;
         void update() const;
@@ -33,6 +33,12 @@ namespace vpr
         void AddDescriptorBinding(const VkDescriptorSetLayoutBinding& binding);
         void AddDescriptorBindings(const uint32_t num_bindings, const VkDescriptorSetLayoutBinding* bindings);
         void SetBindingFlags(const uint32_t binding, const VkDescriptorBindingFlagsEXT flags);
+        /**Retrieves the total count of each descriptor type used by this layout, in the style of the vkGet* enumeration functions: call with
+         * pool_sizes set to nullptr to retrieve the number of distinct types first. Used to size descriptor pools for sets of this layout.
+         */
+        void GetPoolSizes(uint32_t* num_pool_sizes, VkDescriptorPoolSize* pool_sizes) const noexcept;
+        /**Retrieves the bindings of this layout in binding order, in the same manner as GetPoolSizes().*/
+        void GetBindings(uint32_t* num_bindings, VkDescriptorSetLayoutBinding* bindings) const noexcept;
 
         /**Calling vkHandle() on this object will create the object if it is not already ready for use.*/
         const VkDescriptorSetLayout& vkHandle() const noexcept;
@@ -0,0 +1,43 @@
+#pragma once
+#ifndef VPR_DESCRIPTOR_UPDATE_BATCH_HPP
+#define VPR_DESCRIPTOR_UPDATE_BATCH_HPP
+#include "vpr_stdafx.h"
+#include <memory>
+
+namespace vpr
+{
+
+    class DescriptorSet;
+    struct DescriptorUpdateBatchImpl;
+
+    /**Gathers the dirty bindings of many DescriptorSets into a single vkUpdateDescriptorSets call. Queue sets with Add() as they're modified
+     * (e.g. as materials are edited, or streamed textures swapped in), then call Flush() once before recording: only bindings that changed
+     * are written, so the cost is proportional to what changed rather than to the number of sets.
+     *
+     * Sets must stay alive until Flush(). Adding the same set more than once is harmless, as its bindings are clean after the first gather.
+     * Storage is kept between flushes, so a batch used each frame stops allocating once it has grown to fit.
+     * \ingroup Resources
+     */
+    class VPR_API DescriptorUpdateBatch
+    {
+        DescriptorUpdateBatch(const DescriptorUpdateBatch&) = delete;
+        DescriptorUpdateBatch& operator=(const DescriptorUpdateBatch&) = delete;
+    public:
+
+        DescriptorUpdateBatch(const VkDevice& device);
+        ~DescriptorUpdateBatch();
+        DescriptorUpdateBatch(DescriptorUpdateBatch&& other) noexcept;
+        DescriptorUpdateBatch& operator=(DescriptorUpdateBatch&& other) noexcept;
+
+        void Add(const DescriptorSet* descriptor_set);
+        /**Writes the dirty bindings of every set added since the last flush. Returns the number of descriptors written.*/
+        uint32_t Flush();
+        size_t NumPendingSets() const noexcept;
+
+    private:
+        std::unique_ptr<DescriptorUpdateBatchImpl> impl;
+    };
+
+}
+
+#endif //!VPR_DESCRIPTOR_UPDATE_BATCH_HPP
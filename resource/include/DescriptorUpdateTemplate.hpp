@@ -0,0 +1,62 @@
+#pragma once
+#ifndef VPR_DESCRIPTOR_UPDATE_TEMPLATE_HPP
+#define VPR_DESCRIPTOR_UPDATE_TEMPLATE_HPP
+#include "vpr_stdafx.h"
+#include "ForwardDecl.hpp"
+#include <memory>
+
+namespace vpr
+{
+
+    struct DescriptorUpdateTemplateImpl;
+
+    /**Wrapper around a VkDescriptorUpdateTemplate, which updates every descriptor of a set from a single host struct in one call: rather than
+     * building an array of VkWriteDescriptorSet structures each update, as DescriptorSet::Update() does.
+     *
+     * By default, entries are derived from the layout, and descriptors are read from a packed struct laid out in binding order. Each binding is
+     * an array of descriptorCount VkDescriptorImageInfo (samplers and images), VkDescriptorBufferInfo (buffers) or VkBufferView (texel buffers),
+     * starting at Offset(binding). For a layout with a uniform buffer at binding 0 and a combined image sampler at binding 1, this matches:
+     * \code
+     * struct MaterialDescriptors
+     * {
+     *     VkDescriptorBufferInfo Uniforms;
+     *     VkDescriptorImageInfo Albedo;
+     * };
+     * \endcode
+     * Supply entries of your own to read from a struct laid out differently.
+     *
+     * Requires Vulkan 1.1 or VK_KHR_descriptor_update_template: throws if neither is available.
+     * \ingroup Resources
+     */
+    class VPR_API DescriptorUpdateTemplate
+    {
+        DescriptorUpdateTemplate(const DescriptorUpdateTemplate&) = delete;
+        DescriptorUpdateTemplate& operator=(const DescriptorUpdateTemplate&) = delete;
+    public:
+
+        /**Creates a template reading from a packed struct, with entries for each binding of the layout.*/
+        DescriptorUpdateTemplate(const Device* device, const DescriptorSetLayout& set_layout);
+        DescriptorUpdateTemplate(const Device* device, const DescriptorSetLayout& set_layout, const VkDescriptorUpdateTemplateEntry* entries, const uint32_t num_entries);
+        ~DescriptorUpdateTemplate();
+        DescriptorUpdateTemplate(DescriptorUpdateTemplate&& other) noexcept;
+        DescriptorUpdateTemplate& operator=(DescriptorUpdateTemplate&& other) noexcept;
+
+        /**Writes every descriptor covered by the template from data, with a single call to vkUpdateDescriptorSetWithTemplate.*/
+        void UpdateSet(const VkDescriptorSet descriptor_set, const void* data) const;
+
+        /**Offset of the given binding in the packed struct: only meaningful for templates using the default, derived entries.*/
+        size_t Offset(const uint32_t binding) const noexcept;
+        /**Size of the packed struct, or the end of the furthest entry for templates given their own entries.*/
+        size_t DataSize() const noexcept;
+        const VkDescriptorUpdateTemplate& vkHandle() const noexcept;
+
+        /**Size of the host structure describing a single descriptor of the given type.*/
+        static size_t DescriptorInfoSize(const VkDescriptorType type) noexcept;
+
+    private:
+        std::unique_ptr<DescriptorUpdateTemplateImpl> impl;
+    };
+
+}
+
+#endif //!VPR_DESCRIPTOR_UPDATE_TEMPLATE_HPP
@@ -0,0 +1,86 @@
+#pragma once
+#ifndef VPR_DYNAMIC_UNIFORM_BUFFER_HPP
+#define VPR_DYNAMIC_UNIFORM_BUFFER_HPP
+#include "vpr_stdafx.h"
+#include "ForwardDecl.hpp"
+#include <memory>
+#include <cstring>
+
+namespace vpr
+{
+
+    struct DynamicUniformBufferImpl;
+
+    /**Region of a DynamicUniformBuffer, valid until the frame it was allocated in comes around again.
+     * \ingroup Resources
+     */
+    struct VPR_API DynamicUniformAllocation
+    {
+        /**Host pointer to write the uniform data to: nullptr if the allocation failed.*/
+        void* Data{ nullptr };
+        /**Pass to vkCmdBindDescriptorSets as the dynamic offset of the binding.*/
+        uint32_t DynamicOffset{ 0u };
+        VkDeviceSize Size{ 0u };
+        bool Valid() const noexcept { return Data != nullptr; }
+    };
+
+    /**A linear allocator over one large, persistently mapped uniform buffer, for per-draw constants bound as VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC.
+     * A single descriptor set written with DescriptorInfo() can then serve every draw in a frame, with only the dynamic offset changing
+     * between draws: rather than each object having a uniform buffer and descriptor set of its own.
+     *
+     * The buffer is split into one region per frame in flight, and BeginFrame() resets the bump pointer of a frame's region: the frame's
+     * previous use of that region must have completed. Allocations are aligned to minUniformBufferOffsetAlignment, and can be made from
+     * any number of threads at once.
+     * \ingroup Resources
+     */
+    class VPR_API DynamicUniformBuffer
+    {
+        DynamicUniformBuffer(const DynamicUniformBuffer&) = delete;
+        DynamicUniformBuffer& operator=(const DynamicUniformBuffer&) = delete;
+    public:
+
+        /**\param size_per_frame Bytes available to each frame, rounded up to minUniformBufferOffsetAlignment.*/
+        DynamicUniformBuffer(Allocator* allocator, const VkDeviceSize size_per_frame, const uint32_t frames_in_flight);
+        ~DynamicUniformBuffer();
+        DynamicUniformBuffer(DynamicUniformBuffer&& other) noexcept;
+        DynamicUniformBuffer& operator=(DynamicUniformBuffer&& other) noexcept;
+
+        /**Makes the given frame's region current, discarding everything previously allocated from it.*/
+        void BeginFrame(const uint32_t frame_idx);
+        /**Returns an invalid allocation if the current frame's region is full.*/
+        DynamicUniformAllocation Allocate(const VkDeviceSize size);
+        /**Allocates space for and copies the given object into the buffer.*/
+        template<typename T>
+        DynamicUniformAllocation Push(const T& data);
+        /**Flushes everything allocated in the current frame so far, if the memory isn't coherent. Call before submitting the frame.*/
+        void Flush();
+
+        /**Descriptor info for writing the dynamic uniform buffer binding.
+         * \param range Size of the uniform block in the shader: every allocation bound with this descriptor must be at least this large.
+         */
+        VkDescriptorBufferInfo DescriptorInfo(const VkDeviceSize range) const noexcept;
+        const VkBuffer& vkHandle() const noexcept;
+        /**minUniformBufferOffsetAlignment: every allocation is rounded up to a multiple of this.*/
+        VkDeviceSize Alignment() const noexcept;
+        VkDeviceSize FrameSize() const noexcept;
+        /**Bytes allocated from the current frame's region so far.*/
+        VkDeviceSize BytesUsed() const noexcept;
+
+    private:
+        std::unique_ptr<DynamicUniformBufferImpl> impl;
+    };
+
+    template<typename T>
+    inline DynamicUniformAllocation DynamicUniformBuffer::Push(const T& data)
+    {
+        DynamicUniformAllocation result = Allocate(sizeof(T));
+        if (result.Valid())
+        {
+            std::memcpy(result.Data, &data, sizeof(T));
+        }
+        return result;
+    }
+
+}
+
+#endif //!VPR_DYNAMIC_UNIFORM_BUFFER_HPP
@@ -0,0 +1,64 @@
+#pragma once
+#ifndef VPR_IMAGE_HPP
+#define VPR_IMAGE_HPP
+#include "vpr_stdafx.h"
+#include "ForwardDecl.hpp"
+#include "AllocationRequirements.hpp"
+#include <memory>
+
+namespace vpr
+{
+
+    struct ImageImpl;
+
+    /**RAII wrapper around a VkImage and the Allocation backing it, suballocated (or given dedicated memory, for large render targets) by an Allocator.
+     *
+     * Image views are created the first time they're requested, and cached per format, view type and subresource range: so View() can be
+     * called freely each frame, rather than each user keeping views of their own around. Views are destroyed along with the image.
+     *
+     * Linearly tiled images in host-visible memory can be persistently mapped like a Buffer, though writes to them must respect the row
+     * pitch given by vkGetImageSubresourceLayout.
+     * \ingroup Resources
+     */
+    class VPR_API Image
+    {
+        Image(const Image&) = delete;
+        Image& operator=(const Image&) = delete;
+    public:
+
+        /**Creates the image and binds memory to it: throws if either fails.*/
+        Image(Allocator* allocator, const VkImageCreateInfo& create_info, const AllocationRequirements& alloc_reqs);
+        ~Image();
+        Image(Image&& other) noexcept;
+        Image& operator=(Image&& other) noexcept;
+
+        /**Returns a view of the entire image, in the image's format and with the aspect and view type implied by its creation parameters.*/
+        VkImageView View() const;
+        /**Returns a view of the given subresources.
+         * \param format Leave as VK_FORMAT_UNDEFINED to use the image's format.
+         * \param view_type Leave as VK_IMAGE_VIEW_TYPE_MAX_ENUM to derive the type from the image type, array layer count and cube compatibility.
+         */
+        VkImageView View(const VkImageSubresourceRange& range, const VkFormat format = VK_FORMAT_UNDEFINED, const VkImageViewType view_type = VK_IMAGE_VIEW_TYPE_MAX_ENUM) const;
+
+        /**Pointer to the start of the image's memory if it was persistently mapped, otherwise nullptr.*/
+        void* MappedData() const noexcept;
+        /**Flushes host writes to a persistently mapped image. Does nothing for coherent memory.*/
+        void Flush(const VkDeviceSize offset = 0u, const VkDeviceSize size = VK_WHOLE_SIZE);
+
+        const VkImage& vkHandle() const noexcept;
+        VkFormat Format() const noexcept;
+        const VkExtent3D& Extent() const noexcept;
+        uint32_t MipLevels() const noexcept;
+        uint32_t ArrayLayers() const noexcept;
+        VkImageUsageFlags Usage() const noexcept;
+        /**Covers every mip level and array layer, with the aspect mask implied by the image's format.*/
+        VkImageSubresourceRange FullRange() const noexcept;
+        const Allocation& MemoryAllocation() const noexcept;
+
+    private:
+        std::unique_ptr<ImageImpl> impl;
+    };
+
+}
+
+#endif //!VPR_IMAGE_HPP
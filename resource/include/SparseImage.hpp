@@ -0,0 +1,119 @@
+#pragma once
+#ifndef VPR_SPARSE_IMAGE_HPP
+#define VPR_SPARSE_IMAGE_HPP
+#include "vpr_stdafx.h"
+#include "ForwardDecl.hpp"
+#include <memory>
+#include <vector>
+
+namespace vpr
+{
+
+    struct SparseImageImpl;
+
+    /**Coordinates of a single tile of a SparseImage: X, Y and Z are in tiles, not texels.
+     * \ingroup Resources
+     */
+    struct VPR_API SparseTile
+    {
+        uint32_t Layer{ 0u };
+        uint32_t MipLevel{ 0u };
+        uint32_t X{ 0u };
+        uint32_t Y{ 0u };
+        uint32_t Z{ 0u };
+    };
+
+    /**\ingroup Resources*/
+    struct VPR_API SparseResidencyStats
+    {
+        uint32_t ResidentTiles{ 0u };
+        uint32_t MaxResidentTiles{ 0u };
+        /**Tiles requested, but not yet resident.*/
+        uint32_t PendingTiles{ 0u };
+        uint64_t TilesCommitted{ 0u };
+        uint64_t TilesEvicted{ 0u };
+        /**Requests left pending because no memory or no evictable tile was available.*/
+        uint64_t FailedCommits{ 0u };
+        VkDeviceSize ResidentBytes{ 0u };
+        /**Memory bound to the mip tail, which is always resident.*/
+        VkDeviceSize MipTailBytes{ 0u };
+    };
+
+    /**A partially resident image, for textures too large to keep resident in full (e.g. terrain virtual textures). The image is created with
+     * sparse residency, and only the tiles that have been requested are backed by memory: suballocated from the Allocator one tile at a time.
+     * The mip tail (the levels too small to split into tiles) is bound at creation, and always stays resident.
+     *
+     * Each frame, report the tiles that were sampled via RequestTile() or ProcessFeedback(), then call Update(). Update() commits memory to
+     * requested tiles through vkQueueBindSparse, and when the resident tile limit is reached evicts the tiles requested least recently. Coarser
+     * tiles covering a requested tile are requested too, so there is always a resident fallback to sample from. Newly committed tiles have
+     * undefined contents: upload into them (see TileOffset() and TileExtent()) once the signal semaphore given to Update() has been signaled.
+     *
+     * Requires the sparseBinding and sparseResidencyImage2D (or 3D) features, and a queue with VK_QUEUE_SPARSE_BINDING_BIT: by default, the
+     * Device's sparse binding queue is used.
+     * \ingroup Resources
+     */
+    class VPR_API SparseImage
+    {
+        SparseImage(const SparseImage&) = delete;
+        SparseImage& operator=(const SparseImage&) = delete;
+    public:
+
+        /**\param create_info Flags must include VK_IMAGE_CREATE_SPARSE_BINDING_BIT and VK_IMAGE_CREATE_SPARSE_RESIDENCY_BIT.
+         * \param max_resident_tiles Upper bound on the tiles backed by memory at once, excluding the mip tail.
+         * \param eviction_delay Updates a tile must go unrequested for before it can be evicted: at least the number of frames in flight,
+         * so frames still sampling a tile are done with it before it's unbound.
+         * \param sparse_queue Queue to bind memory on. Leave as VK_NULL_HANDLE to use Device::SparseBindingQueue(). Throws if no sparse binding queue is available.
+         */
+        SparseImage(Allocator* allocator, const VkImageCreateInfo& create_info, const uint32_t max_resident_tiles, const uint32_t eviction_delay = 3u,
+            VkQueue sparse_queue = VK_NULL_HANDLE);
+        /**Waits for any binding in flight, then destroys the image and frees all of its memory.*/
+        ~SparseImage();
+        SparseImage(SparseImage&& other) noexcept;
+        SparseImage& operator=(SparseImage&& other) noexcept;
+
+        /**Marks a tile (and the coarser tiles covering it) as used this frame, committing it in the next Update() if it's not resident.
+         * Requests for mip levels in the mip tail are ignored, as the tail is always resident. Can be called from multiple threads.
+         */
+        void RequestTile(const SparseTile& tile);
+        /**Requests tiles from a feedback buffer holding one byte per tile of the first mip level of a 2D layer: the finest mip level sampled
+         * in that tile, or 0xff if it wasn't sampled at all. Rows are TileCount(0).width tiles long.
+         */
+        void ProcessFeedback(const uint8_t* min_lods, const uint32_t layer = 0u);
+        /**Commits up to max_commits requested tiles, and evicts tiles as needed to stay under the resident tile limit. Does nothing if the previous
+         * binding operation hasn't completed yet, or if there is nothing to bind.
+         *
+         * The semaphores are only used when a binding operation is actually submitted, which is reported through bind_submitted: that can happen
+         * even when no tiles are returned, if the update only evicted tiles. When nothing was submitted, wait_semaphore has not been waited on
+         * and signal_semaphore will not be signaled, so the caller must not wait on it.
+         * \param wait_semaphore Optional semaphore the binding operation waits on.
+         * \param signal_semaphore Optional semaphore signaled once the binding operation completes: wait on it before uploading to or sampling
+         * from newly committed tiles.
+         * \param bind_submitted Optional: set to whether vkQueueBindSparse was called, and so whether the semaphores were used.
+         * \return Tiles committed by this update, which need their contents uploaded.
+         */
+        std::vector<SparseTile> Update(const uint32_t max_commits = 64u, VkSemaphore wait_semaphore = VK_NULL_HANDLE, VkSemaphore signal_semaphore = VK_NULL_HANDLE,
+            bool* bind_submitted = nullptr);
+
+        bool IsResident(const SparseTile& tile) const;
+        /**Texel offset of the tile within its mip level, for copying data into it.*/
+        VkOffset3D TileOffset(const SparseTile& tile) const noexcept;
+        /**Texel extent of the tile, clamped to the bounds of its mip level.*/
+        VkExtent3D TileExtent(const SparseTile& tile) const noexcept;
+        /**Number of tiles along each axis of the given mip level. Only valid for levels below MipTailFirstLod().*/
+        VkExtent3D TileCount(const uint32_t mip_level) const noexcept;
+        /**Size of a tile in texels.*/
+        const VkExtent3D& TileGranularity() const noexcept;
+        /**First mip level of the mip tail: equal to the number of mip levels if there is no mip tail.*/
+        uint32_t MipTailFirstLod() const noexcept;
+
+        const VkImage& vkHandle() const noexcept;
+        const VkImageCreateInfo& CreateInfo() const noexcept;
+        SparseResidencyStats Stats() const;
+
+    private:
+        std::unique_ptr<SparseImageImpl> impl;
+    };
+
+}
+
+#endif //!VPR_SPARSE_IMAGE_HPP
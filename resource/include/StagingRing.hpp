@@ -0,0 +1,106 @@
+#pragma once
+#ifndef VPR_STAGING_RING_HPP
+#define VPR_STAGING_RING_HPP
+#include "vpr_stdafx.h"
+#include "ForwardDecl.hpp"
+#include <memory>
+#include <limits>
+
+namespace vpr
+{
+
+    struct StagingRingImpl;
+
+    /**Space reserved within a StagingRing. Data is only valid until the frame it was reserved in retires.
+     * \ingroup Resources
+     */
+    struct VPR_API StagingAllocation
+    {
+        /**Host pointer to write the data to: nullptr if the reservation failed.*/
+        void* Data{ nullptr };
+        /**Offset of this reservation within Buffer, for use as a copy source offset.*/
+        VkDeviceSize Offset{ 0u };
+        VkDeviceSize Size{ 0u };
+        VkBuffer Buffer{ VK_NULL_HANDLE };
+        bool Valid() const noexcept { return Data != nullptr; }
+    };
+
+    /**Statistics gathered by a StagingRing over its lifetime: a high FailedReservations count means the ring is too small for the upload rate.
+     * \ingroup Resources
+     */
+    struct VPR_API StagingRingStats
+    {
+        uint64_t NumReservations{ 0u };
+        VkDeviceSize BytesReserved{ 0u };
+        /**Reservations that failed because the ring had no room left for them.*/
+        uint64_t FailedReservations{ 0u };
+        /**Largest quantity of bytes in use at once, across all frames in flight.*/
+        VkDeviceSize PeakBytesInUse{ 0u };
+    };
+
+    /**The StagingRing is a single persistently-mapped, host-visible buffer that upload data for many resources is written into, replacing
+     * a staging buffer (and allocation) per upload. Space is reserved with an atomic bump of the ring's head, so any number of threads can
+     * reserve and write into the ring at once without locking. The region used by each frame is reclaimed when that frame retires, so the
+     * ring should be large enough to hold the uploads of every frame in flight.
+     *
+     * Reservations never straddle the end of the buffer: one that doesn't fit before the end starts at the beginning again. The copy regions
+     * produced by CopyRegion() and ImageCopyRegion() are meant to be handed to TransferBatcher::CopyBuffer() and
+     * TransferBatcher::CopyBufferToImage(), with the ring's vkHandle() as the source buffer.
+     *
+     * BeginFrame() must not be called while other threads are reserving space: call it from the thread running the frame loop, between frames.
+     * \ingroup Resources
+     */
+    class VPR_API StagingRing
+    {
+        StagingRing(const StagingRing&) = delete;
+        StagingRing& operator=(const StagingRing&) = delete;
+    public:
+
+        /**\param size Total size of the ring, shared between all frames in flight.*/
+        StagingRing(Allocator* allocator, const VkDeviceSize size, const uint32_t frames_in_flight);
+        ~StagingRing();
+        StagingRing(StagingRing&& other) noexcept;
+        StagingRing& operator=(StagingRing&& other) noexcept;
+
+        /**Starts recording uploads for the given frame slot, reclaiming the space used the last time that slot was recorded. The work using
+         * that space must have completed: pass the fence of the frame slot to have it waited on here, or VK_NULL_HANDLE if it has already
+         * been waited on (e.g. by FrameManager::BeginFrame()).
+         */
+        void BeginFrame(const uint32_t frame_idx, const VkFence frame_fence = VK_NULL_HANDLE);
+        /**Reserves space in the ring. Returns an invalid allocation if the ring is full: flush and wait on pending transfers, or fall back to a dedicated staging buffer.
+         * \param alignment Leave at 0 to use optimalBufferCopyOffsetAlignment (at least 4 bytes). This is only suitable for buffer copies: use
+         * ReserveForImage() for data copied into an image.
+         */
+        StagingAllocation Reserve(const VkDeviceSize size, const VkDeviceSize alignment = 0u);
+        /**Reserves space for data copied into an image of the given format, aligned as vkCmdCopyBufferToImage requires (see ImageCopyAlignment()).*/
+        StagingAllocation ReserveForImage(const VkDeviceSize size, const VkFormat format);
+        /**Reserves space and copies the given data into it.*/
+        StagingAllocation Upload(const void* data, const VkDeviceSize size, const VkDeviceSize alignment = 0u);
+        /**Reserves space for an image of the given format and copies the given data into it.*/
+        StagingAllocation UploadForImage(const void* data, const VkDeviceSize size, const VkFormat format);
+
+        /**Alignment required of the buffer offset when copying into an image of the given format: the least common multiple of 4 and the
+         * format's texel block size (e.g. 16 for BC7 or ASTC, 12 for R32G32B32). Formats this doesn't know the size of are treated as having
+         * a block size of 4 or less.
+         */
+        static VkDeviceSize ImageCopyAlignment(const VkFormat format) noexcept;
+        static VkBufferCopy CopyRegion(const StagingAllocation& src, const VkDeviceSize dst_offset = 0u) noexcept;
+        /**Region copying the reservation into an image, with the data tightly packed (bufferRowLength and bufferImageHeight of 0). The
+         * reservation must have been made with ReserveForImage() or UploadForImage(), for the offset to be valid for the image's format.
+         */
+        static VkBufferImageCopy ImageCopyRegion(const StagingAllocation& src, const VkImageSubresourceLayers& dst_subresource, const VkOffset3D& dst_offset,
+            const VkExtent3D& dst_extent) noexcept;
+
+        const VkBuffer& vkHandle() const noexcept;
+        VkDeviceSize Size() const noexcept;
+        /**Bytes reserved by frames that haven't yet retired.*/
+        VkDeviceSize BytesInUse() const noexcept;
+        StagingRingStats Stats() const noexcept;
+
+    private:
+        std::unique_ptr<StagingRingImpl> impl;
+    };
+
+}
+
+#endif //!VPR_STAGING_RING_HPP
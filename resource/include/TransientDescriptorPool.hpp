@@ -0,0 +1,52 @@
+#pragma once
+#ifndef VPR_TRANSIENT_DESCRIPTOR_POOL_HPP
+#define VPR_TRANSIENT_DESCRIPTOR_POOL_HPP
+#include "vpr_stdafx.h"
+#include "ForwardDecl.hpp"
+#include <memory>
+
+namespace vpr
+{
+
+    class DescriptorPoolAllocator;
+    struct TransientDescriptorPoolImpl;
+
+    /**Allocates descriptor sets that only live for a single frame. Each frame in flight gets its own DescriptorPoolAllocator, with pools created
+     * without VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT: sets are never freed individually, and BeginFrame() instead frees all of a
+     * frame's sets at once with a single vkResetDescriptorPool call per pool. Pools are kept between frames, so after the first few frames no
+     * pools are created and allocation is little more than a bump of the pool's internal pointer.
+     *
+     * Sets are invalid once their frame comes around again: don't hold on to them, or to DescriptorSet objects initialized from FrameAllocator(),
+     * for longer than that.
+     * \ingroup Resources
+     */
+    class VPR_API TransientDescriptorPool
+    {
+        TransientDescriptorPool(const TransientDescriptorPool&) = delete;
+        TransientDescriptorPool& operator=(const TransientDescriptorPool&) = delete;
+    public:
+
+        TransientDescriptorPool(const VkDevice& device, const uint32_t frames_in_flight, const uint32_t sets_per_pool = 256u);
+        ~TransientDescriptorPool();
+        TransientDescriptorPool(TransientDescriptorPool&& other) noexcept;
+        TransientDescriptorPool& operator=(TransientDescriptorPool&& other) noexcept;
+
+        /**Hint of the descriptors an average set needs, passed on to the allocator of every frame.*/
+        void AddResourceType(const VkDescriptorType descriptor_type, const uint32_t count_per_set);
+        /**Makes the given frame current, resetting its pools: the device must be done with the frame's previous use of them.*/
+        void BeginFrame(const uint32_t frame_idx);
+        /**Allocates a set from the current frame's pools. Throws if allocation fails.*/
+        VkDescriptorSet Allocate(const DescriptorSetLayout& set_layout);
+        VkResult Allocate(const VkDescriptorSetLayout set_layout, const VkDescriptorPoolSize* descriptor_counts, const uint32_t num_descriptor_counts, VkDescriptorSet* dest_set);
+
+        /**Allocator of the current frame, for use with DescriptorSet::Init(): destroying such a DescriptorSet doesn't free anything.*/
+        DescriptorPoolAllocator* FrameAllocator() noexcept;
+        uint32_t CurrentFrame() const noexcept;
+
+    private:
+        std::unique_ptr<TransientDescriptorPoolImpl> impl;
+    };
+
+}
+
+#endif //!VPR_TRANSIENT_DESCRIPTOR_POOL_HPP
@@ -0,0 +1,251 @@
+#include "vpr_stdafx.h"
+#include "Buffer.hpp"
+#include "Allocator.hpp"
+#include "Allocation.hpp"
+#include "LogicalDevice.hpp"
+#include "vkAssert.hpp"
+#include "CreateInfoBase.hpp"
+#include <vector>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <algorithm>
+#include <cstring>
+#include <cassert>
+#include <stdexcept>
+
+namespace vpr
+{
+
+    struct buffer_view_key_t
+    {
+        VkFormat format;
+        VkDeviceSize offset;
+        VkDeviceSize range;
+        bool operator<(const buffer_view_key_t& other) const noexcept
+        {
+            return std::tie(format, offset, range) < std::tie(other.format, other.offset, other.range);
+        }
+    };
+
+    struct dirty_range_t
+    {
+        VkDeviceSize begin;
+        VkDeviceSize end;
+    };
+
+    struct BufferImpl
+    {
+        BufferImpl(Allocator* _allocator, const VkBufferCreateInfo& create_info, const AllocationRequirements& alloc_reqs);
+        ~BufferImpl();
+
+        Allocator* allocator{ nullptr };
+        VkDevice device{ VK_NULL_HANDLE };
+        VkBuffer handle{ VK_NULL_HANDLE };
+        Allocation allocation;
+        VkDeviceSize size{ 0u };
+        VkBufferUsageFlags usage{ 0u };
+        bool coherent{ false };
+        VkDeviceSize nonCoherentAtomSize{ 1u };
+        std::mutex dirtyMutex;
+        std::vector<dirty_range_t> dirtyRanges;
+        mutable std::mutex viewMutex;
+        mutable std::map<buffer_view_key_t, VkBufferView> views;
+    };
+
+    BufferImpl::BufferImpl(Allocator* _allocator, const VkBufferCreateInfo& create_info, const AllocationRequirements& alloc_reqs) : allocator(_allocator),
+        device(_allocator->ParentDevice()->vkHandle()), size(create_info.size), usage(create_info.usage)
+    {
+        VkResult result = allocator->CreateBuffer(create_info, alloc_reqs, &handle, allocation);
+        if (result != VK_SUCCESS)
+        {
+            // A failed bind still leaves the buffer and its memory behind, and our destructor won't run
+            if (handle != VK_NULL_HANDLE)
+            {
+                allocator->DestroyBuffer(handle, allocation);
+            }
+            throw std::runtime_error("Failed to create Buffer, or to allocate and bind memory for it!");
+        }
+        const Device* parent = allocator->ParentDevice();
+        const VkMemoryPropertyFlags flags = parent->GetPhysicalDeviceMemoryProperties().memoryTypes[allocation.MemoryTypeIdx()].propertyFlags;
+        coherent = (flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0u;
+        nonCoherentAtomSize = std::max(parent->GetPhysicalDeviceProperties().limits.nonCoherentAtomSize, VkDeviceSize(1u));
+    }
+
+    BufferImpl::~BufferImpl()
+    {
+        for (auto& view : views)
+        {
+            vkDestroyBufferView(device, view.second, nullptr);
+        }
+        allocator->DestroyBuffer(handle, allocation);
+    }
+
+    Buffer::Buffer(Allocator* allocator, const VkBufferCreateInfo& create_info, const AllocationRequirements& alloc_reqs) :
+        impl(std::make_unique<BufferImpl>(allocator, create_info, alloc_reqs)) {}
+
+    Buffer::~Buffer() {}
+
+    Buffer::Buffer(Buffer&& other) noexcept : impl(std::move(other.impl)) {}
+
+    Buffer& Buffer::operator=(Buffer&& other) noexcept
+    {
+        impl = std::move(other.impl);
+        return *this;
+    }
+
+    void Buffer::Write(const void* data, const VkDeviceSize size, const VkDeviceSize offset)
+    {
+        assert(offset + size <= impl->size);
+        if (impl->allocation.MappedData() != nullptr)
+        {
+            std::memcpy(reinterpret_cast<char*>(impl->allocation.MappedData()) + offset, data, static_cast<size_t>(size));
+        }
+        else
+        {
+            void* mapped = impl->allocation.Map();
+            std::memcpy(reinterpret_cast<char*>(mapped) + offset, data, static_cast<size_t>(size));
+            impl->allocation.Unmap();
+        }
+        MarkDirty(offset, size);
+    }
+
+    void Buffer::MarkDirty(const VkDeviceSize offset, const VkDeviceSize size)
+    {
+        if (impl->coherent)
+        {
+            return;
+        }
+        const VkDeviceSize end = size == VK_WHOLE_SIZE ? impl->size : std::min(offset + size, impl->size);
+        std::lock_guard<std::mutex> lock(impl->dirtyMutex);
+        impl->dirtyRanges.emplace_back(dirty_range_t{ offset, end });
+    }
+
+    void Buffer::FlushDirtyRanges()
+    {
+        if (impl->coherent)
+        {
+            return;
+        }
+
+        std::vector<dirty_range_t> ranges;
+        {
+            std::lock_guard<std::mutex> lock(impl->dirtyMutex);
+            ranges.swap(impl->dirtyRanges);
+        }
+
+        if (ranges.empty())
+        {
+            return;
+        }
+
+        // Expand to whole atoms (relative to the memory object, not the buffer) first, so that ranges sharing an atom get merged
+        const VkDeviceSize atom = impl->nonCoherentAtomSize;
+        const VkDeviceSize base = impl->allocation.Offset();
+        const VkDeviceSize memory_size = impl->allocation.Block()->Size();
+        for (auto& range : ranges)
+        {
+            range.begin = (base + range.begin) / atom * atom;
+            range.end = std::min((base + range.end + atom - 1u) / atom * atom, memory_size);
+        }
+
+        std::sort(ranges.begin(), ranges.end(), [](const dirty_range_t& a, const dirty_range_t& b) { return a.begin < b.begin; });
+
+        std::vector<VkMappedMemoryRange> mapped_ranges;
+        mapped_ranges.reserve(ranges.size());
+        dirty_range_t current = ranges.front();
+        for (size_t i = 1u; i < ranges.size(); ++i)
+        {
+            if (ranges[i].begin <= current.end)
+            {
+                current.end = std::max(current.end, ranges[i].end);
+            }
+            else
+            {
+                VkMappedMemoryRange mapped_range = vk_mapped_memory_base;
+                mapped_range.memory = impl->allocation.Memory();
+                mapped_range.offset = current.begin;
+                mapped_range.size = current.end - current.begin;
+                mapped_ranges.emplace_back(mapped_range);
+                current = ranges[i];
+            }
+        }
+
+        VkMappedMemoryRange mapped_range = vk_mapped_memory_base;
+        mapped_range.memory = impl->allocation.Memory();
+        mapped_range.offset = current.begin;
+        mapped_range.size = current.end - current.begin;
+        mapped_ranges.emplace_back(mapped_range);
+
+        VkResult result = vkFlushMappedMemoryRanges(impl->device, static_cast<uint32_t>(mapped_ranges.size()), mapped_ranges.data());
+        VkAssert(result);
+    }
+
+    void Buffer::Invalidate(const VkDeviceSize offset, const VkDeviceSize size)
+    {
+        impl->allocator->InvalidateMemory(impl->allocation, offset, size);
+    }
+
+    void* Buffer::Map()
+    {
+        return impl->allocation.Map();
+    }
+
+    void Buffer::Unmap()
+    {
+        impl->allocation.Unmap();
+    }
+
+    void* Buffer::MappedData() const noexcept
+    {
+        return impl->allocation.MappedData();
+    }
+
+    VkBufferView Buffer::View(const VkFormat format, const VkDeviceSize offset, const VkDeviceSize range) const
+    {
+        const buffer_view_key_t key{ format, offset, range };
+        std::lock_guard<std::mutex> lock(impl->viewMutex);
+        auto iter = impl->views.find(key);
+        if (iter != impl->views.end())
+        {
+            return iter->second;
+        }
+
+        VkBufferViewCreateInfo view_info = vk_buffer_view_create_info_base;
+        view_info.buffer = impl->handle;
+        view_info.format = format;
+        view_info.offset = offset;
+        view_info.range = range;
+        VkBufferView view = VK_NULL_HANDLE;
+        VkResult result = vkCreateBufferView(impl->device, &view_info, nullptr, &view);
+        VkAssert(result);
+        impl->views.emplace(key, view);
+        return view;
+    }
+
+    const VkBuffer& Buffer::vkHandle() const noexcept
+    {
+        return impl->handle;
+    }
+
+    VkDeviceSize Buffer::Size() const noexcept
+    {
+        return impl->size;
+    }
+
+    VkBufferUsageFlags Buffer::Usage() const noexcept
+    {
+        return impl->usage;
+    }
+
+    const Allocation& Buffer::MemoryAllocation() const noexcept
+    {
+        return impl->allocation;
+    }
+
+    bool Buffer::HostCoherent() const noexcept
+    {
+        return impl->coherent;
+    }
+
+}
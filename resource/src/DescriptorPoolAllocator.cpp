@@ -0,0 +1,321 @@
+#include "vpr_stdafx.h"
+#include "DescriptorPoolAllocator.hpp"
+#include "DescriptorSetLayout.hpp"
+#include "vkAssert.hpp"
+#include "CreateInfoBase.hpp"
+#include "easylogging++.h"
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <algorithm>
+#include <mutex>
+#include <cassert>
+
+namespace vpr
+{
+
+    struct pool_entry_t
+    {
+        VkDescriptorPool handle{ VK_NULL_HANDLE };
+        uint32_t setsRemaining{ 0u };
+        std::map<VkDescriptorType, uint32_t> capacity;
+        std::map<VkDescriptorType, uint32_t> remaining;
+        bool exhausted{ false };
+    };
+
+    struct allocated_set_t
+    {
+        size_t poolIdx;
+        std::vector<VkDescriptorPoolSize> counts;
+    };
+
+    struct DescriptorPoolAllocatorImpl
+    {
+        DescriptorPoolAllocatorImpl(const VkDevice& device, const uint32_t sets_per_pool, const VkDescriptorPoolCreateFlags create_flags);
+        ~DescriptorPoolAllocatorImpl();
+        bool fits(const pool_entry_t& pool, const VkDescriptorPoolSize* counts, const uint32_t num_counts) const noexcept;
+        VkResult allocateFrom(const size_t pool_idx, const VkDescriptorSetLayout layout, const VkDescriptorPoolSize* counts, const uint32_t num_counts,
+            VkDescriptorSet* dest_set);
+        VkResult createPool(const VkDescriptorPoolSize* counts, const uint32_t num_counts);
+
+        VkDevice device{ VK_NULL_HANDLE };
+        uint32_t setsPerPool{ 0u };
+        VkDescriptorPoolCreateFlags createFlags{ 0u };
+        std::mutex mutex;
+        std::vector<pool_entry_t> pools;
+        size_t currentPool{ 0u };
+        // Lifetime totals of sets and descriptors allocated, used to size new pools to the mix of descriptors actually used
+        uint64_t observedSets{ 0u };
+        std::map<VkDescriptorType, uint64_t> observedCounts;
+        std::map<VkDescriptorType, uint32_t> hints;
+        // Only tracked for pools that can free sets individually, so their descriptors can be given back
+        std::unordered_map<VkDescriptorSet, allocated_set_t> allocatedSets;
+        DescriptorPoolAllocatorStats stats;
+    };
+
+    DescriptorPoolAllocatorImpl::DescriptorPoolAllocatorImpl(const VkDevice& _device, const uint32_t sets_per_pool, const VkDescriptorPoolCreateFlags create_flags) :
+        device(_device), setsPerPool(sets_per_pool), createFlags(create_flags) {}
+
+    DescriptorPoolAllocatorImpl::~DescriptorPoolAllocatorImpl()
+    {
+        for (auto& pool : pools)
+        {
+            vkDestroyDescriptorPool(device, pool.handle, nullptr);
+        }
+    }
+
+    bool DescriptorPoolAllocatorImpl::fits(const pool_entry_t& pool, const VkDescriptorPoolSize* counts, const uint32_t num_counts) const noexcept
+    {
+        if (pool.exhausted || pool.setsRemaining == 0u)
+        {
+            return false;
+        }
+
+        for (uint32_t i = 0u; i < num_counts; ++i)
+        {
+            auto iter = pool.remaining.find(counts[i].type);
+            if (iter == pool.remaining.end() || iter->second < counts[i].descriptorCount)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    VkResult DescriptorPoolAllocatorImpl::allocateFrom(const size_t pool_idx, const VkDescriptorSetLayout layout, const VkDescriptorPoolSize* counts,
+        const uint32_t num_counts, VkDescriptorSet* dest_set)
+    {
+        pool_entry_t& pool = pools[pool_idx];
+        VkDescriptorSetAllocateInfo alloc_info = vk_descriptor_set_alloc_info_base;
+        alloc_info.descriptorPool = pool.handle;
+        alloc_info.descriptorSetCount = 1u;
+        alloc_info.pSetLayouts = &layout;
+        VkResult result = vkAllocateDescriptorSets(device, &alloc_info, dest_set);
+        if (result != VK_SUCCESS)
+        {
+            return result;
+        }
+
+        --pool.setsRemaining;
+        for (uint32_t i = 0u; i < num_counts; ++i)
+        {
+            pool.remaining[counts[i].type] -= counts[i].descriptorCount;
+            observedCounts[counts[i].type] += counts[i].descriptorCount;
+        }
+        ++observedSets;
+        ++stats.SetsAllocated;
+
+        if (createFlags & VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT)
+        {
+            allocatedSets.emplace(*dest_set, allocated_set_t{ pool_idx, std::vector<VkDescriptorPoolSize>(counts, counts + num_counts) });
+        }
+
+        return VK_SUCCESS;
+    }
+
+    VkResult DescriptorPoolAllocatorImpl::createPool(const VkDescriptorPoolSize* counts, const uint32_t num_counts)
+    {
+        std::map<VkDescriptorType, uint32_t> capacity;
+        if (observedSets != 0u)
+        {
+            for (const auto& observed : observedCounts)
+            {
+                // Round up, so a type used by only a few sets still gets a descriptor or two
+                capacity[observed.first] = static_cast<uint32_t>((observed.second * setsPerPool + observedSets - 1u) / observedSets);
+            }
+        }
+        else
+        {
+            for (const auto& hint : hints)
+            {
+                capacity[hint.first] = hint.second * setsPerPool;
+            }
+            for (uint32_t i = 0u; i < num_counts; ++i)
+            {
+                capacity[counts[i].type] = std::max(capacity[counts[i].type], counts[i].descriptorCount * setsPerPool);
+            }
+        }
+
+        // Whatever the usage so far, the new pool must fit the set that asked for it
+        for (uint32_t i = 0u; i < num_counts; ++i)
+        {
+            capacity[counts[i].type] = std::max(capacity[counts[i].type], counts[i].descriptorCount);
+        }
+
+        std::vector<VkDescriptorPoolSize> pool_sizes;
+        for (const auto& entry : capacity)
+        {
+            if (entry.second != 0u)
+            {
+                pool_sizes.emplace_back(VkDescriptorPoolSize{ entry.first, entry.second });
+            }
+        }
+
+        VkDescriptorPoolCreateInfo create_info = vk_descriptor_pool_create_info_base;
+        create_info.flags = createFlags;
+        create_info.maxSets = setsPerPool;
+        create_info.poolSizeCount = static_cast<uint32_t>(pool_sizes.size());
+        create_info.pPoolSizes = pool_sizes.data();
+
+        pool_entry_t pool;
+        VkResult result = vkCreateDescriptorPool(device, &create_info, nullptr, &pool.handle);
+        if (result != VK_SUCCESS)
+        {
+            return result;
+        }
+
+        pool.setsRemaining = setsPerPool;
+        pool.capacity = capacity;
+        pool.remaining = std::move(capacity);
+        pools.emplace_back(std::move(pool));
+        ++stats.NumPools;
+        LOG_IF(VERBOSE_LOGGING, INFO) << "DescriptorPoolAllocator created pool " << pools.size() << " with " << pool_sizes.size() << " descriptor types.";
+        return VK_SUCCESS;
+    }
+
+    DescriptorPoolAllocator::DescriptorPoolAllocator(const VkDevice& device, const uint32_t sets_per_pool, const VkDescriptorPoolCreateFlags create_flags) :
+        impl(std::make_unique<DescriptorPoolAllocatorImpl>(device, sets_per_pool, create_flags)) {}
+
+    DescriptorPoolAllocator::~DescriptorPoolAllocator() {}
+
+    DescriptorPoolAllocator::DescriptorPoolAllocator(DescriptorPoolAllocator&& other) noexcept : impl(std::move(other.impl)) {}
+
+    DescriptorPoolAllocator& DescriptorPoolAllocator::operator=(DescriptorPoolAllocator&& other) noexcept
+    {
+        impl = std::move(other.impl);
+        return *this;
+    }
+
+    void DescriptorPoolAllocator::AddResourceType(const VkDescriptorType descriptor_type, const uint32_t count_per_set)
+    {
+        std::lock_guard<std::mutex> lock(impl->mutex);
+        impl->hints[descriptor_type] += count_per_set;
+    }
+
+    VkResult DescriptorPoolAllocator::Allocate(const VkDescriptorSetLayout set_layout, const VkDescriptorPoolSize* descriptor_counts, const uint32_t num_descriptor_counts,
+        VkDescriptorSet* dest_set, VkDescriptorPool* dest_pool)
+    {
+        std::lock_guard<std::mutex> lock(impl->mutex);
+        const size_t num_pools = impl->pools.size();
+        for (size_t i = 0u; i < num_pools; ++i)
+        {
+            const size_t pool_idx = (impl->currentPool + i) % num_pools;
+            if (!impl->fits(impl->pools[pool_idx], descriptor_counts, num_descriptor_counts))
+            {
+                continue;
+            }
+
+            VkResult result = impl->allocateFrom(pool_idx, set_layout, descriptor_counts, num_descriptor_counts, dest_set);
+            if (result == VK_SUCCESS)
+            {
+                impl->currentPool = pool_idx;
+                *dest_pool = impl->pools[pool_idx].handle;
+                return VK_SUCCESS;
+            }
+            else if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL)
+            {
+                // Our own accounting said it fits, but the driver disagrees: don't try this pool again until it's reset or has sets freed
+                impl->pools[pool_idx].exhausted = true;
+            }
+            else
+            {
+                return result;
+            }
+        }
+
+        if (num_pools != 0u)
+        {
+            ++impl->stats.PoolExhaustions;
+        }
+
+        VkResult result = impl->createPool(descriptor_counts, num_descriptor_counts);
+        if (result != VK_SUCCESS)
+        {
+            return result;
+        }
+
+        impl->currentPool = impl->pools.size() - 1u;
+        result = impl->allocateFrom(impl->currentPool, set_layout, descriptor_counts, num_descriptor_counts, dest_set);
+        if (result == VK_SUCCESS)
+        {
+            *dest_pool = impl->pools.back().handle;
+        }
+        return result;
+    }
+
+    VkDescriptorSet DescriptorPoolAllocator::Allocate(const DescriptorSetLayout& set_layout, VkDescriptorPool* dest_pool)
+    {
+        uint32_t num_counts = 0u;
+        set_layout.GetPoolSizes(&num_counts, nullptr);
+        std::vector<VkDescriptorPoolSize> counts(num_counts);
+        set_layout.GetPoolSizes(&num_counts, counts.data());
+
+        VkDescriptorSet result_set{ VK_NULL_HANDLE };
+        VkResult result = Allocate(set_layout.vkHandle(), counts.data(), num_counts, &result_set, dest_pool);
+        VkAssert(result);
+        return result_set;
+    }
+
+    void DescriptorPoolAllocator::Free(const VkDescriptorPool pool, const VkDescriptorSet descriptor_set)
+    {
+        if (!(impl->createFlags & VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT))
+        {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(impl->mutex);
+        VkResult result = vkFreeDescriptorSets(impl->device, pool, 1, &descriptor_set);
+        VkAssert(result);
+
+        auto iter = impl->allocatedSets.find(descriptor_set);
+        if (iter == impl->allocatedSets.end())
+        {
+            return;
+        }
+
+        pool_entry_t& entry = impl->pools[iter->second.poolIdx];
+        assert(entry.handle == pool);
+        ++entry.setsRemaining;
+        for (const auto& count : iter->second.counts)
+        {
+            entry.remaining[count.type] += count.descriptorCount;
+        }
+        entry.exhausted = false;
+        --impl->stats.SetsAllocated;
+        impl->allocatedSets.erase(iter);
+    }
+
+    void DescriptorPoolAllocator::Reset()
+    {
+        std::lock_guard<std::mutex> lock(impl->mutex);
+        for (auto& pool : impl->pools)
+        {
+            // Pools left untouched since the last reset needn't be reset again: common for per-frame pools, sized for the busiest frame
+            if (pool.setsRemaining == impl->setsPerPool && !pool.exhausted)
+            {
+                continue;
+            }
+            VkResult result = vkResetDescriptorPool(impl->device, pool.handle, 0);
+            VkAssert(result);
+            pool.setsRemaining = impl->setsPerPool;
+            pool.remaining = pool.capacity;
+            pool.exhausted = false;
+        }
+        impl->allocatedSets.clear();
+        impl->currentPool = 0u;
+        impl->stats.SetsAllocated = 0u;
+    }
+
+    VkDescriptorPoolCreateFlags DescriptorPoolAllocator::CreateFlags() const noexcept
+    {
+        return impl->createFlags;
+    }
+
+    DescriptorPoolAllocatorStats DescriptorPoolAllocator::Stats() const
+    {
+        std::lock_guard<std::mutex> lock(impl->mutex);
+        return impl->stats;
+    }
+
+}
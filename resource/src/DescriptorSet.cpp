@@ -1,31 +1,232 @@
 #include "DescriptorSet.hpp"
+#include "DescriptorPoolAllocator.hpp"
+#include "DescriptorSetLayout.hpp"
+#include "DescriptorUpdateTemplate.hpp"
 #include "vkAssert.hpp"
 #include "CreateInfoBase.hpp"
 #include <vector>
-#include <map>
+#include <array>
+#include <algorithm>
 
 namespace vpr
 {
 
+    /**Contiguous array storing its first InlineCapacity elements within itself, only allocating once it grows beyond that. Never shrinks: once
+     * sized for a layout, further use doesn't allocate.
+     */
+    template<typename T, size_t InlineCapacity>
+    class flat_storage
+    {
+    public:
+
+        void resize(const size_t new_size)
+        {
+            if (new_size <= count)
+            {
+                return;
+            }
+
+            if (new_size > capacity())
+            {
+                std::unique_ptr<T[]> new_elements = std::make_unique<T[]>(new_size);
+                std::copy(data(), data() + count, new_elements.get());
+                heapElements = std::move(new_elements);
+                heapCapacity = new_size;
+            }
+
+            std::fill(data() + count, data() + new_size, T{});
+            count = new_size;
+        }
+
+        void clear() noexcept
+        {
+            std::fill(data(), data() + count, T{});
+        }
+
+        T* data() noexcept { return heapElements ? heapElements.get() : inlineElements.data(); }
+        const T* data() const noexcept { return heapElements ? heapElements.get() : inlineElements.data(); }
+        T& operator[](const size_t idx) noexcept { return data()[idx]; }
+        const T& operator[](const size_t idx) const noexcept { return data()[idx]; }
+        size_t size() const noexcept { return count; }
+        size_t capacity() const noexcept { return heapElements ? heapCapacity : InlineCapacity; }
+
+    private:
+        std::array<T, InlineCapacity> inlineElements{};
+        std::unique_ptr<T[]> heapElements{ nullptr };
+        size_t heapCapacity{ 0u };
+        size_t count{ 0u };
+    };
+
+    enum class binding_kind : uint8_t
+    {
+        Unused = 0,
+        Image = 1,
+        Buffer = 2,
+        TexelBuffer = 3
+    };
+
+    // Indexed by binding number: one descriptor per binding, so the write for a binding is built straight from its slot
+    struct binding_slot_t
+    {
+        union
+        {
+            VkDescriptorImageInfo imageInfo;
+            VkDescriptorBufferInfo bufferInfo;
+        };
+        VkBufferView bufferView;
+        VkDescriptorType type;
+        binding_kind kind;
+        // Changed since the set was last updated
+        bool dirty;
+        binding_slot_t() noexcept : bufferInfo{ VK_NULL_HANDLE, 0u, 0u }, bufferView(VK_NULL_HANDLE), type(VK_DESCRIPTOR_TYPE_MAX_ENUM), kind(binding_kind::Unused),
+            dirty(false) {}
+        bool sameDescriptor(const binding_slot_t& other) const noexcept;
+    };
+
+    bool binding_slot_t::sameDescriptor(const binding_slot_t& other) const noexcept
+    {
+        if (kind != other.kind || type != other.type)
+        {
+            return false;
+        }
+
+        switch (kind)
+        {
+        case binding_kind::Image:
+            return imageInfo.sampler == other.imageInfo.sampler && imageInfo.imageView == other.imageInfo.imageView && imageInfo.imageLayout == other.imageInfo.imageLayout;
+        case binding_kind::TexelBuffer:
+            if (bufferView != other.bufferView)
+            {
+                return false;
+            }
+            // fallthrough
+        case binding_kind::Buffer:
+            return bufferInfo.buffer == other.bufferInfo.buffer && bufferInfo.offset == other.bufferInfo.offset && bufferInfo.range == other.bufferInfo.range;
+        default:
+            return true;
+        }
+    }
+
+    // Most sets have only a handful of bindings: this keeps them within the impl, without a separate allocation
+    constexpr static size_t inline_binding_count = 4u;
+    // Writes are built on the stack for sets up to this size
+    constexpr static size_t max_stack_writes = 16u;
+
     struct DescriptorSetImpl
     {
         DescriptorSetImpl() = default;
         ~DescriptorSetImpl() = default;
+        void assign(const size_t binding, const binding_slot_t& value);
+        void reserve(const DescriptorSetLayout& layout);
+        void markAllDirty() noexcept;
+        uint32_t buildDirtyWrites(const VkDescriptorSet set, VkWriteDescriptorSet* writes) noexcept;
+
         VkDescriptorPool pool{ VK_NULL_HANDLE };
         VkDescriptorSetLayout setLayout{ VK_NULL_HANDLE };
+        DescriptorPoolAllocator* poolAllocator{ nullptr };
+        const DescriptorSetLayout* layout{ nullptr };
         bool updated{ false };
         bool allocated{ false };
-        std::map<size_t, VkWriteDescriptorSet> writeDescriptors;
-        std::map<size_t, VkDescriptorBufferInfo> bufferInfos;
-        std::map<size_t, VkDescriptorImageInfo> imageInfos;
-        std::map<size_t, VkBufferView> bufferViews;
+        uint32_t numUsed{ 0u };
+        uint32_t numDirty{ 0u };
+        flat_storage<binding_slot_t, inline_binding_count> bindings;
     };
 
+    void DescriptorSetImpl::assign(const size_t binding, const binding_slot_t& value)
+    {
+        bindings.resize(binding + 1u);
+        binding_slot_t& slot = bindings[binding];
+        // Re-adding the descriptor a binding already has doesn't need a write
+        if (slot.sameDescriptor(value))
+        {
+            return;
+        }
+
+        if (slot.kind == binding_kind::Unused)
+        {
+            ++numUsed;
+        }
+        const bool was_dirty = slot.dirty;
+        slot = value;
+        slot.dirty = true;
+        if (!was_dirty)
+        {
+            ++numDirty;
+        }
+        updated = false;
+    }
+
+    void DescriptorSetImpl::markAllDirty() noexcept
+    {
+        for (size_t i = 0u; i < bindings.size(); ++i)
+        {
+            bindings[i].dirty = bindings[i].kind != binding_kind::Unused;
+        }
+        numDirty = numUsed;
+        updated = numDirty == 0u;
+    }
+
+    void DescriptorSetImpl::reserve(const DescriptorSetLayout& set_layout)
+    {
+        uint32_t num_bindings = 0u;
+        set_layout.GetBindings(&num_bindings, nullptr);
+        std::vector<VkDescriptorSetLayoutBinding> layout_bindings(num_bindings);
+        set_layout.GetBindings(&num_bindings, layout_bindings.data());
+        if (!layout_bindings.empty())
+        {
+            // Bindings are returned in order, so the last has the highest index
+            bindings.resize(static_cast<size_t>(layout_bindings.back().binding) + 1u);
+        }
+    }
+
+    uint32_t DescriptorSetImpl::buildDirtyWrites(const VkDescriptorSet set, VkWriteDescriptorSet* writes) noexcept
+    {
+        uint32_t num_writes = 0u;
+        for (size_t i = 0u; i < bindings.size() && num_writes < numDirty; ++i)
+        {
+            binding_slot_t& binding = bindings[i];
+            if (!binding.dirty)
+            {
+                continue;
+            }
+
+            binding.dirty = false;
+
+            VkWriteDescriptorSet& write = writes[num_writes++];
+            write = VkWriteDescriptorSet{ VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, nullptr, set, static_cast<uint32_t>(i), 0, 1, binding.type, nullptr, nullptr, nullptr };
+            switch (binding.kind)
+            {
+            case binding_kind::Image:
+                write.pImageInfo = &binding.imageInfo;
+                break;
+            case binding_kind::TexelBuffer:
+                write.pTexelBufferView = &binding.bufferView;
+                write.pBufferInfo = &binding.bufferInfo;
+                break;
+            default:
+                write.pBufferInfo = &binding.bufferInfo;
+                break;
+            }
+        }
+        numDirty = 0u;
+        updated = true;
+        return num_writes;
+    }
+
     DescriptorSet::DescriptorSet(const VkDevice& parent) : device(parent), handle(VK_NULL_HANDLE), impl(std::make_unique<DescriptorSetImpl>()) { }
 
+    DescriptorSet::DescriptorSet(const VkDevice& parent, const DescriptorSetLayout& layout) : device(parent), handle(VK_NULL_HANDLE), impl(std::make_unique<DescriptorSetImpl>())
+    {
+        impl->reserve(layout);
+    }
+
     DescriptorSet::~DescriptorSet()
     {
-        if (handle != VK_NULL_HANDLE)
+        if (handle != VK_NULL_HANDLE && impl->poolAllocator != nullptr)
+        {
+            impl->poolAllocator->Free(impl->pool, handle);
+        }
+        else if (handle != VK_NULL_HANDLE)
         {
             vkFreeDescriptorSets(device, impl->pool, 1, &handle);
         }
@@ -33,7 +234,7 @@ namespace vpr
 
     DescriptorSet::DescriptorSet(DescriptorSet&& other) noexcept : device(std::move(other.device)), handle(std::move(other.handle)),
         impl(std::move(other.impl))
-    { 
+    {
         other.handle = VK_NULL_HANDLE;
     }
 
@@ -48,95 +249,76 @@ namespace vpr
 
     void DescriptorSet::AddDescriptorInfo(VkDescriptorImageInfo info, const VkDescriptorType type, const size_t item_binding_idx)
     {
-        impl->imageInfos.emplace(item_binding_idx, std::move(info));
-        impl->writeDescriptors.emplace(item_binding_idx,
-            VkWriteDescriptorSet
-            {
-                VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-                nullptr,
-                handle,
-                static_cast<uint32_t>(item_binding_idx),
-                0,
-                1,
-                type,
-                &impl->imageInfos.at(item_binding_idx),
-                nullptr,
-                nullptr,
-            }
-        );
-
+        binding_slot_t binding;
+        binding.imageInfo = info;
+        binding.type = type;
+        binding.kind = binding_kind::Image;
+        impl->assign(item_binding_idx, binding);
     }
 
     void DescriptorSet::AddDescriptorInfo(VkDescriptorBufferInfo info, const VkDescriptorType descr_type, const size_t item_binding_idx)
     {
-        impl->bufferInfos.emplace(item_binding_idx, std::move(info));
-        impl->writeDescriptors.emplace(item_binding_idx,
-            VkWriteDescriptorSet
-            {
-                VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-                nullptr,
-                handle,
-                static_cast<uint32_t>(item_binding_idx),
-                0,
-                1,
-                descr_type,
-                nullptr,
-                &impl->bufferInfos.at(item_binding_idx),
-                nullptr,
-            }
-        );
+        binding_slot_t binding;
+        binding.bufferInfo = info;
+        binding.type = descr_type;
+        binding.kind = binding_kind::Buffer;
+        impl->assign(item_binding_idx, binding);
     }
 
     void DescriptorSet::AddDescriptorInfo(VkDescriptorBufferInfo info, const VkBufferView view, const VkDescriptorType type, const size_t idx)
     {
-        impl->bufferInfos.emplace(idx, std::move(info));
-        impl->bufferViews.emplace(idx, view);
-        impl->writeDescriptors.emplace(idx,
-            VkWriteDescriptorSet
-            {
-                VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-                nullptr,
-                handle,
-                static_cast<uint32_t>(idx),
-                0,
-                1,
-                type,
-                nullptr,
-                &impl->bufferInfos.at(idx),
-                &impl->bufferViews.at(idx)
-            }
-        );
+        binding_slot_t binding;
+        binding.bufferInfo = info;
+        binding.bufferView = view;
+        binding.type = type;
+        binding.kind = binding_kind::TexelBuffer;
+        impl->assign(idx, binding);
     }
 
     void DescriptorSet::AddSamplerBinding(const size_t idx, const VkSampler sampler_handle)
     {
-        impl->imageInfos.emplace(idx, VkDescriptorImageInfo{ sampler_handle, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_UNDEFINED });
-        impl->writeDescriptors.emplace(idx,
-            VkWriteDescriptorSet
-            {
-            VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-            nullptr,
-            handle, 
-            static_cast<uint32_t>(idx),
-            0,
-            1,
-            VK_DESCRIPTOR_TYPE_SAMPLER,
-            &impl->imageInfos.at(idx),
-            nullptr,
-            nullptr
-            }
-        );
+        binding_slot_t binding;
+        binding.imageInfo = VkDescriptorImageInfo{ sampler_handle, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_UNDEFINED };
+        binding.type = VK_DESCRIPTOR_TYPE_SAMPLER;
+        binding.kind = binding_kind::Image;
+        impl->assign(idx, binding);
     }
 
     void DescriptorSet::Init(const VkDescriptorPool& parent_pool, const VkDescriptorSetLayout& set_layout)
     {
         allocate(parent_pool, set_layout);
-        update();
+        // Sets updated through a template have no descriptor infos of their own
+        if (impl->numUsed != 0u)
+        {
+            update();
+        }
+    }
+
+    void DescriptorSet::Init(DescriptorPoolAllocator* pool_allocator, const DescriptorSetLayout& set_layout)
+    {
+        impl->poolAllocator = pool_allocator;
+        impl->layout = &set_layout;
+        impl->reserve(set_layout);
+        allocate(VK_NULL_HANDLE, set_layout.vkHandle());
+        if (impl->numUsed != 0u)
+        {
+            update();
+        }
     }
 
     void DescriptorSet::allocate(const VkDescriptorPool& parent_pool, const VkDescriptorSetLayout& set_layout) const
     {
-        
+
+        if (impl->poolAllocator != nullptr)
+        {
+            impl->setLayout = set_layout;
+            handle = impl->poolAllocator->Allocate(*impl->layout, &impl->pool);
+            impl->allocated = true;
+            // A freshly allocated set has nothing written to it yet
+            impl->markAllDirty();
+            return;
+        }
+
         impl->pool = parent_pool;
         impl->setLayout = set_layout;
 
@@ -148,6 +330,7 @@ namespace vpr
         VkResult result = vkAllocateDescriptorSets(device, &alloc_info, &handle);
         VkAssert(result);
         impl->allocated = true;
+        impl->markAllDirty();
 
     }
 
@@ -156,35 +339,60 @@ namespace vpr
         update();
     }
 
-    void DescriptorSet::update() const
+    void DescriptorSet::Update(const DescriptorUpdateTemplate& update_template, const void* data) const
     {
+        assert(impl->allocated);
+        update_template.UpdateSet(handle, data);
+        // The set now holds whatever the template wrote: forget the descriptors added individually, so re-adding one of them after this
+        // isn't mistaken for a no-op, and pending changes to them were overwritten anyway
+        impl->bindings.clear();
+        impl->numUsed = 0u;
+        impl->numDirty = 0u;
+        impl->updated = true;
+    }
 
-        assert(impl->pool && impl->allocated && !impl->writeDescriptors.empty());
+    void DescriptorSet::update() const
+    {
 
-        std::vector<VkWriteDescriptorSet> write_descriptors;
+        assert(impl->pool && impl->allocated && impl->numUsed != 0u);
 
-        for (const auto& entry : impl->writeDescriptors)
+        // Only bindings changed since the last update are written
+        if (impl->numDirty == 0u)
         {
-            write_descriptors.emplace_back(entry.second);
-            write_descriptors.back().dstSet = handle;
-            if (entry.second.pBufferInfo != nullptr)
-            {
-                write_descriptors.back().pBufferInfo = entry.second.pBufferInfo;
-            }
-            if (entry.second.pImageInfo != nullptr)
-            {
-                write_descriptors.back().pImageInfo = entry.second.pImageInfo;
-            }
-            if (entry.second.pTexelBufferView != nullptr)
-            {
-                write_descriptors.back().pTexelBufferView = entry.second.pTexelBufferView;
-            }
+            impl->updated = true;
+        }
+        else if (impl->numDirty <= max_stack_writes)
+        {
+            std::array<VkWriteDescriptorSet, max_stack_writes> write_descriptors;
+            const uint32_t num_writes = impl->buildDirtyWrites(handle, write_descriptors.data());
+            vkUpdateDescriptorSets(device, num_writes, write_descriptors.data(), 0, nullptr);
+        }
+        else
+        {
+            std::vector<VkWriteDescriptorSet> write_descriptors(impl->numDirty);
+            const uint32_t num_writes = impl->buildDirtyWrites(handle, write_descriptors.data());
+            vkUpdateDescriptorSets(device, num_writes, write_descriptors.data(), 0, nullptr);
         }
 
-        vkUpdateDescriptorSets(device, static_cast<uint32_t>(write_descriptors.size()), write_descriptors.data(), 0, nullptr);
+    }
 
-        impl->updated = true;
-        
+    uint32_t DescriptorSet::NumDirtyBindings() const noexcept
+    {
+        return impl->numDirty;
+    }
+
+    uint32_t DescriptorSet::gatherDirtyWrites(std::vector<VkWriteDescriptorSet>& writes) const
+    {
+        if (!impl->allocated)
+        {
+            allocate(impl->pool, impl->setLayout);
+        }
+
+        const size_t first_write = writes.size();
+        writes.resize(first_write + impl->numDirty);
+        const uint32_t num_writes = impl->buildDirtyWrites(handle, writes.data() + first_write);
+        writes.resize(first_write + num_writes);
+        return num_writes;
     }
 
     const VkDescriptorSet& DescriptorSet::vkHandle() const noexcept
@@ -199,15 +407,15 @@ namespace vpr
         }
         return handle;
     }
-    
+
     void DescriptorSet::Reset()
     {
-        VkDescriptorPool pool = impl->pool;
-        VkDescriptorSetLayout layout = impl->setLayout;
-        impl.reset();
-        impl = std::make_unique<DescriptorSetImpl>();
-        impl->pool = pool;
-        impl->setLayout = layout;
+        // Keeps binding storage around, so re-adding descriptors doesn't allocate
+        impl->bindings.clear();
+        impl->numUsed = 0u;
+        impl->numDirty = 0u;
+        impl->updated = false;
+        impl->allocated = false;
     }
 
 }
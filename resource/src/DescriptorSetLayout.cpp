@@ -77,6 +77,52 @@ namespace vpr
         data->bindingFlags[binding] = flags;
     }
 
+    void DescriptorSetLayout::GetPoolSizes(uint32_t* num_pool_sizes, VkDescriptorPoolSize* pool_sizes) const noexcept
+    {
+        std::map<VkDescriptorType, uint32_t> counts;
+        for (const auto& entry : data->bindings)
+        {
+            counts[entry.second.descriptorType] += entry.second.descriptorCount;
+        }
+
+        if (pool_sizes == nullptr)
+        {
+            *num_pool_sizes = static_cast<uint32_t>(counts.size());
+            return;
+        }
+
+        uint32_t idx = 0u;
+        for (const auto& count : counts)
+        {
+            if (idx == *num_pool_sizes)
+            {
+                break;
+            }
+            pool_sizes[idx++] = VkDescriptorPoolSize{ count.first, count.second };
+        }
+        *num_pool_sizes = idx;
+    }
+
+    void DescriptorSetLayout::GetBindings(uint32_t* num_bindings, VkDescriptorSetLayoutBinding* bindings) const noexcept
+    {
+        if (bindings == nullptr)
+        {
+            *num_bindings = static_cast<uint32_t>(data->bindings.size());
+            return;
+        }
+
+        uint32_t idx = 0u;
+        for (const auto& entry : data->bindings)
+        {
+            if (idx == *num_bindings)
+            {
+                break;
+            }
+            bindings[idx++] = entry.second;
+        }
+        *num_bindings = idx;
+    }
+
     const VkDescriptorSetLayout& DescriptorSetLayout::vkHandle() const noexcept
     {
         if(!ready)
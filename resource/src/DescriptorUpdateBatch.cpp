@@ -0,0 +1,59 @@
+#include "vpr_stdafx.h"
+#include "DescriptorUpdateBatch.hpp"
+#include "DescriptorSet.hpp"
+#include <vector>
+
+namespace vpr
+{
+
+    struct DescriptorUpdateBatchImpl
+    {
+        VkDevice device{ VK_NULL_HANDLE };
+        std::vector<const DescriptorSet*> sets;
+        std::vector<VkWriteDescriptorSet> writes;
+    };
+
+    DescriptorUpdateBatch::DescriptorUpdateBatch(const VkDevice& device) : impl(std::make_unique<DescriptorUpdateBatchImpl>())
+    {
+        impl->device = device;
+    }
+
+    DescriptorUpdateBatch::~DescriptorUpdateBatch() {}
+
+    DescriptorUpdateBatch::DescriptorUpdateBatch(DescriptorUpdateBatch&& other) noexcept : impl(std::move(other.impl)) {}
+
+    DescriptorUpdateBatch& DescriptorUpdateBatch::operator=(DescriptorUpdateBatch&& other) noexcept
+    {
+        impl = std::move(other.impl);
+        return *this;
+    }
+
+    void DescriptorUpdateBatch::Add(const DescriptorSet* descriptor_set)
+    {
+        impl->sets.emplace_back(descriptor_set);
+    }
+
+    uint32_t DescriptorUpdateBatch::Flush()
+    {
+        // Writes are gathered only now, as they point into each set's binding storage: which may move if the set gains bindings after Add()
+        impl->writes.clear();
+        for (const DescriptorSet* set : impl->sets)
+        {
+            set->gatherDirtyWrites(impl->writes);
+        }
+        impl->sets.clear();
+
+        if (!impl->writes.empty())
+        {
+            vkUpdateDescriptorSets(impl->device, static_cast<uint32_t>(impl->writes.size()), impl->writes.data(), 0, nullptr);
+        }
+
+        return static_cast<uint32_t>(impl->writes.size());
+    }
+
+    size_t DescriptorUpdateBatch::NumPendingSets() const noexcept
+    {
+        return impl->sets.size();
+    }
+
+}
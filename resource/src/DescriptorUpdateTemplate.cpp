@@ -0,0 +1,151 @@
+#include "vpr_stdafx.h"
+#include "DescriptorUpdateTemplate.hpp"
+#include "DescriptorSetLayout.hpp"
+#include "LogicalDevice.hpp"
+#include "Instance.hpp"
+#include "vkAssert.hpp"
+#include "CreateInfoBase.hpp"
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+namespace vpr
+{
+
+    struct DescriptorUpdateTemplateImpl
+    {
+        DescriptorUpdateTemplateImpl(const Device* device, const DescriptorSetLayout& set_layout, std::vector<VkDescriptorUpdateTemplateEntry> entries);
+        ~DescriptorUpdateTemplateImpl();
+
+        VkDevice device{ VK_NULL_HANDLE };
+        VkDescriptorUpdateTemplate handle{ VK_NULL_HANDLE };
+        PFN_vkCreateDescriptorUpdateTemplateKHR createTemplate{ nullptr };
+        PFN_vkDestroyDescriptorUpdateTemplateKHR destroyTemplate{ nullptr };
+        PFN_vkUpdateDescriptorSetWithTemplateKHR updateWithTemplate{ nullptr };
+        std::vector<VkDescriptorUpdateTemplateEntry> entries;
+        size_t dataSize{ 0u };
+    };
+
+    DescriptorUpdateTemplateImpl::DescriptorUpdateTemplateImpl(const Device* parent, const DescriptorSetLayout& set_layout, std::vector<VkDescriptorUpdateTemplateEntry> _entries) :
+        device(parent->vkHandle()), entries(std::move(_entries))
+    {
+        if (parent->ParentInstance()->ApplicationInfo().apiVersion >= VK_API_VERSION_1_1)
+        {
+            createTemplate = vkCreateDescriptorUpdateTemplate;
+            destroyTemplate = vkDestroyDescriptorUpdateTemplate;
+            updateWithTemplate = vkUpdateDescriptorSetWithTemplate;
+        }
+        else if (parent->HasExtension(VK_KHR_DESCRIPTOR_UPDATE_TEMPLATE_EXTENSION_NAME))
+        {
+            createTemplate = reinterpret_cast<PFN_vkCreateDescriptorUpdateTemplateKHR>(vkGetDeviceProcAddr(device, "vkCreateDescriptorUpdateTemplateKHR"));
+            destroyTemplate = reinterpret_cast<PFN_vkDestroyDescriptorUpdateTemplateKHR>(vkGetDeviceProcAddr(device, "vkDestroyDescriptorUpdateTemplateKHR"));
+            updateWithTemplate = reinterpret_cast<PFN_vkUpdateDescriptorSetWithTemplateKHR>(vkGetDeviceProcAddr(device, "vkUpdateDescriptorSetWithTemplateKHR"));
+        }
+
+        if (createTemplate == nullptr || destroyTemplate == nullptr || updateWithTemplate == nullptr)
+        {
+            throw std::runtime_error("Descriptor update templates require Vulkan 1.1 or VK_KHR_descriptor_update_template!");
+        }
+
+        for (const auto& entry : entries)
+        {
+            const size_t stride = entry.stride != 0u ? entry.stride : DescriptorUpdateTemplate::DescriptorInfoSize(entry.descriptorType);
+            dataSize = std::max(dataSize, entry.offset + stride * entry.descriptorCount);
+        }
+
+        VkDescriptorUpdateTemplateCreateInfo create_info = vk_descriptor_update_template_create_info_base;
+        create_info.descriptorUpdateEntryCount = static_cast<uint32_t>(entries.size());
+        create_info.pDescriptorUpdateEntries = entries.data();
+        create_info.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;
+        create_info.descriptorSetLayout = set_layout.vkHandle();
+        VkResult result = createTemplate(device, &create_info, nullptr, &handle);
+        VkAssert(result);
+    }
+
+    DescriptorUpdateTemplateImpl::~DescriptorUpdateTemplateImpl()
+    {
+        if (handle != VK_NULL_HANDLE)
+        {
+            destroyTemplate(device, handle, nullptr);
+        }
+    }
+
+    static std::vector<VkDescriptorUpdateTemplateEntry> packed_entries(const DescriptorSetLayout& set_layout)
+    {
+        uint32_t num_bindings = 0u;
+        set_layout.GetBindings(&num_bindings, nullptr);
+        std::vector<VkDescriptorSetLayoutBinding> bindings(num_bindings);
+        set_layout.GetBindings(&num_bindings, bindings.data());
+
+        std::vector<VkDescriptorUpdateTemplateEntry> result;
+        size_t offset = 0u;
+        for (const auto& binding : bindings)
+        {
+            const size_t stride = DescriptorUpdateTemplate::DescriptorInfoSize(binding.descriptorType);
+            // Sampler bindings with immutable samplers can't be written, but still take up space so offsets stay predictable
+            if (!(binding.descriptorType == VK_DESCRIPTOR_TYPE_SAMPLER && binding.pImmutableSamplers != nullptr) && binding.descriptorCount != 0u)
+            {
+                result.emplace_back(VkDescriptorUpdateTemplateEntry{ binding.binding, 0u, binding.descriptorCount, binding.descriptorType, offset, stride });
+            }
+            offset += stride * binding.descriptorCount;
+        }
+
+        return result;
+    }
+
+    DescriptorUpdateTemplate::DescriptorUpdateTemplate(const Device* device, const DescriptorSetLayout& set_layout) :
+        impl(std::make_unique<DescriptorUpdateTemplateImpl>(device, set_layout, packed_entries(set_layout))) {}
+
+    DescriptorUpdateTemplate::DescriptorUpdateTemplate(const Device* device, const DescriptorSetLayout& set_layout, const VkDescriptorUpdateTemplateEntry* entries, const uint32_t num_entries) :
+        impl(std::make_unique<DescriptorUpdateTemplateImpl>(device, set_layout, std::vector<VkDescriptorUpdateTemplateEntry>(entries, entries + num_entries))) {}
+
+    DescriptorUpdateTemplate::~DescriptorUpdateTemplate() {}
+
+    DescriptorUpdateTemplate::DescriptorUpdateTemplate(DescriptorUpdateTemplate&& other) noexcept : impl(std::move(other.impl)) {}
+
+    DescriptorUpdateTemplate& DescriptorUpdateTemplate::operator=(DescriptorUpdateTemplate&& other) noexcept
+    {
+        impl = std::move(other.impl);
+        return *this;
+    }
+
+    void DescriptorUpdateTemplate::UpdateSet(const VkDescriptorSet descriptor_set, const void* data) const
+    {
+        impl->updateWithTemplate(impl->device, descriptor_set, impl->handle, data);
+    }
+
+    size_t DescriptorUpdateTemplate::Offset(const uint32_t binding) const noexcept
+    {
+        auto iter = std::find_if(impl->entries.cbegin(), impl->entries.cend(), [binding](const VkDescriptorUpdateTemplateEntry& entry) { return entry.dstBinding == binding; });
+        return iter != impl->entries.cend() ? iter->offset : impl->dataSize;
+    }
+
+    size_t DescriptorUpdateTemplate::DataSize() const noexcept
+    {
+        return impl->dataSize;
+    }
+
+    const VkDescriptorUpdateTemplate& DescriptorUpdateTemplate::vkHandle() const noexcept
+    {
+        return impl->handle;
+    }
+
+    size_t DescriptorUpdateTemplate::DescriptorInfoSize(const VkDescriptorType type) noexcept
+    {
+        switch (type)
+        {
+        case VK_DESCRIPTOR_TYPE_SAMPLER:
+        case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+        case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+        case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+        case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
+            return sizeof(VkDescriptorImageInfo);
+        case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
+        case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
+            return sizeof(VkBufferView);
+        default:
+            return sizeof(VkDescriptorBufferInfo);
+        }
+    }
+
+}
@@ -0,0 +1,128 @@
+#include "vpr_stdafx.h"
+#include "DynamicUniformBuffer.hpp"
+#include "Buffer.hpp"
+#include "Allocator.hpp"
+#include "AllocationRequirements.hpp"
+#include "LogicalDevice.hpp"
+#include "CreateInfoBase.hpp"
+#include "easylogging++.h"
+#include <atomic>
+#include <algorithm>
+#include <limits>
+#include <cassert>
+
+namespace vpr
+{
+
+    struct DynamicUniformBufferImpl
+    {
+        DynamicUniformBufferImpl(Allocator* allocator, const VkDeviceSize size_per_frame, const uint32_t frames_in_flight);
+
+        std::unique_ptr<Buffer> buffer;
+        char* mappedData{ nullptr };
+        VkDeviceSize alignment{ 1u };
+        VkDeviceSize frameSize{ 0u };
+        uint32_t numFrames{ 0u };
+        VkDeviceSize frameBase{ 0u };
+        std::atomic<VkDeviceSize> frameOffset{ 0u };
+    };
+
+    DynamicUniformBufferImpl::DynamicUniformBufferImpl(Allocator* allocator, const VkDeviceSize size_per_frame, const uint32_t frames_in_flight) :
+        numFrames(frames_in_flight)
+    {
+        assert(frames_in_flight > 0u);
+        alignment = std::max(allocator->ParentDevice()->GetPhysicalDeviceProperties().limits.minUniformBufferOffsetAlignment, VkDeviceSize(1u));
+        // Frame regions must start on an aligned offset too, as dynamic offsets are relative to the start of the buffer
+        frameSize = (size_per_frame + alignment - 1u) / alignment * alignment;
+
+        VkBufferCreateInfo create_info = vk_buffer_create_info_base;
+        create_info.size = frameSize * frames_in_flight;
+        create_info.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+        AllocationRequirements alloc_reqs;
+        alloc_reqs.Usage = memory_usage::CpuToGpu;
+        alloc_reqs.PersistentlyMapped = true;
+        buffer = std::make_unique<Buffer>(allocator, create_info, alloc_reqs);
+        mappedData = reinterpret_cast<char*>(buffer->MappedData());
+    }
+
+    DynamicUniformBuffer::DynamicUniformBuffer(Allocator* allocator, const VkDeviceSize size_per_frame, const uint32_t frames_in_flight) :
+        impl(std::make_unique<DynamicUniformBufferImpl>(allocator, size_per_frame, frames_in_flight)) {}
+
+    DynamicUniformBuffer::~DynamicUniformBuffer() {}
+
+    DynamicUniformBuffer::DynamicUniformBuffer(DynamicUniformBuffer&& other) noexcept : impl(std::move(other.impl)) {}
+
+    DynamicUniformBuffer& DynamicUniformBuffer::operator=(DynamicUniformBuffer&& other) noexcept
+    {
+        impl = std::move(other.impl);
+        return *this;
+    }
+
+    void DynamicUniformBuffer::BeginFrame(const uint32_t frame_idx)
+    {
+        assert(frame_idx < impl->numFrames);
+        impl->frameBase = impl->frameSize * frame_idx;
+        impl->frameOffset.store(0u, std::memory_order_release);
+    }
+
+    DynamicUniformAllocation DynamicUniformBuffer::Allocate(const VkDeviceSize size)
+    {
+        DynamicUniformAllocation result;
+        const VkDeviceSize aligned_size = (size + impl->alignment - 1u) / impl->alignment * impl->alignment;
+        // Aligned sizes keep every offset aligned, so a plain fetch_add is enough
+        const VkDeviceSize offset = impl->frameOffset.fetch_add(aligned_size, std::memory_order_acq_rel);
+        if (offset + aligned_size > impl->frameSize)
+        {
+            LOG_IF(VERBOSE_LOGGING, WARNING) << "DynamicUniformBuffer frame region of size " << impl->frameSize << " is full, allocation of " << size << " bytes failed.";
+            return result;
+        }
+
+        const VkDeviceSize buffer_offset = impl->frameBase + offset;
+        assert(buffer_offset <= std::numeric_limits<uint32_t>::max());
+        result.Data = impl->mappedData + buffer_offset;
+        result.DynamicOffset = static_cast<uint32_t>(buffer_offset);
+        result.Size = size;
+        return result;
+    }
+
+    void DynamicUniformBuffer::Flush()
+    {
+        if (impl->buffer->HostCoherent())
+        {
+            return;
+        }
+        const VkDeviceSize used = BytesUsed();
+        if (used != 0u)
+        {
+            impl->buffer->MarkDirty(impl->frameBase, used);
+            impl->buffer->FlushDirtyRanges();
+        }
+    }
+
+    VkDescriptorBufferInfo DynamicUniformBuffer::DescriptorInfo(const VkDeviceSize range) const noexcept
+    {
+        return VkDescriptorBufferInfo{ impl->buffer->vkHandle(), 0u, range };
+    }
+
+    const VkBuffer& DynamicUniformBuffer::vkHandle() const noexcept
+    {
+        return impl->buffer->vkHandle();
+    }
+
+    VkDeviceSize DynamicUniformBuffer::Alignment() const noexcept
+    {
+        return impl->alignment;
+    }
+
+    VkDeviceSize DynamicUniformBuffer::FrameSize() const noexcept
+    {
+        return impl->frameSize;
+    }
+
+    VkDeviceSize DynamicUniformBuffer::BytesUsed() const noexcept
+    {
+        // Failed allocations still bump the offset, so clamp to the region size
+        return std::min(impl->frameOffset.load(std::memory_order_acquire), impl->frameSize);
+    }
+
+}
@@ -0,0 +1,211 @@
+#include "vpr_stdafx.h"
+#include "Image.hpp"
+#include "Allocator.hpp"
+#include "Allocation.hpp"
+#include "LogicalDevice.hpp"
+#include "vkAssert.hpp"
+#include "CreateInfoBase.hpp"
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <stdexcept>
+
+namespace vpr
+{
+
+    struct image_view_key_t
+    {
+        VkFormat format;
+        VkImageViewType viewType;
+        VkImageAspectFlags aspectMask;
+        uint32_t baseMipLevel;
+        uint32_t levelCount;
+        uint32_t baseArrayLayer;
+        uint32_t layerCount;
+        bool operator<(const image_view_key_t& other) const noexcept
+        {
+            return std::tie(format, viewType, aspectMask, baseMipLevel, levelCount, baseArrayLayer, layerCount) <
+                std::tie(other.format, other.viewType, other.aspectMask, other.baseMipLevel, other.levelCount, other.baseArrayLayer, other.layerCount);
+        }
+    };
+
+    static VkImageAspectFlags aspect_from_format(const VkFormat format) noexcept
+    {
+        switch (format)
+        {
+        case VK_FORMAT_D16_UNORM:
+        case VK_FORMAT_X8_D24_UNORM_PACK32:
+        case VK_FORMAT_D32_SFLOAT:
+            return VK_IMAGE_ASPECT_DEPTH_BIT;
+        case VK_FORMAT_S8_UINT:
+            return VK_IMAGE_ASPECT_STENCIL_BIT;
+        case VK_FORMAT_D16_UNORM_S8_UINT:
+        case VK_FORMAT_D24_UNORM_S8_UINT:
+        case VK_FORMAT_D32_SFLOAT_S8_UINT:
+            // Views used for sampling may only have one aspect: depth is the one almost always wanted
+            return VK_IMAGE_ASPECT_DEPTH_BIT;
+        default:
+            return VK_IMAGE_ASPECT_COLOR_BIT;
+        }
+    }
+
+    struct ImageImpl
+    {
+        ImageImpl(Allocator* _allocator, const VkImageCreateInfo& create_info, const AllocationRequirements& alloc_reqs);
+        ~ImageImpl();
+        VkImageViewType viewTypeFor(const VkImageSubresourceRange& range) const noexcept;
+
+        Allocator* allocator{ nullptr };
+        VkDevice device{ VK_NULL_HANDLE };
+        VkImage handle{ VK_NULL_HANDLE };
+        Allocation allocation;
+        VkImageCreateInfo createInfo;
+        mutable std::mutex viewMutex;
+        mutable std::map<image_view_key_t, VkImageView> views;
+    };
+
+    ImageImpl::ImageImpl(Allocator* _allocator, const VkImageCreateInfo& create_info, const AllocationRequirements& alloc_reqs) : allocator(_allocator),
+        device(_allocator->ParentDevice()->vkHandle()), createInfo(create_info)
+    {
+        // Don't keep pointers into memory the caller owns
+        createInfo.pNext = nullptr;
+        createInfo.pQueueFamilyIndices = nullptr;
+        VkResult result = allocator->CreateImage(create_info, alloc_reqs, &handle, allocation);
+        if (result != VK_SUCCESS)
+        {
+            // A failed bind still leaves the image and its memory behind, and our destructor won't run
+            if (handle != VK_NULL_HANDLE)
+            {
+                allocator->DestroyImage(handle, allocation);
+            }
+            throw std::runtime_error("Failed to create Image, or to allocate and bind memory for it!");
+        }
+    }
+
+    ImageImpl::~ImageImpl()
+    {
+        for (auto& view : views)
+        {
+            vkDestroyImageView(device, view.second, nullptr);
+        }
+        allocator->DestroyImage(handle, allocation);
+    }
+
+    VkImageViewType ImageImpl::viewTypeFor(const VkImageSubresourceRange& range) const noexcept
+    {
+        const uint32_t layer_count = range.layerCount == VK_REMAINING_ARRAY_LAYERS ? createInfo.arrayLayers - range.baseArrayLayer : range.layerCount;
+        switch (createInfo.imageType)
+        {
+        case VK_IMAGE_TYPE_1D:
+            return layer_count > 1u ? VK_IMAGE_VIEW_TYPE_1D_ARRAY : VK_IMAGE_VIEW_TYPE_1D;
+        case VK_IMAGE_TYPE_3D:
+            return VK_IMAGE_VIEW_TYPE_3D;
+        default:
+            if ((createInfo.flags & VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT) && (layer_count % 6u == 0u))
+            {
+                return layer_count == 6u ? VK_IMAGE_VIEW_TYPE_CUBE : VK_IMAGE_VIEW_TYPE_CUBE_ARRAY;
+            }
+            return layer_count > 1u ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
+        }
+    }
+
+    Image::Image(Allocator* allocator, const VkImageCreateInfo& create_info, const AllocationRequirements& alloc_reqs) :
+        impl(std::make_unique<ImageImpl>(allocator, create_info, alloc_reqs)) {}
+
+    Image::~Image() {}
+
+    Image::Image(Image&& other) noexcept : impl(std::move(other.impl)) {}
+
+    Image& Image::operator=(Image&& other) noexcept
+    {
+        impl = std::move(other.impl);
+        return *this;
+    }
+
+    VkImageView Image::View() const
+    {
+        return View(FullRange());
+    }
+
+    VkImageView Image::View(const VkImageSubresourceRange& range, const VkFormat format, const VkImageViewType view_type) const
+    {
+        const image_view_key_t key{
+            format == VK_FORMAT_UNDEFINED ? impl->createInfo.format : format,
+            view_type == VK_IMAGE_VIEW_TYPE_MAX_ENUM ? impl->viewTypeFor(range) : view_type,
+            range.aspectMask,
+            range.baseMipLevel,
+            range.levelCount,
+            range.baseArrayLayer,
+            range.layerCount
+        };
+
+        std::lock_guard<std::mutex> lock(impl->viewMutex);
+        auto iter = impl->views.find(key);
+        if (iter != impl->views.end())
+        {
+            return iter->second;
+        }
+
+        VkImageViewCreateInfo view_info = vk_image_view_create_info_base;
+        view_info.image = impl->handle;
+        view_info.viewType = key.viewType;
+        view_info.format = key.format;
+        view_info.subresourceRange = range;
+        VkImageView view = VK_NULL_HANDLE;
+        VkResult result = vkCreateImageView(impl->device, &view_info, nullptr, &view);
+        VkAssert(result);
+        impl->views.emplace(key, view);
+        return view;
+    }
+
+    void* Image::MappedData() const noexcept
+    {
+        return impl->allocation.MappedData();
+    }
+
+    void Image::Flush(const VkDeviceSize offset, const VkDeviceSize size)
+    {
+        impl->allocator->FlushMemory(impl->allocation, offset, size);
+    }
+
+    const VkImage& Image::vkHandle() const noexcept
+    {
+        return impl->handle;
+    }
+
+    VkFormat Image::Format() const noexcept
+    {
+        return impl->createInfo.format;
+    }
+
+    const VkExtent3D& Image::Extent() const noexcept
+    {
+        return impl->createInfo.extent;
+    }
+
+    uint32_t Image::MipLevels() const noexcept
+    {
+        return impl->createInfo.mipLevels;
+    }
+
+    uint32_t Image::ArrayLayers() const noexcept
+    {
+        return impl->createInfo.arrayLayers;
+    }
+
+    VkImageUsageFlags Image::Usage() const noexcept
+    {
+        return impl->createInfo.usage;
+    }
+
+    VkImageSubresourceRange Image::FullRange() const noexcept
+    {
+        return VkImageSubresourceRange{ aspect_from_format(impl->createInfo.format), 0u, impl->createInfo.mipLevels, 0u, impl->createInfo.arrayLayers };
+    }
+
+    const Allocation& Image::MemoryAllocation() const noexcept
+    {
+        return impl->allocation;
+    }
+
+}
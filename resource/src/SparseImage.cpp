@@ -0,0 +1,494 @@
+#include "vpr_stdafx.h"
+#include "SparseImage.hpp"
+#include "Allocator.hpp"
+#include "Allocation.hpp"
+#include "AllocationRequirements.hpp"
+#include "LogicalDevice.hpp"
+#include "vkAssert.hpp"
+#include "CreateInfoBase.hpp"
+#include "easylogging++.h"
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <cassert>
+
+namespace vpr
+{
+
+    // Layer, mip, and tile coordinates packed into 11, 5 and 16 bits each
+    static uint64_t tile_key(const SparseTile& tile) noexcept
+    {
+        assert(tile.Layer < (1u << 11u) && tile.MipLevel < (1u << 5u) && tile.X < (1u << 16u) && tile.Y < (1u << 16u) && tile.Z < (1u << 16u));
+        return (uint64_t(tile.Layer) << 53u) | (uint64_t(tile.MipLevel) << 48u) | (uint64_t(tile.X) << 32u) | (uint64_t(tile.Y) << 16u) | uint64_t(tile.Z);
+    }
+
+    static SparseTile tile_from_key(const uint64_t key) noexcept
+    {
+        SparseTile result;
+        result.Layer = static_cast<uint32_t>(key >> 53u);
+        result.MipLevel = static_cast<uint32_t>((key >> 48u) & 0x1fu);
+        result.X = static_cast<uint32_t>((key >> 32u) & 0xffffu);
+        result.Y = static_cast<uint32_t>((key >> 16u) & 0xffffu);
+        result.Z = static_cast<uint32_t>(key & 0xffffu);
+        return result;
+    }
+
+    struct resident_tile_t
+    {
+        Allocation allocation;
+        uint64_t lastRequested{ 0u };
+    };
+
+    struct SparseImageImpl
+    {
+        SparseImageImpl(Allocator* allocator, const VkImageCreateInfo& create_info, const uint32_t max_resident_tiles, const uint32_t eviction_delay, VkQueue sparse_queue);
+        ~SparseImageImpl();
+        void bindMipTails(const std::vector<VkSparseImageMemoryRequirements>& sparse_reqs);
+        void requestTile(SparseTile tile);
+        bool bindInFlight();
+        bool allocateTile(Allocation& dest);
+        VkSparseImageMemoryBind makeBind(const SparseTile& tile, const Allocation* allocation) const noexcept;
+        VkExtent3D mipExtent(const uint32_t mip_level) const noexcept;
+
+        Allocator* allocator{ nullptr };
+        VkDevice device{ VK_NULL_HANDLE };
+        VkQueue queue{ VK_NULL_HANDLE };
+        VkImage handle{ VK_NULL_HANDLE };
+        VkImageCreateInfo createInfo;
+        VkImageAspectFlags aspect{ VK_IMAGE_ASPECT_COLOR_BIT };
+        VkExtent3D granularity{ 1u, 1u, 1u };
+        uint32_t mipTailFirstLod{ 0u };
+        VkMemoryRequirements tileMemoryReqs{};
+        uint32_t maxResidentTiles{ 0u };
+        uint32_t evictionDelay{ 0u };
+        uint64_t frameCount{ 0u };
+        std::vector<Allocation> mipTailAllocations;
+        VkDeviceSize mipTailBytes{ 0u };
+        mutable std::mutex mutex;
+        std::unordered_map<uint64_t, resident_tile_t> residentTiles;
+        std::unordered_set<uint64_t> pendingTiles;
+        // Memory of evicted tiles can't be re-used until the binding operation unbinding it completes
+        VkFence bindFence{ VK_NULL_HANDLE };
+        bool bindSubmitted{ false };
+        std::vector<Allocation> pendingFrees;
+        SparseResidencyStats stats;
+    };
+
+    SparseImageImpl::SparseImageImpl(Allocator* _allocator, const VkImageCreateInfo& create_info, const uint32_t max_resident_tiles, const uint32_t eviction_delay,
+        VkQueue sparse_queue) : allocator(_allocator), device(_allocator->ParentDevice()->vkHandle()), queue(sparse_queue), createInfo(create_info),
+        maxResidentTiles(max_resident_tiles), evictionDelay(eviction_delay)
+    {
+        constexpr VkImageCreateFlags required_flags = VK_IMAGE_CREATE_SPARSE_BINDING_BIT | VK_IMAGE_CREATE_SPARSE_RESIDENCY_BIT;
+        if ((create_info.flags & required_flags) != required_flags)
+        {
+            throw std::runtime_error("SparseImage requires VK_IMAGE_CREATE_SPARSE_BINDING_BIT and VK_IMAGE_CREATE_SPARSE_RESIDENCY_BIT!");
+        }
+
+        const Device* parent = allocator->ParentDevice();
+        if (queue == VK_NULL_HANDLE)
+        {
+            if (parent->NumSparseBindingQueues() == 0u)
+            {
+                throw std::runtime_error("SparseImage requires a sparse binding queue, but the device has none!");
+            }
+            queue = parent->SparseBindingQueue();
+        }
+
+        createInfo.pNext = nullptr;
+        createInfo.pQueueFamilyIndices = nullptr;
+        VkResult result = vkCreateImage(device, &create_info, nullptr, &handle);
+        VkAssert(result);
+
+        // For sparse images, alignment is the size of a single tile
+        vkGetImageMemoryRequirements(device, handle, &tileMemoryReqs);
+        tileMemoryReqs.size = tileMemoryReqs.alignment;
+
+        uint32_t num_sparse_reqs = 0u;
+        vkGetImageSparseMemoryRequirements(device, handle, &num_sparse_reqs, nullptr);
+        std::vector<VkSparseImageMemoryRequirements> sparse_reqs(num_sparse_reqs);
+        vkGetImageSparseMemoryRequirements(device, handle, &num_sparse_reqs, sparse_reqs.data());
+
+        auto color_iter = std::find_if(sparse_reqs.begin(), sparse_reqs.end(), [](const VkSparseImageMemoryRequirements& reqs)
+        {
+            return (reqs.formatProperties.aspectMask & VK_IMAGE_ASPECT_METADATA_BIT) == 0u;
+        });
+        if (color_iter == sparse_reqs.end())
+        {
+            vkDestroyImage(device, handle, nullptr);
+            throw std::runtime_error("Sparse memory requirements for SparseImage contain no usable aspect: format likely doesn't support sparse residency.");
+        }
+
+        aspect = color_iter->formatProperties.aspectMask;
+        granularity = color_iter->formatProperties.imageGranularity;
+        mipTailFirstLod = std::min(color_iter->imageMipTailFirstLod, createInfo.mipLevels);
+
+        result = vkCreateFence(device, &vk_fence_create_info_base, nullptr, &bindFence);
+        VkAssert(result);
+
+        bindMipTails(sparse_reqs);
+        stats.MaxResidentTiles = maxResidentTiles;
+    }
+
+    SparseImageImpl::~SparseImageImpl()
+    {
+        if (bindSubmitted)
+        {
+            vkWaitForFences(device, 1, &bindFence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+        }
+        // Destroying the image unbinds everything, so memory can be freed right after
+        vkDestroyImage(device, handle, nullptr);
+        vkDestroyFence(device, bindFence, nullptr);
+        for (auto& tile : residentTiles)
+        {
+            allocator->FreeMemory(tile.second.allocation);
+        }
+        for (auto& allocation : pendingFrees)
+        {
+            allocator->FreeMemory(allocation);
+        }
+        for (auto& allocation : mipTailAllocations)
+        {
+            allocator->FreeMemory(allocation);
+        }
+    }
+
+    void SparseImageImpl::bindMipTails(const std::vector<VkSparseImageMemoryRequirements>& sparse_reqs)
+    {
+        std::vector<VkSparseMemoryBind> binds;
+        AllocationRequirements alloc_reqs;
+        alloc_reqs.Usage = memory_usage::GpuOnly;
+
+        for (const auto& reqs : sparse_reqs)
+        {
+            const bool metadata = (reqs.formatProperties.aspectMask & VK_IMAGE_ASPECT_METADATA_BIT) != 0u;
+            // Metadata has to be bound in full, and there's only a tail to bind if some levels are too small to tile
+            if (reqs.imageMipTailFirstLod >= createInfo.mipLevels && !metadata)
+            {
+                continue;
+            }
+
+            const bool single_tail = metadata || (reqs.formatProperties.flags & VK_SPARSE_IMAGE_FORMAT_SINGLE_MIPTAIL_BIT) != 0u;
+            const uint32_t num_tails = single_tail ? 1u : createInfo.arrayLayers;
+            for (uint32_t i = 0u; i < num_tails; ++i)
+            {
+                VkMemoryRequirements memory_reqs = tileMemoryReqs;
+                memory_reqs.size = reqs.imageMipTailSize;
+                Allocation allocation;
+                VkResult result = allocator->AllocateMemory(memory_reqs, alloc_reqs, suballocation_type::ImageOptimal, allocation);
+                VkAssert(result);
+
+                VkSparseMemoryBind bind{};
+                bind.resourceOffset = reqs.imageMipTailOffset + reqs.imageMipTailStride * i;
+                bind.size = reqs.imageMipTailSize;
+                bind.memory = allocation.Memory();
+                bind.memoryOffset = allocation.Offset();
+                bind.flags = metadata ? VkSparseMemoryBindFlags(VK_SPARSE_MEMORY_BIND_METADATA_BIT) : 0u;
+                binds.emplace_back(bind);
+                mipTailBytes += reqs.imageMipTailSize;
+                mipTailAllocations.emplace_back(std::move(allocation));
+            }
+        }
+
+        if (binds.empty())
+        {
+            return;
+        }
+
+        const VkSparseImageOpaqueMemoryBindInfo opaque_info{ handle, static_cast<uint32_t>(binds.size()), binds.data() };
+        VkBindSparseInfo bind_info{};
+        bind_info.sType = VK_STRUCTURE_TYPE_BIND_SPARSE_INFO;
+        bind_info.imageOpaqueBindCount = 1u;
+        bind_info.pImageOpaqueBinds = &opaque_info;
+        VkResult result = vkQueueBindSparse(queue, 1, &bind_info, bindFence);
+        VkAssert(result);
+        bindSubmitted = true;
+        stats.MipTailBytes = mipTailBytes;
+    }
+
+    VkExtent3D SparseImageImpl::mipExtent(const uint32_t mip_level) const noexcept
+    {
+        return VkExtent3D{ std::max(createInfo.extent.width >> mip_level, 1u), std::max(createInfo.extent.height >> mip_level, 1u),
+            std::max(createInfo.extent.depth >> mip_level, 1u) };
+    }
+
+    void SparseImageImpl::requestTile(SparseTile tile)
+    {
+        // Walk up the mip chain too, so there's a resident fallback for tiles still waiting on memory
+        while (tile.MipLevel < mipTailFirstLod)
+        {
+            const uint64_t key = tile_key(tile);
+            auto iter = residentTiles.find(key);
+            if (iter != residentTiles.end())
+            {
+                iter->second.lastRequested = frameCount;
+            }
+            else
+            {
+                pendingTiles.emplace(key);
+            }
+
+            ++tile.MipLevel;
+            tile.X /= 2u;
+            tile.Y /= 2u;
+            tile.Z = createInfo.imageType == VK_IMAGE_TYPE_3D ? tile.Z / 2u : 0u;
+        }
+    }
+
+    bool SparseImageImpl::bindInFlight()
+    {
+        if (!bindSubmitted)
+        {
+            return false;
+        }
+
+        if (vkGetFenceStatus(device, bindFence) != VK_SUCCESS)
+        {
+            return true;
+        }
+
+        VkResult result = vkResetFences(device, 1, &bindFence);
+        VkAssert(result);
+        bindSubmitted = false;
+        for (auto& allocation : pendingFrees)
+        {
+            allocator->FreeMemory(allocation);
+        }
+        pendingFrees.clear();
+        return false;
+    }
+
+    bool SparseImageImpl::allocateTile(Allocation& dest)
+    {
+        AllocationRequirements alloc_reqs;
+        alloc_reqs.Usage = memory_usage::GpuOnly;
+        return allocator->AllocateMemory(tileMemoryReqs, alloc_reqs, suballocation_type::ImageOptimal, dest) == VK_SUCCESS;
+    }
+
+    VkSparseImageMemoryBind SparseImageImpl::makeBind(const SparseTile& tile, const Allocation* allocation) const noexcept
+    {
+        VkSparseImageMemoryBind bind{};
+        bind.subresource = VkImageSubresource{ aspect, tile.MipLevel, tile.Layer };
+        bind.offset = VkOffset3D{ static_cast<int32_t>(tile.X * granularity.width), static_cast<int32_t>(tile.Y * granularity.height),
+            static_cast<int32_t>(tile.Z * granularity.depth) };
+        // Tiles on the edge of a level may be partial: extents must then reach the edge of the level exactly
+        const VkExtent3D extent = mipExtent(tile.MipLevel);
+        bind.extent = VkExtent3D{ std::min(granularity.width, extent.width - static_cast<uint32_t>(bind.offset.x)),
+            std::min(granularity.height, extent.height - static_cast<uint32_t>(bind.offset.y)),
+            std::min(granularity.depth, extent.depth - static_cast<uint32_t>(bind.offset.z)) };
+        bind.memory = allocation != nullptr ? allocation->Memory() : VK_NULL_HANDLE;
+        bind.memoryOffset = allocation != nullptr ? allocation->Offset() : 0u;
+        return bind;
+    }
+
+    SparseImage::SparseImage(Allocator* allocator, const VkImageCreateInfo& create_info, const uint32_t max_resident_tiles, const uint32_t eviction_delay, VkQueue sparse_queue) :
+        impl(std::make_unique<SparseImageImpl>(allocator, create_info, max_resident_tiles, eviction_delay, sparse_queue)) {}
+
+    SparseImage::~SparseImage() {}
+
+    SparseImage::SparseImage(SparseImage&& other) noexcept : impl(std::move(other.impl)) {}
+
+    SparseImage& SparseImage::operator=(SparseImage&& other) noexcept
+    {
+        impl = std::move(other.impl);
+        return *this;
+    }
+
+    void SparseImage::RequestTile(const SparseTile& tile)
+    {
+        std::lock_guard<std::mutex> lock(impl->mutex);
+        impl->requestTile(tile);
+    }
+
+    void SparseImage::ProcessFeedback(const uint8_t* min_lods, const uint32_t layer)
+    {
+        const VkExtent3D tile_count = TileCount(0u);
+        std::lock_guard<std::mutex> lock(impl->mutex);
+        for (uint32_t y = 0u; y < tile_count.height; ++y)
+        {
+            for (uint32_t x = 0u; x < tile_count.width; ++x)
+            {
+                const uint8_t lod = min_lods[y * tile_count.width + x];
+                if (lod < impl->mipTailFirstLod)
+                {
+                    SparseTile tile;
+                    tile.Layer = layer;
+                    tile.MipLevel = lod;
+                    tile.X = x >> lod;
+                    tile.Y = y >> lod;
+                    impl->requestTile(tile);
+                }
+            }
+        }
+    }
+
+    std::vector<SparseTile> SparseImage::Update(const uint32_t max_commits, VkSemaphore wait_semaphore, VkSemaphore signal_semaphore, bool* bind_submitted)
+    {
+        std::vector<SparseTile> committed;
+        if (bind_submitted != nullptr)
+        {
+            *bind_submitted = false;
+        }
+        std::lock_guard<std::mutex> lock(impl->mutex);
+        ++impl->frameCount;
+        if (impl->bindInFlight() || impl->pendingTiles.empty())
+        {
+            return committed;
+        }
+
+        // Coarser levels first: they cover the most texels, and are the fallback for finer ones
+        std::vector<uint64_t> requests(impl->pendingTiles.begin(), impl->pendingTiles.end());
+        std::sort(requests.begin(), requests.end(), [](const uint64_t a, const uint64_t b)
+        {
+            const uint64_t mip_a = (a >> 48u) & 0x1fu;
+            const uint64_t mip_b = (b >> 48u) & 0x1fu;
+            return mip_a != mip_b ? mip_a > mip_b : a < b;
+        });
+
+        // Least recently requested first, excluding tiles that frames in flight may still be sampling
+        std::vector<uint64_t> evictable;
+        for (const auto& tile : impl->residentTiles)
+        {
+            if (tile.second.lastRequested + impl->evictionDelay < impl->frameCount)
+            {
+                evictable.emplace_back(tile.first);
+            }
+        }
+        std::sort(evictable.begin(), evictable.end(), [this](const uint64_t a, const uint64_t b)
+        {
+            return impl->residentTiles.at(a).lastRequested < impl->residentTiles.at(b).lastRequested;
+        });
+        auto next_eviction = evictable.begin();
+
+        std::vector<VkSparseImageMemoryBind> binds;
+        auto evict_one = [&]()
+        {
+            if (next_eviction == evictable.end())
+            {
+                return false;
+            }
+            auto iter = impl->residentTiles.find(*next_eviction);
+            binds.emplace_back(impl->makeBind(tile_from_key(iter->first), nullptr));
+            impl->pendingFrees.emplace_back(std::move(iter->second.allocation));
+            impl->residentTiles.erase(iter);
+            ++impl->stats.TilesEvicted;
+            ++next_eviction;
+            return true;
+        };
+
+        for (const uint64_t key : requests)
+        {
+            if (committed.size() >= max_commits)
+            {
+                break;
+            }
+
+            if (impl->residentTiles.size() >= impl->maxResidentTiles && !evict_one())
+            {
+                ++impl->stats.FailedCommits;
+                break;
+            }
+
+            // Evicted memory is only freed once the unbind completes, so allocation failures can't be fixed by evicting more this update
+            resident_tile_t tile;
+            if (!impl->allocateTile(tile.allocation))
+            {
+                ++impl->stats.FailedCommits;
+                break;
+            }
+
+            tile.lastRequested = impl->frameCount;
+            const SparseTile coord = tile_from_key(key);
+            binds.emplace_back(impl->makeBind(coord, &tile.allocation));
+            impl->residentTiles.emplace(key, std::move(tile));
+            impl->pendingTiles.erase(key);
+            committed.emplace_back(coord);
+            ++impl->stats.TilesCommitted;
+        }
+
+        if (binds.empty())
+        {
+            return committed;
+        }
+
+        const VkSparseImageMemoryBindInfo image_bind_info{ impl->handle, static_cast<uint32_t>(binds.size()), binds.data() };
+        VkBindSparseInfo bind_info{};
+        bind_info.sType = VK_STRUCTURE_TYPE_BIND_SPARSE_INFO;
+        bind_info.waitSemaphoreCount = wait_semaphore != VK_NULL_HANDLE ? 1u : 0u;
+        bind_info.pWaitSemaphores = &wait_semaphore;
+        bind_info.imageBindCount = 1u;
+        bind_info.pImageBinds = &image_bind_info;
+        bind_info.signalSemaphoreCount = signal_semaphore != VK_NULL_HANDLE ? 1u : 0u;
+        bind_info.pSignalSemaphores = &signal_semaphore;
+        VkResult result = vkQueueBindSparse(impl->queue, 1, &bind_info, impl->bindFence);
+        VkAssert(result);
+        impl->bindSubmitted = true;
+        if (bind_submitted != nullptr)
+        {
+            *bind_submitted = true;
+        }
+        LOG_IF(VERBOSE_LOGGING, INFO) << "SparseImage committed " << committed.size() << " tiles, with " << binds.size() - committed.size() << " evicted.";
+        return committed;
+    }
+
+    bool SparseImage::IsResident(const SparseTile& tile) const
+    {
+        if (tile.MipLevel >= impl->mipTailFirstLod)
+        {
+            return true;
+        }
+        std::lock_guard<std::mutex> lock(impl->mutex);
+        return impl->residentTiles.count(tile_key(tile)) != 0u;
+    }
+
+    VkOffset3D SparseImage::TileOffset(const SparseTile& tile) const noexcept
+    {
+        return impl->makeBind(tile, nullptr).offset;
+    }
+
+    VkExtent3D SparseImage::TileExtent(const SparseTile& tile) const noexcept
+    {
+        return impl->makeBind(tile, nullptr).extent;
+    }
+
+    VkExtent3D SparseImage::TileCount(const uint32_t mip_level) const noexcept
+    {
+        const VkExtent3D extent = impl->mipExtent(mip_level);
+        const VkExtent3D& granularity = impl->granularity;
+        return VkExtent3D{ (extent.width + granularity.width - 1u) / granularity.width, (extent.height + granularity.height - 1u) / granularity.height,
+            (extent.depth + granularity.depth - 1u) / granularity.depth };
+    }
+
+    const VkExtent3D& SparseImage::TileGranularity() const noexcept
+    {
+        return impl->granularity;
+    }
+
+    uint32_t SparseImage::MipTailFirstLod() const noexcept
+    {
+        return impl->mipTailFirstLod;
+    }
+
+    const VkImage& SparseImage::vkHandle() const noexcept
+    {
+        return impl->handle;
+    }
+
+    const VkImageCreateInfo& SparseImage::CreateInfo() const noexcept
+    {
+        return impl->createInfo;
+    }
+
+    SparseResidencyStats SparseImage::Stats() const
+    {
+        std::lock_guard<std::mutex> lock(impl->mutex);
+        SparseResidencyStats result = impl->stats;
+        result.ResidentTiles = static_cast<uint32_t>(impl->residentTiles.size());
+        result.PendingTiles = static_cast<uint32_t>(impl->pendingTiles.size());
+        result.ResidentBytes = impl->tileMemoryReqs.size * impl->residentTiles.size();
+        return result;
+    }
+
+}
@@ -0,0 +1,271 @@
+#include "vpr_stdafx.h"
+#include "StagingRing.hpp"
+#include "Buffer.hpp"
+#include "Allocator.hpp"
+#include "AllocationRequirements.hpp"
+#include "LogicalDevice.hpp"
+#include "vkAssert.hpp"
+#include "CreateInfoBase.hpp"
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cassert>
+
+namespace vpr
+{
+
+    struct StagingRingImpl
+    {
+        StagingRingImpl(Allocator* allocator, const VkDeviceSize size, const uint32_t frames_in_flight);
+        void updatePeak(const VkDeviceSize in_use) noexcept;
+
+        VkDevice device{ VK_NULL_HANDLE };
+        std::unique_ptr<Buffer> buffer;
+        char* mappedData{ nullptr };
+        VkDeviceSize size{ 0u };
+        VkDeviceSize defaultAlignment{ 1u };
+        // Head and tail are positions in an unbounded sequence: the physical offset is the position modulo size. This keeps full and
+        // empty distinguishable, and lets reservations be made with a single compare-exchange on head.
+        std::atomic<uint64_t> head{ 0u };
+        std::atomic<uint64_t> tail{ 0u };
+        // Position of head when each frame slot last finished recording
+        std::vector<uint64_t> frameEnds;
+        uint32_t currentFrame{ 0u };
+        std::atomic<uint64_t> numReservations{ 0u };
+        std::atomic<uint64_t> bytesReserved{ 0u };
+        std::atomic<uint64_t> failedReservations{ 0u };
+        std::atomic<uint64_t> peakBytesInUse{ 0u };
+    };
+
+    StagingRingImpl::StagingRingImpl(Allocator* allocator, const VkDeviceSize _size, const uint32_t frames_in_flight) : device(allocator->ParentDevice()->vkHandle()),
+        size(_size), frameEnds(frames_in_flight, 0u)
+    {
+        assert(frames_in_flight > 0u);
+        VkBufferCreateInfo create_info = vk_buffer_create_info_base;
+        create_info.size = size;
+        create_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        AllocationRequirements alloc_reqs;
+        // Coherent, so nothing written into the ring ever needs flushing
+        alloc_reqs.Usage = memory_usage::CpuOnly;
+        alloc_reqs.PersistentlyMapped = true;
+        buffer = std::make_unique<Buffer>(allocator, create_info, alloc_reqs);
+        mappedData = reinterpret_cast<char*>(buffer->MappedData());
+        defaultAlignment = std::max(allocator->ParentDevice()->GetPhysicalDeviceProperties().limits.optimalBufferCopyOffsetAlignment, VkDeviceSize(4u));
+    }
+
+    void StagingRingImpl::updatePeak(const VkDeviceSize in_use) noexcept
+    {
+        uint64_t peak = peakBytesInUse.load(std::memory_order_relaxed);
+        while (in_use > peak && !peakBytesInUse.compare_exchange_weak(peak, in_use, std::memory_order_relaxed)) {}
+    }
+
+    // Bytes per texel, or per compressed block. Depth/stencil formats are copied one aspect at a time, with offsets that only need to be
+    // multiples of 4, so they (and formats not listed) report 0.
+    static VkDeviceSize texel_block_size(const VkFormat format) noexcept
+    {
+        if ((format >= VK_FORMAT_R8_UNORM && format <= VK_FORMAT_R8_SRGB) || format == VK_FORMAT_R4G4_UNORM_PACK8)
+        {
+            return 1u;
+        }
+        else if ((format >= VK_FORMAT_R4G4B4A4_UNORM_PACK16 && format <= VK_FORMAT_A1R5G5B5_UNORM_PACK16) || (format >= VK_FORMAT_R8G8_UNORM && format <= VK_FORMAT_R8G8_SRGB) ||
+            (format >= VK_FORMAT_R16_UNORM && format <= VK_FORMAT_R16_SFLOAT))
+        {
+            return 2u;
+        }
+        else if (format >= VK_FORMAT_R8G8B8_UNORM && format <= VK_FORMAT_B8G8R8_SRGB)
+        {
+            return 3u;
+        }
+        else if ((format >= VK_FORMAT_R8G8B8A8_UNORM && format <= VK_FORMAT_A2B10G10R10_SINT_PACK32) || (format >= VK_FORMAT_R16G16_UNORM && format <= VK_FORMAT_R16G16_SFLOAT) ||
+            (format >= VK_FORMAT_R32_UINT && format <= VK_FORMAT_R32_SFLOAT) || format == VK_FORMAT_B10G11R11_UFLOAT_PACK32 || format == VK_FORMAT_E5B9G9R9_UFLOAT_PACK32)
+        {
+            return 4u;
+        }
+        else if (format >= VK_FORMAT_R16G16B16_UNORM && format <= VK_FORMAT_R16G16B16_SFLOAT)
+        {
+            return 6u;
+        }
+        else if ((format >= VK_FORMAT_R16G16B16A16_UNORM && format <= VK_FORMAT_R16G16B16A16_SFLOAT) || (format >= VK_FORMAT_R32G32_UINT && format <= VK_FORMAT_R32G32_SFLOAT) ||
+            (format >= VK_FORMAT_R64_UINT && format <= VK_FORMAT_R64_SFLOAT))
+        {
+            return 8u;
+        }
+        else if (format >= VK_FORMAT_R32G32B32_UINT && format <= VK_FORMAT_R32G32B32_SFLOAT)
+        {
+            return 12u;
+        }
+        else if ((format >= VK_FORMAT_R32G32B32A32_UINT && format <= VK_FORMAT_R32G32B32A32_SFLOAT) || (format >= VK_FORMAT_R64G64_UINT && format <= VK_FORMAT_R64G64_SFLOAT))
+        {
+            return 16u;
+        }
+        else if (format >= VK_FORMAT_R64G64B64_UINT && format <= VK_FORMAT_R64G64B64_SFLOAT)
+        {
+            return 24u;
+        }
+        else if (format >= VK_FORMAT_R64G64B64A64_UINT && format <= VK_FORMAT_R64G64B64A64_SFLOAT)
+        {
+            return 32u;
+        }
+        else if ((format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && format <= VK_FORMAT_BC1_RGBA_SRGB_BLOCK) || (format >= VK_FORMAT_BC4_UNORM_BLOCK && format <= VK_FORMAT_BC4_SNORM_BLOCK) ||
+            (format >= VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK && format <= VK_FORMAT_ETC2_R8G8B8A1_SRGB_BLOCK) || (format >= VK_FORMAT_EAC_R11_UNORM_BLOCK && format <= VK_FORMAT_EAC_R11_SNORM_BLOCK))
+        {
+            return 8u;
+        }
+        else if ((format >= VK_FORMAT_BC2_UNORM_BLOCK && format <= VK_FORMAT_BC7_SRGB_BLOCK) || (format >= VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK && format <= VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK) ||
+            (format >= VK_FORMAT_EAC_R11G11_UNORM_BLOCK && format <= VK_FORMAT_ASTC_12x12_SRGB_BLOCK))
+        {
+            return 16u;
+        }
+        else
+        {
+            return 0u;
+        }
+    }
+
+    StagingRing::StagingRing(Allocator* allocator, const VkDeviceSize size, const uint32_t frames_in_flight) :
+        impl(std::make_unique<StagingRingImpl>(allocator, size, frames_in_flight)) {}
+
+    StagingRing::~StagingRing() {}
+
+    StagingRing::StagingRing(StagingRing&& other) noexcept : impl(std::move(other.impl)) {}
+
+    StagingRing& StagingRing::operator=(StagingRing&& other) noexcept
+    {
+        impl = std::move(other.impl);
+        return *this;
+    }
+
+    void StagingRing::BeginFrame(const uint32_t frame_idx, const VkFence frame_fence)
+    {
+        assert(frame_idx < impl->frameEnds.size());
+        if (frame_fence != VK_NULL_HANDLE)
+        {
+            VkResult result = vkWaitForFences(impl->device, 1, &frame_fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+            VkAssert(result);
+        }
+
+        impl->frameEnds[impl->currentFrame] = impl->head.load(std::memory_order_acquire);
+        // Everything up to the end of this slot's previous frame has been consumed by the device
+        const uint64_t retired = impl->frameEnds[frame_idx];
+        if (retired > impl->tail.load(std::memory_order_relaxed))
+        {
+            impl->tail.store(retired, std::memory_order_release);
+        }
+        impl->currentFrame = frame_idx;
+    }
+
+    StagingAllocation StagingRing::Reserve(const VkDeviceSize size, VkDeviceSize alignment)
+    {
+        alignment = alignment != 0u ? alignment : impl->defaultAlignment;
+        const uint64_t ring_size = impl->size;
+        StagingAllocation result;
+        if (size == 0u || size > ring_size)
+        {
+            impl->failedReservations.fetch_add(1u, std::memory_order_relaxed);
+            return result;
+        }
+
+        uint64_t current = impl->head.load(std::memory_order_relaxed);
+        uint64_t begin = 0u;
+        uint64_t end = 0u;
+        do
+        {
+            const uint64_t physical = current % ring_size;
+            const uint64_t aligned_physical = (physical + alignment - 1u) / alignment * alignment;
+            // Physical offset zero satisfies any alignment, so wrapping needs no further adjustment
+            begin = aligned_physical + size <= ring_size ? current - physical + aligned_physical : current - physical + ring_size;
+            end = begin + size;
+            if (end - impl->tail.load(std::memory_order_acquire) > ring_size)
+            {
+                impl->failedReservations.fetch_add(1u, std::memory_order_relaxed);
+                return result;
+            }
+        } while (!impl->head.compare_exchange_weak(current, end, std::memory_order_acq_rel, std::memory_order_relaxed));
+
+        impl->numReservations.fetch_add(1u, std::memory_order_relaxed);
+        impl->bytesReserved.fetch_add(size, std::memory_order_relaxed);
+        impl->updatePeak(end - impl->tail.load(std::memory_order_relaxed));
+
+        result.Offset = begin % ring_size;
+        result.Data = impl->mappedData + result.Offset;
+        result.Size = size;
+        result.Buffer = impl->buffer->vkHandle();
+        return result;
+    }
+
+    StagingAllocation StagingRing::Upload(const void* data, const VkDeviceSize size, const VkDeviceSize alignment)
+    {
+        StagingAllocation result = Reserve(size, alignment);
+        if (result.Valid())
+        {
+            std::memcpy(result.Data, data, static_cast<size_t>(size));
+        }
+        return result;
+    }
+
+    StagingAllocation StagingRing::ReserveForImage(const VkDeviceSize size, const VkFormat format)
+    {
+        return Reserve(size, ImageCopyAlignment(format));
+    }
+
+    StagingAllocation StagingRing::UploadForImage(const void* data, const VkDeviceSize size, const VkFormat format)
+    {
+        return Upload(data, size, ImageCopyAlignment(format));
+    }
+
+    VkDeviceSize StagingRing::ImageCopyAlignment(const VkFormat format) noexcept
+    {
+        // Block sizes are 1, 2, 3, 4, 6 or a multiple of 4: the lcm with 4 is the block size rounded up to a multiple of 4, or 12 for 3 and 6
+        const VkDeviceSize block_size = texel_block_size(format);
+        if (block_size % 4u == 0u && block_size != 0u)
+        {
+            return block_size;
+        }
+        return block_size % 3u == 0u && block_size != 0u ? 12u : 4u;
+    }
+
+    VkBufferCopy StagingRing::CopyRegion(const StagingAllocation& src, const VkDeviceSize dst_offset) noexcept
+    {
+        return VkBufferCopy{ src.Offset, dst_offset, src.Size };
+    }
+
+    VkBufferImageCopy StagingRing::ImageCopyRegion(const StagingAllocation& src, const VkImageSubresourceLayers& dst_subresource, const VkOffset3D& dst_offset,
+        const VkExtent3D& dst_extent) noexcept
+    {
+        VkBufferImageCopy result{};
+        result.bufferOffset = src.Offset;
+        result.bufferRowLength = 0u;
+        result.bufferImageHeight = 0u;
+        result.imageSubresource = dst_subresource;
+        result.imageOffset = dst_offset;
+        result.imageExtent = dst_extent;
+        return result;
+    }
+
+    const VkBuffer& StagingRing::vkHandle() const noexcept
+    {
+        return impl->buffer->vkHandle();
+    }
+
+    VkDeviceSize StagingRing::Size() const noexcept
+    {
+        return impl->size;
+    }
+
+    VkDeviceSize StagingRing::BytesInUse() const noexcept
+    {
+        return impl->head.load(std::memory_order_acquire) - impl->tail.load(std::memory_order_acquire);
+    }
+
+    StagingRingStats StagingRing::Stats() const noexcept
+    {
+        StagingRingStats result;
+        result.NumReservations = impl->numReservations.load(std::memory_order_relaxed);
+        result.BytesReserved = impl->bytesReserved.load(std::memory_order_relaxed);
+        result.FailedReservations = impl->failedReservations.load(std::memory_order_relaxed);
+        result.PeakBytesInUse = impl->peakBytesInUse.load(std::memory_order_relaxed);
+        return result;
+    }
+
+}
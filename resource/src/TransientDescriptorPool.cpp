@@ -0,0 +1,76 @@
+#include "vpr_stdafx.h"
+#include "TransientDescriptorPool.hpp"
+#include "DescriptorPoolAllocator.hpp"
+#include "DescriptorSetLayout.hpp"
+#include <vector>
+#include <cassert>
+
+namespace vpr
+{
+
+    struct TransientDescriptorPoolImpl
+    {
+        std::vector<std::unique_ptr<DescriptorPoolAllocator>> frameAllocators;
+        uint32_t currentFrame{ 0u };
+    };
+
+    TransientDescriptorPool::TransientDescriptorPool(const VkDevice& device, const uint32_t frames_in_flight, const uint32_t sets_per_pool) :
+        impl(std::make_unique<TransientDescriptorPoolImpl>())
+    {
+        assert(frames_in_flight > 0u);
+        for (uint32_t i = 0u; i < frames_in_flight; ++i)
+        {
+            // No FREE_DESCRIPTOR_SET_BIT: lets the driver allocate linearly, as sets are only ever freed by resetting the pool
+            impl->frameAllocators.emplace_back(std::make_unique<DescriptorPoolAllocator>(device, sets_per_pool, VkDescriptorPoolCreateFlags(0)));
+        }
+    }
+
+    TransientDescriptorPool::~TransientDescriptorPool() {}
+
+    TransientDescriptorPool::TransientDescriptorPool(TransientDescriptorPool&& other) noexcept : impl(std::move(other.impl)) {}
+
+    TransientDescriptorPool& TransientDescriptorPool::operator=(TransientDescriptorPool&& other) noexcept
+    {
+        impl = std::move(other.impl);
+        return *this;
+    }
+
+    void TransientDescriptorPool::AddResourceType(const VkDescriptorType descriptor_type, const uint32_t count_per_set)
+    {
+        for (auto& allocator : impl->frameAllocators)
+        {
+            allocator->AddResourceType(descriptor_type, count_per_set);
+        }
+    }
+
+    void TransientDescriptorPool::BeginFrame(const uint32_t frame_idx)
+    {
+        assert(frame_idx < impl->frameAllocators.size());
+        impl->currentFrame = frame_idx;
+        impl->frameAllocators[frame_idx]->Reset();
+    }
+
+    VkDescriptorSet TransientDescriptorPool::Allocate(const DescriptorSetLayout& set_layout)
+    {
+        VkDescriptorPool pool{ VK_NULL_HANDLE };
+        return impl->frameAllocators[impl->currentFrame]->Allocate(set_layout, &pool);
+    }
+
+    VkResult TransientDescriptorPool::Allocate(const VkDescriptorSetLayout set_layout, const VkDescriptorPoolSize* descriptor_counts, const uint32_t num_descriptor_counts,
+        VkDescriptorSet* dest_set)
+    {
+        VkDescriptorPool pool{ VK_NULL_HANDLE };
+        return impl->frameAllocators[impl->currentFrame]->Allocate(set_layout, descriptor_counts, num_descriptor_counts, dest_set, &pool);
+    }
+
+    DescriptorPoolAllocator* TransientDescriptorPool::FrameAllocator() noexcept
+    {
+        return impl->frameAllocators[impl->currentFrame].get();
+    }
+
+    uint32_t TransientDescriptorPool::CurrentFrame() const noexcept
+    {
+        return impl->currentFrame;
+    }
+
+}
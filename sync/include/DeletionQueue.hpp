@@ -0,0 +1,89 @@
+#pragma once
+#ifndef VPR_DELETION_QUEUE_HPP
+#define VPR_DELETION_QUEUE_HPP
+#include "vpr_stdafx.h"
+#include "ForwardDecl.hpp"
+#include <memory>
+#include <functional>
+#include <type_traits>
+
+namespace vpr
+{
+
+    struct DeletionQueueImpl;
+
+    /**The DeletionQueue defers destruction of Vulkan objects until the GPU is done with them, removing the need to call vkDeviceWaitIdle
+     * before destroying resources that may still be in use (e.g, when reloading shaders or recreating the swapchain).
+     * 
+     * Every deferred object is tagged with a "retire value": the value of a monotonically increasing counter that, once reached, guarantees 
+     * the GPU no longer uses the object. This can be the value a timeline Semaphore will be signaled with by the last submission referencing
+     * the object, or a frame index: in the latter case, call Collect() with the index of the most recent frame whose fence has been waited on.
+     * Collect() then destroys everything that has retired, all at once.
+     * 
+     * vpr wrapper objects (GraphicsPipeline, ShaderModule, Framebuffer, DescriptorSet, etc) are handed over by moving them into Defer(): their
+     * destructor runs once they retire. Raw handles can be given as well, through the Defer<Type>() methods. Anything still queued when the
+     * DeletionQueue is destroyed is destroyed immediately, so the device must be idle by then. All methods are thread-safe.
+     * \ingroup Synchronization
+     */
+    class VPR_API DeletionQueue
+    {
+        DeletionQueue(const DeletionQueue&) = delete;
+        DeletionQueue& operator=(const DeletionQueue&) = delete;
+    public:
+
+        DeletionQueue(const VkDevice& dvc);
+        ~DeletionQueue();
+        DeletionQueue(DeletionQueue&& other) noexcept;
+        DeletionQueue& operator=(DeletionQueue&& other) noexcept;
+
+        /**Takes ownership of a movable object, destroying it once retire_value has been reached.*/
+        template<typename T>
+        void Defer(T&& object, const uint64_t retire_value);
+        /**Calls the given function once retire_value has been reached, for objects that need more than their destructor to be released.*/
+        void DeferCall(std::function<void()> destroy_fn, const uint64_t retire_value);
+
+        /**Raw handles are deferred through methods named for their type, as non-dispatchable handles are all the same integer type on 32-bit targets.*/
+        void DeferBuffer(const VkBuffer buffer, const uint64_t retire_value);
+        void DeferBufferView(const VkBufferView view, const uint64_t retire_value);
+        void DeferImage(const VkImage image, const uint64_t retire_value);
+        void DeferImageView(const VkImageView view, const uint64_t retire_value);
+        void DeferSampler(const VkSampler sampler, const uint64_t retire_value);
+        void DeferMemory(const VkDeviceMemory memory, const uint64_t retire_value);
+        void DeferPipeline(const VkPipeline pipeline, const uint64_t retire_value);
+        void DeferPipelineLayout(const VkPipelineLayout layout, const uint64_t retire_value);
+        void DeferShaderModule(const VkShaderModule shader_module, const uint64_t retire_value);
+        void DeferFramebuffer(const VkFramebuffer framebuffer, const uint64_t retire_value);
+        void DeferRenderPass(const VkRenderPass renderpass, const uint64_t retire_value);
+        void DeferDescriptorSetLayout(const VkDescriptorSetLayout layout, const uint64_t retire_value);
+        void DeferDescriptorPool(const VkDescriptorPool pool, const uint64_t retire_value);
+        /**Descriptor sets retiring in the same call to Collect() are freed with one vkFreeDescriptorSets call per pool. The pool must have been
+         * created with VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT.
+         */
+        void DeferDescriptorSet(const VkDescriptorPool parent_pool, const VkDescriptorSet descriptor_set, const uint64_t retire_value);
+
+        /**Destroys everything with a retire value less than or equal to the given value. Returns the quantity of objects destroyed.*/
+        size_t Collect(const uint64_t completed_value);
+        /**Collects using the current value of the given timeline semaphore.*/
+        size_t Collect(const Semaphore& timeline_semaphore);
+        /**Destroys everything in the queue, regardless of retire value. Only safe once the device is idle.*/
+        size_t Flush();
+
+        size_t NumPending() const;
+
+    private:
+        void deferObject(void* object, void(*deleter)(void*), const uint64_t retire_value);
+        std::unique_ptr<DeletionQueueImpl> impl;
+    };
+
+    template<typename T>
+    inline void DeletionQueue::Defer(T&& object, const uint64_t retire_value)
+    {
+        static_assert(!std::is_lvalue_reference<T>::value, "Objects must be moved into the DeletionQueue.");
+        using object_t = std::decay_t<T>;
+        static_assert(!std::is_pointer<object_t>::value && !std::is_integral<object_t>::value, "Raw handles must be deferred with the Defer<Type>() methods.");
+        deferObject(new object_t(std::move(object)), [](void* ptr) { delete reinterpret_cast<object_t*>(ptr); }, retire_value);
+    }
+
+}
+
+#endif //!VPR_DELETION_QUEUE_HPP
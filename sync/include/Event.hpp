@@ -12,9 +12,10 @@ namespace vpr
      * on the host, but cannot be waited on by the host. However, they can be waited on by the device - but the device
      * cannot retrieve their status (it can however, set or reset the event).
      * 
-     * vkCmdWaitEvent also takes six more parameters than what is presented here - representing various memory barriers
-     * to execute once the event clears. These would've added clutter to the function signature though, so that is left
-     * unimplemented. Instead, the pure wait-only interpretation of that function is presented through this class interface.
+     * Events can be used as "split barriers": Set() the event once the producing work has been recorded, record unrelated work,
+     * then Wait() with the memory, buffer and image barriers the consumer needs right before the consuming work. Unlike a
+     * vkCmdPipelineBarrier between producer and consumer, the work in between doesn't have to stall until the barrier resolves.
+     * WaitMultiple() waits on several events (e.g, one per producing pass) with one vkCmdWaitEvents call.
      * 
      * Events are best used to synchronize and regulate events occuring at different stages of the same pipeline, unlike
      * semaphores which work well across queues and command submissions (though they could be used like this, as well, I believe).
@@ -54,6 +55,20 @@ namespace vpr
         */
         void Wait(const VkCommandBuffer& cmd, const VkPipelineStageFlags potential_signal_stages, 
             const VkPipelineStageFlags stages_to_wait_at);
+        /**Waits for event when executing given command buffer, then executes the given barriers. Access masks in the barriers must be 
+         * available in the source stages the event was set at, and visible to the destination stages waiting on it.
+         */
+        void Wait(const VkCommandBuffer& cmd, const VkPipelineStageFlags potential_signal_stages, const VkPipelineStageFlags stages_to_wait_at,
+            const uint32_t num_memory_barriers, const VkMemoryBarrier* memory_barriers, const uint32_t num_buffer_barriers, 
+            const VkBufferMemoryBarrier* buffer_barriers, const uint32_t num_image_barriers, const VkImageMemoryBarrier* image_barriers);
+
+        /**Waits on several events at once, with one vkCmdWaitEvents call. Barriers given execute once all of the events have been set.
+         * \param potential_signal_stages: union of the stages any of the events can be set in.
+         */
+        static void WaitMultiple(const VkCommandBuffer& cmd, const uint32_t num_events, const VkEvent* events, const VkPipelineStageFlags potential_signal_stages,
+            const VkPipelineStageFlags stages_to_wait_at, const uint32_t num_memory_barriers = 0u, const VkMemoryBarrier* memory_barriers = nullptr,
+            const uint32_t num_buffer_barriers = 0u, const VkBufferMemoryBarrier* buffer_barriers = nullptr, const uint32_t num_image_barriers = 0u,
+            const VkImageMemoryBarrier* image_barriers = nullptr);
 
     private:
         VkDevice device{ VK_NULL_HANDLE };
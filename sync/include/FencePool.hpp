@@ -0,0 +1,66 @@
+#pragma once
+#ifndef VPR_FENCE_POOL_HPP
+#define VPR_FENCE_POOL_HPP
+#include "vpr_stdafx.h"
+#include "ForwardDecl.hpp"
+#include <memory>
+
+namespace vpr
+{
+
+    struct FencePoolImpl;
+
+    /**Usage counters for a FencePool. Outstanding fences are those acquired and not yet released: if this keeps climbing, fences are being leaked.
+     * \ingroup Synchronization
+     */
+    struct VPR_API FencePoolStats
+    {
+        uint64_t NumCreated{ 0u };
+        uint64_t NumAcquired{ 0u };
+        uint64_t NumReleased{ 0u };
+        uint64_t NumOutstanding{ 0u };
+        uint64_t PeakOutstanding{ 0u };
+        /**Quantity of vkResetFences calls made: compare to NumReleased to see how well resets are being batched.*/
+        uint64_t NumResetCalls{ 0u };
+    };
+
+    /**A FencePool recycles fences, so that code submitting work regularly (uploads, per-frame submissions) doesn't create and destroy a fence 
+     * each time. Acquire() always returns an unsignaled fence. Released fences may still be signaled: they're held until the next call to 
+     * ResetReleased(), or until Acquire() runs out of ready fences, and then reset all at once with a single vkResetFences call.
+     * 
+     * Fences must not be released while a submission that will signal them is still pending, so only release a fence after waiting on it
+     * (or after it's been otherwise confirmed as signaled). All fences created by the pool are destroyed along with it, including any
+     * that were never released. Acquire() and Release() are thread-safe.
+     * \ingroup Synchronization
+     */
+    class VPR_API FencePool
+    {
+        FencePool(const FencePool&) = delete;
+        FencePool& operator=(const FencePool&) = delete;
+    public:
+
+        /**\param initial_size Quantity of fences to create up-front.*/
+        FencePool(const VkDevice& dvc, const size_t initial_size = 0u);
+        ~FencePool();
+        FencePool(FencePool&& other) noexcept;
+        FencePool& operator=(FencePool&& other) noexcept;
+
+        /**Returns an unsignaled fence, creating one only when no released fences are available.*/
+        VkFence Acquire();
+        /**Returns fences to the pool, to be reset on the next call to ResetReleased().*/
+        void Release(const VkFence fence);
+        void Release(const uint32_t num_fences, const VkFence* fences);
+        /**Resets all fences released since the last reset with one vkResetFences call, making them available to Acquire(). 
+         * Calling this once per frame keeps the reset off the path of Acquire().
+         */
+        void ResetReleased();
+
+        FencePoolStats Stats() const;
+
+    private:
+        std::unique_ptr<FencePoolImpl> impl;
+    };
+
+}
+
+#endif //!VPR_FENCE_POOL_HPP
@@ -3,6 +3,7 @@
 #define VPR_SEMAPHORE_HPP
 #include "vpr_stdafx.h"
 #include "ForwardDecl.hpp"
+#include <limits>
 
 namespace vpr
 {
@@ -23,6 +24,14 @@ namespace vpr
      * array of VkSubmitInfo) must have their usage synchronized (in case one reference ends up in a signal for one submission, and a wait 
      * for another submission, but lack of synchronization submits the wait submission before the signal submission).
      * 
+     * Semaphores can instead be created in timeline mode, which requires the timelineSemaphore feature to be enabled on the device (even on
+     * Vulkan 1.2, where it's core but still optional). Device enables it when the API version is 1.2 or VK_KHR_timeline_semaphore is enabled,
+     * and the physical device supports it: check Device::TimelineSemaphoresEnabled() before creating one. Timeline semaphores hold
+     * a monotonically increasing 64-bit value, which can be signaled and waited on from both the host and the device, and queried by the host. 
+     * Submissions signal/wait on a value by chaining a VkTimelineSemaphoreSubmitInfo to VkSubmitInfo. A single timeline semaphore per queue, 
+     * incremented once per submission, can replace a set of per-frame fences: waiting for a value (or comparing it to CurrentValue()) tells 
+     * you that all submissions up to that point have completed.
+     * 
      * \ingroup Synchronization
      */
     class VPR_API Semaphore
@@ -31,16 +40,37 @@ namespace vpr
         Semaphore& operator=(const Semaphore&) = delete;
     public:
     
+        /**Creates a binary semaphore.*/
         Semaphore(const VkDevice& dvc);
+        /**Creates a timeline semaphore, with the given initial value.*/
+        Semaphore(const VkDevice& dvc, const uint64_t initial_value);
         ~Semaphore();
         Semaphore(Semaphore&& other) noexcept;
         Semaphore& operator=(Semaphore&& other) noexcept;
 
+        /**Sets the timeline value from the host. Value must be greater than the current value, and than any pending signal operations.*/
+        void Signal(const uint64_t value);
+        /**Blocks until the timeline value is greater than or equal to the value given. Returns VK_SUCCESS or VK_TIMEOUT.
+         * \param timeout Timeout in nanoseconds: 0 can be used to poll the semaphore.
+         */
+        VkResult Wait(const uint64_t value, const uint64_t timeout = std::numeric_limits<uint64_t>::max()) const;
+        /**Queries the current timeline value.*/
+        uint64_t CurrentValue() const;
+
+        /**Waits until every timeline semaphore given has reached the value at the same index in the values array.*/
+        static VkResult WaitAll(const VkDevice& dvc, const uint32_t count, const VkSemaphore* semaphores, const uint64_t* values, 
+            const uint64_t timeout = std::numeric_limits<uint64_t>::max());
+        /**Waits until at least one timeline semaphore given has reached the value at the same index in the values array.*/
+        static VkResult WaitAny(const VkDevice& dvc, const uint32_t count, const VkSemaphore* semaphores, const uint64_t* values,
+            const uint64_t timeout = std::numeric_limits<uint64_t>::max());
+
+        bool IsTimeline() const noexcept;
         const VkSemaphore& vkHandle() const noexcept;
 
     private:
         VkDevice device{ VK_NULL_HANDLE };
         VkSemaphore handle{ VK_NULL_HANDLE };
+        VkSemaphoreType type{ VK_SEMAPHORE_TYPE_BINARY };
     };
 
 }
@@ -0,0 +1,58 @@
+#pragma once
+#ifndef VPR_SEMAPHORE_POOL_HPP
+#define VPR_SEMAPHORE_POOL_HPP
+#include "vpr_stdafx.h"
+#include "ForwardDecl.hpp"
+#include <memory>
+
+namespace vpr
+{
+
+    struct SemaphorePoolImpl;
+
+    /**Usage counters for a SemaphorePool. Outstanding semaphores are those acquired and not yet released: if this keeps climbing, semaphores are being leaked.
+     * \ingroup Synchronization
+     */
+    struct VPR_API SemaphorePoolStats
+    {
+        uint64_t NumCreated{ 0u };
+        uint64_t NumAcquired{ 0u };
+        uint64_t NumReleased{ 0u };
+        uint64_t NumOutstanding{ 0u };
+        uint64_t PeakOutstanding{ 0u };
+    };
+
+    /**A SemaphorePool recycles binary semaphores, so that per-frame and per-upload synchronization doesn't create and destroy semaphores each time.
+     * 
+     * Binary semaphores have no reset operation: they return to the unsignaled state when a wait on them executes. A semaphore can thus only be
+     * released once the submission waiting on it has completed (e.g, once a fence for that submission has signaled), or if it was never
+     * signaled at all. All semaphores created by the pool are destroyed along with it, including any that were never released. 
+     * Acquire() and Release() are thread-safe.
+     * \ingroup Synchronization
+     */
+    class VPR_API SemaphorePool
+    {
+        SemaphorePool(const SemaphorePool&) = delete;
+        SemaphorePool& operator=(const SemaphorePool&) = delete;
+    public:
+
+        /**\param initial_size Quantity of semaphores to create up-front.*/
+        SemaphorePool(const VkDevice& dvc, const size_t initial_size = 0u);
+        ~SemaphorePool();
+        SemaphorePool(SemaphorePool&& other) noexcept;
+        SemaphorePool& operator=(SemaphorePool&& other) noexcept;
+
+        /**Returns an unsignaled binary semaphore, creating one only when no released semaphores are available.*/
+        VkSemaphore Acquire();
+        void Release(const VkSemaphore semaphore);
+        void Release(const uint32_t num_semaphores, const VkSemaphore* semaphores);
+
+        SemaphorePoolStats Stats() const;
+
+    private:
+        std::unique_ptr<SemaphorePoolImpl> impl;
+    };
+
+}
+
+#endif //!VPR_SEMAPHORE_POOL_HPP
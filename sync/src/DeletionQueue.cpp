@@ -0,0 +1,332 @@
+#include "DeletionQueue.hpp"
+#include "Semaphore.hpp"
+#include "vkAssert.hpp"
+#include <map>
+#include <unordered_map>
+#include <vector>
+#include <mutex>
+#include <limits>
+
+namespace vpr
+{
+
+    struct deferred_object_t
+    {
+        void* object;
+        void(*deleter)(void*);
+    };
+
+    // Everything retiring at one value, grouped by type so that collection can destroy objects in dependency order
+    struct retire_batch_t
+    {
+        void append(retire_batch_t&& other);
+        size_t size() const noexcept;
+
+        std::vector<deferred_object_t> objects;
+        std::vector<std::function<void()>> functions;
+        std::unordered_map<VkDescriptorPool, std::vector<VkDescriptorSet>> descriptorSets;
+        std::vector<VkFramebuffer> framebuffers;
+        std::vector<VkPipeline> pipelines;
+        std::vector<VkImageView> imageViews;
+        std::vector<VkBufferView> bufferViews;
+        std::vector<VkSampler> samplers;
+        std::vector<VkShaderModule> shaderModules;
+        std::vector<VkPipelineLayout> pipelineLayouts;
+        std::vector<VkDescriptorSetLayout> setLayouts;
+        std::vector<VkDescriptorPool> descriptorPools;
+        std::vector<VkRenderPass> renderpasses;
+        std::vector<VkImage> images;
+        std::vector<VkBuffer> buffers;
+        std::vector<VkDeviceMemory> memory;
+    };
+
+    template<typename T>
+    static void append_vector(std::vector<T>& dst, std::vector<T>& src)
+    {
+        if (dst.empty())
+        {
+            dst = std::move(src);
+        }
+        else
+        {
+            dst.insert(dst.end(), std::make_move_iterator(src.begin()), std::make_move_iterator(src.end()));
+        }
+    }
+
+    void retire_batch_t::append(retire_batch_t&& other)
+    {
+        append_vector(objects, other.objects);
+        append_vector(functions, other.functions);
+        for (auto& pool_sets : other.descriptorSets)
+        {
+            append_vector(descriptorSets[pool_sets.first], pool_sets.second);
+        }
+        append_vector(framebuffers, other.framebuffers);
+        append_vector(pipelines, other.pipelines);
+        append_vector(imageViews, other.imageViews);
+        append_vector(bufferViews, other.bufferViews);
+        append_vector(samplers, other.samplers);
+        append_vector(shaderModules, other.shaderModules);
+        append_vector(pipelineLayouts, other.pipelineLayouts);
+        append_vector(setLayouts, other.setLayouts);
+        append_vector(descriptorPools, other.descriptorPools);
+        append_vector(renderpasses, other.renderpasses);
+        append_vector(images, other.images);
+        append_vector(buffers, other.buffers);
+        append_vector(memory, other.memory);
+    }
+
+    size_t retire_batch_t::size() const noexcept
+    {
+        size_t result = objects.size() + functions.size() + framebuffers.size() + pipelines.size() + imageViews.size() + bufferViews.size() +
+            samplers.size() + shaderModules.size() + pipelineLayouts.size() + setLayouts.size() + descriptorPools.size() + renderpasses.size() +
+            images.size() + buffers.size() + memory.size();
+        for (const auto& pool_sets : descriptorSets)
+        {
+            result += pool_sets.second.size();
+        }
+        return result;
+    }
+
+    struct DeletionQueueImpl
+    {
+        DeletionQueueImpl(const VkDevice& dvc) : device(dvc) {}
+        ~DeletionQueueImpl();
+        size_t collect(const uint64_t completed_value);
+        void destroy(retire_batch_t& batch);
+        template<typename T>
+        void deferHandle(std::vector<T> retire_batch_t::*list, const T handle, const uint64_t retire_value);
+
+        VkDevice device{ VK_NULL_HANDLE };
+        mutable std::mutex mutex;
+        std::map<uint64_t, retire_batch_t> batches;
+        size_t numPending{ 0u };
+    };
+
+    template<typename T>
+    void DeletionQueueImpl::deferHandle(std::vector<T> retire_batch_t::*list, const T handle, const uint64_t retire_value)
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        (batches[retire_value].*list).emplace_back(handle);
+        ++numPending;
+    }
+
+    DeletionQueueImpl::~DeletionQueueImpl()
+    {
+        collect(std::numeric_limits<uint64_t>::max());
+    }
+
+    size_t DeletionQueueImpl::collect(const uint64_t completed_value)
+    {
+        retire_batch_t retired;
+        {
+            // Only hold the lock long enough to take the retired batches: destructors may be expensive, or defer more objects themselves
+            std::lock_guard<std::mutex> guard(mutex);
+            auto end_iter = batches.upper_bound(completed_value);
+            for (auto iter = batches.begin(); iter != end_iter; ++iter)
+            {
+                retired.append(std::move(iter->second));
+            }
+            batches.erase(batches.begin(), end_iter);
+        }
+
+        const size_t num_retired = retired.size();
+        destroy(retired);
+
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+            numPending -= num_retired;
+        }
+
+        return num_retired;
+    }
+
+    void DeletionQueueImpl::destroy(retire_batch_t& batch)
+    {
+        for (auto& object : batch.objects)
+        {
+            object.deleter(object.object);
+        }
+        for (auto& fn : batch.functions)
+        {
+            fn();
+        }
+        for (auto& pool_sets : batch.descriptorSets)
+        {
+            VkResult result = vkFreeDescriptorSets(device, pool_sets.first, static_cast<uint32_t>(pool_sets.second.size()), pool_sets.second.data());
+            VkAssert(result);
+        }
+        for (auto& framebuffer : batch.framebuffers)
+        {
+            vkDestroyFramebuffer(device, framebuffer, nullptr);
+        }
+        for (auto& pipeline : batch.pipelines)
+        {
+            vkDestroyPipeline(device, pipeline, nullptr);
+        }
+        for (auto& view : batch.imageViews)
+        {
+            vkDestroyImageView(device, view, nullptr);
+        }
+        for (auto& view : batch.bufferViews)
+        {
+            vkDestroyBufferView(device, view, nullptr);
+        }
+        for (auto& sampler : batch.samplers)
+        {
+            vkDestroySampler(device, sampler, nullptr);
+        }
+        for (auto& shader_module : batch.shaderModules)
+        {
+            vkDestroyShaderModule(device, shader_module, nullptr);
+        }
+        for (auto& layout : batch.pipelineLayouts)
+        {
+            vkDestroyPipelineLayout(device, layout, nullptr);
+        }
+        for (auto& layout : batch.setLayouts)
+        {
+            vkDestroyDescriptorSetLayout(device, layout, nullptr);
+        }
+        for (auto& pool : batch.descriptorPools)
+        {
+            vkDestroyDescriptorPool(device, pool, nullptr);
+        }
+        for (auto& renderpass : batch.renderpasses)
+        {
+            vkDestroyRenderPass(device, renderpass, nullptr);
+        }
+        for (auto& image : batch.images)
+        {
+            vkDestroyImage(device, image, nullptr);
+        }
+        for (auto& buffer : batch.buffers)
+        {
+            vkDestroyBuffer(device, buffer, nullptr);
+        }
+        for (auto& memory : batch.memory)
+        {
+            vkFreeMemory(device, memory, nullptr);
+        }
+    }
+
+    DeletionQueue::DeletionQueue(const VkDevice& dvc) : impl(std::make_unique<DeletionQueueImpl>(dvc)) {}
+
+    DeletionQueue::~DeletionQueue() {}
+
+    DeletionQueue::DeletionQueue(DeletionQueue&& other) noexcept : impl(std::move(other.impl)) {}
+
+    DeletionQueue& DeletionQueue::operator=(DeletionQueue&& other) noexcept
+    {
+        impl = std::move(other.impl);
+        return *this;
+    }
+
+    void DeletionQueue::deferObject(void* object, void(*deleter)(void*), const uint64_t retire_value)
+    {
+        std::lock_guard<std::mutex> guard(impl->mutex);
+        impl->batches[retire_value].objects.emplace_back(deferred_object_t{ object, deleter });
+        ++impl->numPending;
+    }
+
+    void DeletionQueue::DeferCall(std::function<void()> destroy_fn, const uint64_t retire_value)
+    {
+        std::lock_guard<std::mutex> guard(impl->mutex);
+        impl->batches[retire_value].functions.emplace_back(std::move(destroy_fn));
+        ++impl->numPending;
+    }
+
+    void DeletionQueue::DeferBuffer(const VkBuffer buffer, const uint64_t retire_value)
+    {
+        impl->deferHandle(&retire_batch_t::buffers, buffer, retire_value);
+    }
+
+    void DeletionQueue::DeferBufferView(const VkBufferView view, const uint64_t retire_value)
+    {
+        impl->deferHandle(&retire_batch_t::bufferViews, view, retire_value);
+    }
+
+    void DeletionQueue::DeferImage(const VkImage image, const uint64_t retire_value)
+    {
+        impl->deferHandle(&retire_batch_t::images, image, retire_value);
+    }
+
+    void DeletionQueue::DeferImageView(const VkImageView view, const uint64_t retire_value)
+    {
+        impl->deferHandle(&retire_batch_t::imageViews, view, retire_value);
+    }
+
+    void DeletionQueue::DeferSampler(const VkSampler sampler, const uint64_t retire_value)
+    {
+        impl->deferHandle(&retire_batch_t::samplers, sampler, retire_value);
+    }
+
+    void DeletionQueue::DeferMemory(const VkDeviceMemory memory, const uint64_t retire_value)
+    {
+        impl->deferHandle(&retire_batch_t::memory, memory, retire_value);
+    }
+
+    void DeletionQueue::DeferPipeline(const VkPipeline pipeline, const uint64_t retire_value)
+    {
+        impl->deferHandle(&retire_batch_t::pipelines, pipeline, retire_value);
+    }
+
+    void DeletionQueue::DeferPipelineLayout(const VkPipelineLayout layout, const uint64_t retire_value)
+    {
+        impl->deferHandle(&retire_batch_t::pipelineLayouts, layout, retire_value);
+    }
+
+    void DeletionQueue::DeferShaderModule(const VkShaderModule shader_module, const uint64_t retire_value)
+    {
+        impl->deferHandle(&retire_batch_t::shaderModules, shader_module, retire_value);
+    }
+
+    void DeletionQueue::DeferFramebuffer(const VkFramebuffer framebuffer, const uint64_t retire_value)
+    {
+        impl->deferHandle(&retire_batch_t::framebuffers, framebuffer, retire_value);
+    }
+
+    void DeletionQueue::DeferRenderPass(const VkRenderPass renderpass, const uint64_t retire_value)
+    {
+        impl->deferHandle(&retire_batch_t::renderpasses, renderpass, retire_value);
+    }
+
+    void DeletionQueue::DeferDescriptorSetLayout(const VkDescriptorSetLayout layout, const uint64_t retire_value)
+    {
+        impl->deferHandle(&retire_batch_t::setLayouts, layout, retire_value);
+    }
+
+    void DeletionQueue::DeferDescriptorPool(const VkDescriptorPool pool, const uint64_t retire_value)
+    {
+        impl->deferHandle(&retire_batch_t::descriptorPools, pool, retire_value);
+    }
+
+    void DeletionQueue::DeferDescriptorSet(const VkDescriptorPool parent_pool, const VkDescriptorSet descriptor_set, const uint64_t retire_value)
+    {
+        std::lock_guard<std::mutex> guard(impl->mutex);
+        impl->batches[retire_value].descriptorSets[parent_pool].emplace_back(descriptor_set);
+        ++impl->numPending;
+    }
+
+    size_t DeletionQueue::Collect(const uint64_t completed_value)
+    {
+        return impl->collect(completed_value);
+    }
+
+    size_t DeletionQueue::Collect(const Semaphore& timeline_semaphore)
+    {
+        return impl->collect(timeline_semaphore.CurrentValue());
+    }
+
+    size_t DeletionQueue::Flush()
+    {
+        return impl->collect(std::numeric_limits<uint64_t>::max());
+    }
+
+    size_t DeletionQueue::NumPending() const
+    {
+        std::lock_guard<std::mutex> guard(impl->mutex);
+        return impl->numPending;
+    }
+
+}
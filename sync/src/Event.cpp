@@ -80,5 +80,21 @@ namespace vpr
     {
         vkCmdWaitEvents(cmd, 1, &handle, potential_signal_stages, stages_to_wait_at, 0, nullptr, 0, nullptr, 0, nullptr);
     }
+
+    void Event::Wait(const VkCommandBuffer& cmd, const VkPipelineStageFlags potential_signal_stages, const VkPipelineStageFlags stages_to_wait_at,
+        const uint32_t num_memory_barriers, const VkMemoryBarrier* memory_barriers, const uint32_t num_buffer_barriers, 
+        const VkBufferMemoryBarrier* buffer_barriers, const uint32_t num_image_barriers, const VkImageMemoryBarrier* image_barriers)
+    {
+        vkCmdWaitEvents(cmd, 1, &handle, potential_signal_stages, stages_to_wait_at, num_memory_barriers, memory_barriers, num_buffer_barriers,
+            buffer_barriers, num_image_barriers, image_barriers);
+    }
+
+    void Event::WaitMultiple(const VkCommandBuffer& cmd, const uint32_t num_events, const VkEvent* events, const VkPipelineStageFlags potential_signal_stages,
+        const VkPipelineStageFlags stages_to_wait_at, const uint32_t num_memory_barriers, const VkMemoryBarrier* memory_barriers, const uint32_t num_buffer_barriers,
+        const VkBufferMemoryBarrier* buffer_barriers, const uint32_t num_image_barriers, const VkImageMemoryBarrier* image_barriers)
+    {
+        vkCmdWaitEvents(cmd, num_events, events, potential_signal_stages, stages_to_wait_at, num_memory_barriers, memory_barriers, num_buffer_barriers,
+            buffer_barriers, num_image_barriers, image_barriers);
+    }
     
 }
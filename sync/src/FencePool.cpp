@@ -0,0 +1,130 @@
+#include "FencePool.hpp"
+#include "vkAssert.hpp"
+#include "CreateInfoBase.hpp"
+#include <vector>
+#include <mutex>
+#include <algorithm>
+#include <cassert>
+
+namespace vpr
+{
+
+    struct FencePoolImpl
+    {
+        FencePoolImpl(const VkDevice& dvc, const size_t initial_size);
+        ~FencePoolImpl();
+        VkFence createFence();
+        void resetReleased();
+
+        VkDevice device{ VK_NULL_HANDLE };
+        mutable std::mutex mutex;
+        std::vector<VkFence> allFences;
+        std::vector<VkFence> available;
+        std::vector<VkFence> released;
+        FencePoolStats stats;
+    };
+
+    FencePoolImpl::FencePoolImpl(const VkDevice& dvc, const size_t initial_size) : device(dvc)
+    {
+        available.reserve(initial_size);
+        for (size_t i = 0; i < initial_size; ++i)
+        {
+            available.emplace_back(createFence());
+        }
+    }
+
+    FencePoolImpl::~FencePoolImpl()
+    {
+        for (auto& fence : allFences)
+        {
+            vkDestroyFence(device, fence, nullptr);
+        }
+    }
+
+    VkFence FencePoolImpl::createFence()
+    {
+        VkFence result_fence{ VK_NULL_HANDLE };
+        VkResult result = vkCreateFence(device, &vk_fence_create_info_base, nullptr, &result_fence);
+        VkAssert(result);
+        allFences.emplace_back(result_fence);
+        ++stats.NumCreated;
+        return result_fence;
+    }
+
+    void FencePoolImpl::resetReleased()
+    {
+        if (released.empty())
+        {
+            return;
+        }
+        VkResult result = vkResetFences(device, static_cast<uint32_t>(released.size()), released.data());
+        VkAssert(result);
+        ++stats.NumResetCalls;
+        available.insert(available.end(), released.cbegin(), released.cend());
+        released.clear();
+    }
+
+    FencePool::FencePool(const VkDevice& dvc, const size_t initial_size) : impl(std::make_unique<FencePoolImpl>(dvc, initial_size)) {}
+
+    FencePool::~FencePool() {}
+
+    FencePool::FencePool(FencePool&& other) noexcept : impl(std::move(other.impl)) {}
+
+    FencePool& FencePool::operator=(FencePool&& other) noexcept
+    {
+        impl = std::move(other.impl);
+        return *this;
+    }
+
+    VkFence FencePool::Acquire()
+    {
+        std::lock_guard<std::mutex> guard(impl->mutex);
+        if (impl->available.empty())
+        {
+            impl->resetReleased();
+        }
+
+        VkFence result{ VK_NULL_HANDLE };
+        if (!impl->available.empty())
+        {
+            result = impl->available.back();
+            impl->available.pop_back();
+        }
+        else
+        {
+            result = impl->createFence();
+        }
+
+        ++impl->stats.NumAcquired;
+        ++impl->stats.NumOutstanding;
+        impl->stats.PeakOutstanding = std::max(impl->stats.PeakOutstanding, impl->stats.NumOutstanding);
+        return result;
+    }
+
+    void FencePool::Release(const VkFence fence)
+    {
+        Release(1u, &fence);
+    }
+
+    void FencePool::Release(const uint32_t num_fences, const VkFence* fences)
+    {
+        std::lock_guard<std::mutex> guard(impl->mutex);
+        assert(impl->stats.NumOutstanding >= num_fences);
+        impl->released.insert(impl->released.end(), fences, fences + num_fences);
+        impl->stats.NumReleased += num_fences;
+        impl->stats.NumOutstanding -= num_fences;
+    }
+
+    void FencePool::ResetReleased()
+    {
+        std::lock_guard<std::mutex> guard(impl->mutex);
+        impl->resetReleased();
+    }
+
+    FencePoolStats FencePool::Stats() const
+    {
+        std::lock_guard<std::mutex> guard(impl->mutex);
+        return impl->stats;
+    }
+
+}
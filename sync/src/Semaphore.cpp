@@ -1,6 +1,7 @@
 #include "Semaphore.hpp"
 #include "vkAssert.hpp"
 #include "CreateInfoBase.hpp"
+#include <cassert>
 
 namespace vpr
 {
@@ -10,6 +11,16 @@ namespace vpr
         vkCreateSemaphore(device, &vk_semaphore_create_info_base, nullptr, &handle);
     }
 
+    Semaphore::Semaphore(const VkDevice& dvc, const uint64_t initial_value) : device(dvc), type(VK_SEMAPHORE_TYPE_TIMELINE)
+    {
+        VkSemaphoreTypeCreateInfo type_info = vk_semaphore_type_create_info_base;
+        type_info.initialValue = initial_value;
+        VkSemaphoreCreateInfo create_info = vk_semaphore_create_info_base;
+        create_info.pNext = &type_info;
+        VkResult result = vkCreateSemaphore(device, &create_info, nullptr, &handle);
+        VkAssert(result);
+    }
+
     Semaphore::~Semaphore()
     {
         if (handle != VK_NULL_HANDLE)
@@ -18,7 +29,7 @@ namespace vpr
         }
     }
 
-    Semaphore::Semaphore(Semaphore&& other) noexcept : handle(std::move(other.handle)), device(std::move(other.device))
+    Semaphore::Semaphore(Semaphore&& other) noexcept : handle(std::move(other.handle)), device(std::move(other.device)), type(std::move(other.type))
     {
         other.handle = VK_NULL_HANDLE;
     }
@@ -28,9 +39,66 @@ namespace vpr
         handle = std::move(other.handle);
         other.handle = VK_NULL_HANDLE;
         device = std::move(other.device);
+        type = std::move(other.type);
         return *this;
     }
 
+    void Semaphore::Signal(const uint64_t value)
+    {
+        assert(type == VK_SEMAPHORE_TYPE_TIMELINE);
+        VkSemaphoreSignalInfo signal_info = vk_semaphore_signal_info_base;
+        signal_info.semaphore = handle;
+        signal_info.value = value;
+        VkResult result = vkSignalSemaphore(device, &signal_info);
+        VkAssert(result);
+    }
+
+    VkResult Semaphore::Wait(const uint64_t value, const uint64_t timeout) const
+    {
+        assert(type == VK_SEMAPHORE_TYPE_TIMELINE);
+        return WaitAll(device, 1u, &handle, &value, timeout);
+    }
+
+    uint64_t Semaphore::CurrentValue() const
+    {
+        assert(type == VK_SEMAPHORE_TYPE_TIMELINE);
+        uint64_t value = 0u;
+        VkResult result = vkGetSemaphoreCounterValue(device, handle, &value);
+        VkAssert(result);
+        return value;
+    }
+
+    static VkResult wait_semaphores(const VkDevice& dvc, const VkSemaphoreWaitFlags flags, const uint32_t count, const VkSemaphore* semaphores, 
+        const uint64_t* values, const uint64_t timeout)
+    {
+        VkSemaphoreWaitInfo wait_info = vk_semaphore_wait_info_base;
+        wait_info.flags = flags;
+        wait_info.semaphoreCount = count;
+        wait_info.pSemaphores = semaphores;
+        wait_info.pValues = values;
+        VkResult result = vkWaitSemaphores(dvc, &wait_info, timeout);
+        if (result != VK_TIMEOUT)
+        {
+            VkAssert(result);
+        }
+        return result;
+    }
+
+    VkResult Semaphore::WaitAll(const VkDevice& dvc, const uint32_t count, const VkSemaphore* semaphores, const uint64_t* values, const uint64_t timeout)
+    {
+        return wait_semaphores(dvc, 0, count, semaphores, values, timeout);
+    }
+
+    VkResult Semaphore::WaitAny(const VkDevice& dvc, const uint32_t count, const VkSemaphore* semaphores, const uint64_t* values, const uint64_t timeout)
+    {
+        return wait_semaphores(dvc, VK_SEMAPHORE_WAIT_ANY_BIT, count, semaphores, values, timeout);
+    }
+
+    bool Semaphore::IsTimeline() const noexcept
+    {
+        return type == VK_SEMAPHORE_TYPE_TIMELINE;
+    }
+
     const VkSemaphore& Semaphore::vkHandle() const noexcept {
         return handle;
     }
@@ -0,0 +1,104 @@
+#include "SemaphorePool.hpp"
+#include "vkAssert.hpp"
+#include "CreateInfoBase.hpp"
+#include <vector>
+#include <mutex>
+#include <algorithm>
+#include <cassert>
+
+namespace vpr
+{
+
+    struct SemaphorePoolImpl
+    {
+        SemaphorePoolImpl(const VkDevice& dvc, const size_t initial_size);
+        ~SemaphorePoolImpl();
+        VkSemaphore createSemaphore();
+
+        VkDevice device{ VK_NULL_HANDLE };
+        mutable std::mutex mutex;
+        std::vector<VkSemaphore> allSemaphores;
+        std::vector<VkSemaphore> available;
+        SemaphorePoolStats stats;
+    };
+
+    SemaphorePoolImpl::SemaphorePoolImpl(const VkDevice& dvc, const size_t initial_size) : device(dvc)
+    {
+        available.reserve(initial_size);
+        for (size_t i = 0; i < initial_size; ++i)
+        {
+            available.emplace_back(createSemaphore());
+        }
+    }
+
+    SemaphorePoolImpl::~SemaphorePoolImpl()
+    {
+        for (auto& semaphore : allSemaphores)
+        {
+            vkDestroySemaphore(device, semaphore, nullptr);
+        }
+    }
+
+    VkSemaphore SemaphorePoolImpl::createSemaphore()
+    {
+        VkSemaphore result_semaphore{ VK_NULL_HANDLE };
+        VkResult result = vkCreateSemaphore(device, &vk_semaphore_create_info_base, nullptr, &result_semaphore);
+        VkAssert(result);
+        allSemaphores.emplace_back(result_semaphore);
+        ++stats.NumCreated;
+        return result_semaphore;
+    }
+
+    SemaphorePool::SemaphorePool(const VkDevice& dvc, const size_t initial_size) : impl(std::make_unique<SemaphorePoolImpl>(dvc, initial_size)) {}
+
+    SemaphorePool::~SemaphorePool() {}
+
+    SemaphorePool::SemaphorePool(SemaphorePool&& other) noexcept : impl(std::move(other.impl)) {}
+
+    SemaphorePool& SemaphorePool::operator=(SemaphorePool&& other) noexcept
+    {
+        impl = std::move(other.impl);
+        return *this;
+    }
+
+    VkSemaphore SemaphorePool::Acquire()
+    {
+        std::lock_guard<std::mutex> guard(impl->mutex);
+        VkSemaphore result{ VK_NULL_HANDLE };
+        if (!impl->available.empty())
+        {
+            result = impl->available.back();
+            impl->available.pop_back();
+        }
+        else
+        {
+            result = impl->createSemaphore();
+        }
+
+        ++impl->stats.NumAcquired;
+        ++impl->stats.NumOutstanding;
+        impl->stats.PeakOutstanding = std::max(impl->stats.PeakOutstanding, impl->stats.NumOutstanding);
+        return result;
+    }
+
+    void SemaphorePool::Release(const VkSemaphore semaphore)
+    {
+        Release(1u, &semaphore);
+    }
+
+    void SemaphorePool::Release(const uint32_t num_semaphores, const VkSemaphore* semaphores)
+    {
+        std::lock_guard<std::mutex> guard(impl->mutex);
+        assert(impl->stats.NumOutstanding >= num_semaphores);
+        impl->available.insert(impl->available.end(), semaphores, semaphores + num_semaphores);
+        impl->stats.NumReleased += num_semaphores;
+        impl->stats.NumOutstanding -= num_semaphores;
+    }
+
+    SemaphorePoolStats SemaphorePool::Stats() const
+    {
+        std::lock_guard<std::mutex> guard(impl->mutex);
+        return impl->stats;
+    }
+
+}